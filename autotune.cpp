@@ -0,0 +1,597 @@
+//
+//  autotune.cpp
+//  cv_autonomous_vehicle
+//
+//  Parallel parameter search for the lane and vehicle detectors
+//
+
+#include <opencv2/core.hpp>
+#include "opencv2/highgui.hpp"
+#include "opencv2/videoio.hpp"
+
+#include "laneDetectorController.hpp"
+#include "vehicleDetectorController.hpp"
+
+#include "laneTracker.hpp"
+#include "laneEvaluator.hpp"
+#include "roadGenerator.hpp"
+#include "frameResult.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+/*
+ * Tune Parameter -> A tunable parameter and the values searched
+ */
+struct TuneParam {
+    const char *name;
+    bool integer;
+    double defaultValue;
+    vector<double> values;
+};
+
+/*
+ * Tune Result -> Accuracy and latency of one configuration
+ */
+struct TuneResult {
+    vector<double> values;
+    double f1;
+    double lateralError;
+    double ms;
+    bool pareto;
+};
+
+/*
+ * Lane Data -> Clips the lane detector is tuned on
+ */
+struct LaneData {
+    vector<int> seeds;          // generated roads
+    Size size;                  // size of the generated roads
+    int nFrames;                // frames per generated road
+    string root;                // TuSimple dataset root directory
+    vector<LaneLabel> labels;   // TuSimple labels
+};
+
+/*
+ * Vehicle Data -> Clip the vehicle detector is tuned on
+ */
+struct VehicleData {
+    string video;
+    string cascade;
+    int nFrames;
+    vector<vector<Rect> > reference;    // detections of the most exhaustive configuration
+};
+
+// Make a parameter
+static TuneParam param(const char *name, bool integer, double defaultValue, const double *values, int n){
+    TuneParam p;
+    p.name = name;
+    p.integer = integer;
+    p.defaultValue = defaultValue;
+    p.values.assign(values, values + n);
+    return p;
+}
+
+/********************************************************************************************
+ * LANE PARAMETERS
+ ********************************************************************************************
+ * This function lists the LaneDetector and LineFinder parameters and the values searched
+ * Output -> the parameters, in the order used by evalLane
+ */
+static vector<TuneParam> laneParams(){
+
+    static const double blockSize[] = { 11, 15, 21, 31 };
+    static const double c[] = { -3, -5, -8, -12 };
+    static const double nSample[] = { 15, 30, 45 };
+    static const double minVote[] = { 60, 80, 100 };
+    static const double minLen[] = { 100, 200, 300 };
+    static const double maxGap[] = { 20, 30, 50 };
+    static const double deltaRho[] = { 1.5, 2.5 };
+    static const double deltaTheta[] = { PI/180, PI/90 };
+
+    vector<TuneParam> params;
+    params.push_back(param("blockSizeAt", true, 15, blockSize, 4));
+    params.push_back(param("cAt", true, -5, c, 4));
+    params.push_back(param("nSample", true, 30, nSample, 3));
+    params.push_back(param("minVote", true, 80, minVote, 3));
+    params.push_back(param("minLen", false, 200, minLen, 3));
+    params.push_back(param("maxGap", false, 30, maxGap, 3));
+    params.push_back(param("deltaRho", false, 2.5, deltaRho, 2));
+    params.push_back(param("deltaTheta", false, PI/180, deltaTheta, 2));
+    return params;
+}
+
+/********************************************************************************************
+ * VEHICLE PARAMETERS
+ ********************************************************************************************
+ * This function lists the detectMultiScale parameters and the values searched
+ * The first value of each parameter is the most exhaustive (used as the reference)
+ * Output -> the parameters, in the order used by evalVehicle
+ */
+static vector<TuneParam> vehicleParams(){
+
+    static const double scaleFactor[] = { 1.05, 1.1, 1.2, 1.3 };
+    static const double minSize[] = { 60, 80, 100, 120 };
+
+    vector<TuneParam> params;
+    params.push_back(param("scaleFactor", false, 1.1, scaleFactor, 4));
+    params.push_back(param("minSize", true, 100, minSize, 4));
+    return params;
+}
+
+// Number of configurations in the grid
+static size_t gridSize(const vector<TuneParam> &params){
+    size_t n = 1;
+    for (size_t p = 0; p < params.size(); p++){
+        n *= params[p].values.size();
+    }
+    return n;
+}
+
+// Values of a configuration in the grid (mixed radix index)
+static vector<double> gridValues(const vector<TuneParam> &params, size_t index){
+    vector<double> v(params.size());
+    for (size_t p = 0; p < params.size(); p++){
+        v[p] = params[p].values[index % params[p].values.size()];
+        index /= params[p].values.size();
+    }
+    return v;
+}
+
+// Index of the default configuration in the grid (0 if a default is not in the grid)
+static size_t defaultIndex(const vector<TuneParam> &params){
+    size_t index = 0, stride = 1;
+    for (size_t p = 0; p < params.size(); p++){
+        const vector<double> &values = params[p].values;
+        size_t i = find(values.begin(), values.end(), params[p].defaultValue) - values.begin();
+        index += (i < values.size() ? i : 0) * stride;
+        stride *= values.size();
+    }
+    return index;
+}
+
+/********************************************************************************************
+ * SEARCH CONFIGURATIONS
+ ********************************************************************************************
+ * This function chooses the configurations to evaluate
+ * Output -> grid indices, starting with the default configuration
+ * \param params - the parameters
+ * \param samples - number of random configurations (0 for the whole grid)
+ * \param seed - random seed
+ */
+static vector<size_t> searchConfigs(const vector<TuneParam> &params, int samples, int seed){
+
+    size_t n = gridSize(params), def = defaultIndex(params);
+    vector<size_t> configs(1, def);
+    vector<size_t> others;
+    for (size_t i = 0; i < n; i++){
+        if (i != def){
+            others.push_back(i);
+        }
+    }
+
+    // Random search -> a fixed-seed shuffle of the grid
+    if (samples > 0){
+        RNG rng(seed);
+        for (size_t i = others.size(); i > 1; i--){
+            swap(others[i-1], others[rng.uniform(0, (int)i)]);
+        }
+        others.resize(min(others.size(), (size_t)max(samples - 1, 0)));
+    }
+
+    configs.insert(configs.end(), others.begin(), others.end());
+    return configs;
+}
+
+/********************************************************************************************
+ * EVALUATE LANE CONFIGURATION
+ ********************************************************************************************
+ * This function runs the lane detector with one configuration over the clip set
+ * Output -> no output
+ * \param v - parameter values (in the order of laneParams)
+ * \param data - the clips
+ * \param res - accuracy and latency of the configuration
+ */
+static void evalLane(const vector<double> &v, const LaneData &data, TuneResult &res){
+
+    LaneEvaluator eval;
+    double seconds = 0;
+    int frames = 0;
+    vector<Point2f> orgPts;
+    Mat frame;
+
+    size_t nClips = data.seeds.size() + data.labels.size();
+    for (size_t c = 0; c < nClips; c++){
+
+        LaneDetectorController lController;
+        LaneTracker lTracker, rTracker;
+        lTracker.initKalman(0, 0);
+        rTracker.initKalman(0, 0);
+        lController.initKalman(lTracker, rTracker);
+        lController.setThreshold((int)v[0], (int)v[1]);
+        lController.setSampleN((int)v[2]);
+        lController.setHoughParams((int)v[3], v[4], v[5], v[6], v[7]);
+
+        // Generated road, every frame is labelled
+        if (c < data.seeds.size()){
+            RoadGenerator road(data.size, data.seeds[c]);
+            road.setDashed(true);
+            road.setCurvature(2e-4);
+            road.setLighting(0.2, 8);
+            road.setOccluders(2);
+
+            LaneLabel label;
+            label.hSamples = road.getSampleRows();
+            label.lanes.resize(2);
+            for (int i = 0; i < data.nFrames; i++){
+                road.nextFrame(frame);
+
+                double start = (double)getTickCount();
+                lController.setVideoFrame(frame);
+                lController.initIPM(orgPts);
+                lController.process();
+                seconds += ((double)getTickCount() - start) / getTickFrequency();
+                frames++;
+
+                for (int side = 0; side < 2; side++){
+                    const vector<float> &x = road.getLaneX(side);
+                    label.lanes[side].assign(x.begin(), x.end());
+                }
+                eval.addFrame(label, frame.cols, lController.getPoints());
+            }
+            continue;
+        }
+
+        // TuSimple clip, only the last frame is labelled
+        const LaneLabel &label = data.labels[c - data.seeds.size()];
+        vector<string> files = LaneEvaluator::clipFrames(data.root, label, true);
+        for (size_t i = 0; i < files.size(); i++){
+            frame = imread(files[i]);
+            if (frame.empty()){
+                continue;
+            }
+            double start = (double)getTickCount();
+            lController.setVideoFrame(frame);
+            lController.initIPM(orgPts);
+            lController.process();
+            seconds += ((double)getTickCount() - start) / getTickFrequency();
+            frames++;
+        }
+        if (!frame.empty()){
+            eval.addFrame(label, frame.cols, lController.getPoints());
+        }
+    }
+
+    res.values = v;
+    res.f1 = eval.getF1();
+    res.lateralError = eval.getLateralError();
+    res.ms = frames > 0 ? seconds * 1000 / frames : 0;
+}
+
+/********************************************************************************************
+ * RUN VEHICLE CONFIGURATION
+ ********************************************************************************************
+ * This function runs the vehicle detector with one configuration over the clip
+ * Output -> time per frame (ms), -1 if the clip or cascade could not be opened
+ * \param v - parameter values (in the order of vehicleParams)
+ * \param data - the clip
+ * \param detections - the detected cars of each frame
+ */
+static double runVehicle(const vector<double> &v, const VehicleData &data, vector<vector<Rect> > &detections){
+
+    VideoCapture cap(data.video);
+    VehicleDetectorController vController;
+    if (!cap.isOpened() || !vController.setCascade(data.cascade)){
+        return -1;
+    }
+    vController.setScaleFactor(v[0], Size((int)v[1], (int)v[1]));
+
+    double seconds = 0;
+    detections.clear();
+    Mat frame;
+    for (int i = 0; i < data.nFrames; i++){
+        cap >> frame;
+        if (frame.empty()){
+            break;
+        }
+        double start = (double)getTickCount();
+        vController.setVideoFrame(frame);
+        vController.process();
+        seconds += ((double)getTickCount() - start) / getTickFrequency();
+        detections.push_back(vController.getCars());
+    }
+    return detections.empty() ? 0 : seconds * 1000 / detections.size();
+}
+
+/********************************************************************************************
+ * EVALUATE VEHICLE CONFIGURATION
+ ********************************************************************************************
+ * This function scores one configuration against the reference detections
+ * A detection matches a reference car if their intersection over union is at least 0.5
+ * Output -> no output
+ * \param v - parameter values (in the order of vehicleParams)
+ * \param data - the clip and reference detections
+ * \param res - accuracy and latency of the configuration
+ */
+static void evalVehicle(const vector<double> &v, const VehicleData &data, TuneResult &res){
+
+    vector<vector<Rect> > detections;
+    res.values = v;
+    res.ms = runVehicle(v, data, detections);
+    res.lateralError = -1;
+
+    int tp = 0, nDet = 0, nRef = 0;
+    for (size_t i = 0; i < detections.size() && i < data.reference.size(); i++){
+        const vector<Rect> &ref = data.reference[i];
+        vector<bool> used(ref.size(), false);
+        for (size_t d = 0; d < detections[i].size(); d++){
+            for (size_t r = 0; r < ref.size(); r++){
+                if (!used[r] && intersectionOverUnion(detections[i][d], ref[r]) >= 0.5){
+                    used[r] = true;
+                    tp++;
+                    break;
+                }
+            }
+        }
+        nDet += detections[i].size();
+        nRef += ref.size();
+    }
+    double precision = nDet > 0 ? (double)tp / nDet : 1, recall = nRef > 0 ? (double)tp / nRef : 1;
+    res.f1 = precision + recall > 0 ? 2 * precision * recall / (precision + recall) : 0;
+}
+
+/********************************************************************************************
+ * RUN SEARCH
+ ********************************************************************************************
+ * This function evaluates the configurations on every core
+ * Each thread takes the next configuration until all have been evaluated
+ * Output -> the result of each configuration
+ * \param params - the parameters
+ * \param configs - grid indices of the configurations
+ * \param nThreads - number of worker threads
+ * \param eval - evaluates one configuration
+ */
+static vector<TuneResult> runSearch(const vector<TuneParam> &params, const vector<size_t> &configs, int nThreads,
+                                    const function<void(const vector<double>&, TuneResult&)> &eval){
+
+    vector<TuneResult> results(configs.size());
+    std::atomic<size_t> next(0);
+    std::mutex printMutex;
+    size_t done = 0;
+
+    vector<thread> workers;
+    for (int t = 0; t < nThreads; t++){
+        workers.push_back(thread([&](){
+            for (size_t i = next++; i < configs.size(); i = next++){
+                eval(gridValues(params, configs[i]), results[i]);
+
+                lock_guard<std::mutex> lock(printMutex);
+                done++;
+                cerr << "\r" << done << "/" << configs.size() << " configurations" << flush;
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++){
+        workers[t].join();
+    }
+    cerr << endl;
+
+    return results;
+}
+
+/********************************************************************************************
+ * MARK PARETO
+ ********************************************************************************************
+ * This function marks the configurations no other configuration beats on both accuracy and latency
+ * Output -> no output
+ * \param results - the results (pareto is set)
+ */
+static void markPareto(vector<TuneResult> &results){
+
+    vector<size_t> order(results.size());
+    for (size_t i = 0; i < order.size(); i++){
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b){
+        return results[a].ms != results[b].ms ? results[a].ms < results[b].ms : results[a].f1 > results[b].f1;
+    });
+
+    // Fastest first, a configuration is on the frontier if it is more accurate than every faster one
+    double best = -1;
+    for (size_t i = 0; i < order.size(); i++){
+        TuneResult &r = results[order[i]];
+        r.pareto = r.ms >= 0 && r.f1 > best;
+        if (r.pareto){
+            best = r.f1;
+        }
+    }
+}
+
+/********************************************************************************************
+ * CHOOSE CONFIGURATION
+ ********************************************************************************************
+ * This function picks the most accurate configuration on the frontier within the latency budget
+ * Output -> index of the chosen result (the fastest if none is within the budget)
+ * \param results - the results
+ * \param budget - latency budget (ms per frame, 0 for no budget)
+ */
+static size_t chooseConfig(const vector<TuneResult> &results, double budget){
+
+    size_t chosen = 0, fastest = 0;
+    bool found = false;
+    for (size_t i = 0; i < results.size(); i++){
+        if (!results[i].pareto){
+            continue;
+        }
+        if (!results[fastest].pareto || results[i].ms < results[fastest].ms){
+            fastest = i;
+        }
+        if ((budget <= 0 || results[i].ms <= budget) && (!found || results[i].f1 > results[chosen].f1)){
+            chosen = i;
+            found = true;
+        }
+    }
+    return found ? chosen : fastest;
+}
+
+/********************************************************************************************
+ * WRITE RESULTS
+ ********************************************************************************************
+ * This function writes every configuration as CSV
+ * Output -> no output
+ * \param os - output stream
+ * \param params - the parameters
+ * \param results - the results
+ */
+static void writeResults(ostream &os, const vector<TuneParam> &params, const vector<TuneResult> &results){
+
+    for (size_t p = 0; p < params.size(); p++){
+        os << params[p].name << ",";
+    }
+    os << "f1,lateral_error_px,ms_per_frame,pareto" << endl;
+    for (size_t i = 0; i < results.size(); i++){
+        for (size_t p = 0; p < params.size(); p++){
+            os << results[i].values[p] << ",";
+        }
+        os << results[i].f1 << "," << results[i].lateralError << "," << results[i].ms << "," << results[i].pareto << endl;
+    }
+}
+
+// Write the chosen configuration of one detector as a map
+static void writeConfig(FileStorage &fs, const string &node, const vector<TuneParam> &params, const TuneResult &res){
+
+    fs << node << "{";
+    for (size_t p = 0; p < params.size(); p++){
+        if (params[p].integer){
+            fs << params[p].name << (int)res.values[p];
+        } else {
+            fs << params[p].name << res.values[p];
+        }
+    }
+    fs << "f1" << res.f1 << "msPerFrame" << res.ms << "}";
+}
+
+int main(int argc, char **argv) {
+
+    // Options
+    LaneData lane;
+    lane.size = Size(1280, 720);
+    lane.nFrames = 100;
+    VehicleData vehicle;
+    vehicle.nFrames = 100;
+    string search = "random", out_name = "autotune.yml", csv_name;
+    int samples = 64, seed = 42;
+    int nThreads = max(1, (int)thread::hardware_concurrency());
+    double laneBudget = 0, vehicleBudget = 0;
+    string labels_name;
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--synthetic" && hasValue){
+            lane.seeds.push_back(atoi(argv[++i]));
+        } else if (arg == "--frames" && hasValue){
+            lane.nFrames = vehicle.nFrames = atoi(argv[++i]);
+        } else if (arg == "--labels" && hasValue){
+            labels_name = argv[++i];
+        } else if (arg == "--root" && hasValue){
+            lane.root = argv[++i];
+        } else if (arg == "--video" && hasValue){
+            vehicle.video = argv[++i];
+        } else if (arg == "--cascade" && hasValue){
+            vehicle.cascade = argv[++i];
+        } else if (arg == "--search" && hasValue){
+            search = argv[++i];
+        } else if (arg == "--samples" && hasValue){
+            samples = atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue){
+            nThreads = max(1, atoi(argv[++i]));
+        } else if (arg == "--lane-budget" && hasValue){
+            laneBudget = atof(argv[++i]);
+        } else if (arg == "--vehicle-budget" && hasValue){
+            vehicleBudget = atof(argv[++i]);
+        } else if (arg == "--out" && hasValue){
+            out_name = argv[++i];
+        } else if (arg == "--csv" && hasValue){
+            csv_name = argv[++i];
+        } else {
+            cout << "Usage: " << argv[0] << " [--synthetic seed]... [--labels json --root dir] [--video file --cascade file] [--frames n]" << endl;
+            cout << "       [--search grid|random] [--samples n] [--threads n] [--lane-budget ms] [--vehicle-budget ms] [--out autotune.yml] [--csv file]" << endl;
+            return -1;
+        }
+    }
+    if (!labels_name.empty() && !LaneEvaluator::loadTuSimple(labels_name, lane.labels)){
+        cout << "Error reading labels " << labels_name << endl;
+        return -1;
+    }
+    if (lane.seeds.empty() && lane.labels.empty()){
+        lane.seeds.push_back(1);
+        lane.seeds.push_back(2);
+        lane.seeds.push_back(3);
+    }
+    if (search != "grid" && search != "random"){
+        cout << "Unknown search " << search << endl;
+        return -1;
+    }
+    int nSamples = search == "grid" ? 0 : samples;
+
+    // One OpenCV thread per worker so the workers do not oversubscribe the cores
+    setNumThreads(1);
+
+    ofstream csv;
+    if (!csv_name.empty()){
+        csv.open(csv_name.c_str());
+    }
+    ostream &os = csv.is_open() ? csv : cout;
+
+    FileStorage fs(out_name, FileStorage::WRITE);
+    if (!fs.isOpened()){
+        cout << "Error writing " << out_name << endl;
+        return -1;
+    }
+
+    // Lane detector
+    vector<TuneParam> lParams = laneParams();
+    vector<size_t> lConfigs = searchConfigs(lParams, nSamples, seed);
+    cerr << "Lane detector: " << lConfigs.size() << " of " << gridSize(lParams) << " configurations on " << nThreads << " threads" << endl;
+    vector<TuneResult> lResults = runSearch(lParams, lConfigs, nThreads, [&](const vector<double> &v, TuneResult &res){
+        evalLane(v, lane, res);
+    });
+    markPareto(lResults);
+    writeResults(os, lParams, lResults);
+    size_t lChosen = chooseConfig(lResults, laneBudget);
+    writeConfig(fs, "laneDetector", lParams, lResults[lChosen]);
+    cerr << "Lane detector: f1 " << lResults[lChosen].f1 << ", " << lResults[lChosen].ms << " ms per frame (default: f1 "
+         << lResults[0].f1 << ", " << lResults[0].ms << " ms per frame)" << endl;
+
+    // Vehicle detector, scored against the most exhaustive configuration
+    if (!vehicle.video.empty() && !vehicle.cascade.empty()){
+        vector<TuneParam> vParams = vehicleParams();
+        if (runVehicle(gridValues(vParams, 0), vehicle, vehicle.reference) < 0){
+            cout << "Error opening " << vehicle.video << " or " << vehicle.cascade << endl;
+            return -1;
+        }
+        vector<size_t> vConfigs = searchConfigs(vParams, 0, seed);
+        cerr << "Vehicle detector: " << vConfigs.size() << " configurations on " << nThreads << " threads" << endl;
+        vector<TuneResult> vResults = runSearch(vParams, vConfigs, nThreads, [&](const vector<double> &v, TuneResult &res){
+            evalVehicle(v, vehicle, res);
+        });
+        markPareto(vResults);
+        os << endl;
+        writeResults(os, vParams, vResults);
+        size_t vChosen = chooseConfig(vResults, vehicleBudget);
+        writeConfig(fs, "vehicleDetector", vParams, vResults[vChosen]);
+        cerr << "Vehicle detector: f1 " << vResults[vChosen].f1 << ", " << vResults[vChosen].ms << " ms per frame" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,470 @@
+//
+//  benchmark.cpp
+//  cv_autonomous_vehicle
+//
+//  Benchmarks for the lane and vehicle detection algorithms
+//
+
+#include <opencv2/core.hpp>
+#include "opencv2/videoio.hpp"
+
+#include "IPM.hpp"
+#include "lineFinder.hpp"
+#include "laneDetector.hpp"
+#include "vehicleDetector.hpp"
+#include "laneTracker.hpp"
+#include "laneTrackerBank.hpp"
+#include "roadGenerator.hpp"
+#include "frameResult.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+/********************************************************************************************
+ * VEHICLE DETECTION DOWNSCALE BENCHMARK
+ ********************************************************************************************
+ * This function runs the vehicle detector over the video at each downscale factor
+ * Output -> CSV table of throughput and recall (relative to full resolution) per factor
+ * \param video_name - input video file path and name
+ * \param car_cascade_name - haar cascade file path and name
+ * \param nFrames - number of frames to process
+ */
+static int benchVehicleScale(const string &video_name, const string &car_cascade_name, int nFrames){
+
+    CascadeClassifier car_cascade;
+    if( !car_cascade.load( car_cascade_name ) ){
+        cout << "Error loading haar cascade!" << endl;
+        return -1;
+    }
+
+    // Read the frames once so decoding is not timed
+    VideoCapture cap(video_name);
+    if (!cap.isOpened()){
+        cout << "Error opening video file!" << endl;
+        return -1;
+    }
+    vector<Mat> frames;
+    for (int i = 0; i < nFrames; i++){
+        Mat frame;
+        cap >> frame;
+        if (frame.empty()){
+            break;
+        }
+        frames.push_back(frame);
+    }
+
+    // Full resolution detections are the reference for recall
+    const double scales[] = { 1.0, 0.75, 0.5, 0.375, 0.25 };
+    vector<vector<Rect> > reference;
+
+    cout << "scale,fps,ms_per_frame,detections,recall" << endl;
+    for (size_t s = 0; s < sizeof(scales)/sizeof(scales[0]); s++){
+
+        VehicleDetector vdetect;
+        vdetect.setDetectScale(scales[s]);
+
+        vector<vector<Rect> > detections;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < frames.size(); i++){
+            detections.push_back(vdetect.process(frames[i], car_cascade));
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (s == 0){
+            reference = detections;
+        }
+
+        // Count the reference detections matched at IoU >= 0.5
+        int nRef = 0, nMatched = 0, nDetected = 0;
+        for (size_t i = 0; i < frames.size(); i++){
+            nRef += reference[i].size();
+            nDetected += detections[i].size();
+            for (size_t r = 0; r < reference[i].size(); r++){
+                for (size_t d = 0; d < detections[i].size(); d++){
+                    if (intersectionOverUnion(reference[i][r], detections[i][d]) >= 0.5){
+                        nMatched++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        double recall = nRef > 0 ? (double)nMatched / nRef : 1.0;
+        cout << scales[s] << "," << frames.size() / seconds << "," << 1000 * seconds / frames.size() << "," << nDetected << "," << recall << endl;
+    }
+
+    return 0;
+}
+
+/********************************************************************************************
+ * LANE TRACKER BENCHMARK
+ ********************************************************************************************
+ * This function times the lane tracker predict/correct cycle against cv::KalmanFilter
+ * Output -> CSV table of the latency per update in nanoseconds
+ * \param nIter - number of predict/correct cycles
+ */
+static int benchTracker(int nIter){
+
+    // Measurements jitter around a fixed line so both filters do the same work
+    vector<Point2f> meas(1024);
+    RNG rng(0);
+    for (size_t i = 0; i < meas.size(); i++){
+        meas[i] = Point2f(rng.uniform(95.f, 105.f), rng.uniform(0.45f, 0.55f));
+    }
+
+    // Fixed size filter used by the lane tracker
+    LaneTracker tracker;
+    tracker.initKalman(0, 0);
+    float sink = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < nIter; i++){
+        const Point2f &m = meas[i & 1023];
+        tracker.predictKalman();
+        tracker.correctKalman(m.x, m.y);
+    }
+    sink += tracker.getState().x;
+    double fixedNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / nIter;
+
+    // OpenCV filter with the same model, as the lane tracker used before
+    KalmanFilter kf(4, 2, 0);
+    setIdentity(kf.transitionMatrix);
+    setIdentity(kf.measurementMatrix);
+    setIdentity(kf.processNoiseCov, Scalar::all(0.005));
+    setIdentity(kf.measurementNoiseCov, Scalar::all(1e-1));
+    setIdentity(kf.errorCovPost, Scalar::all(0.1));
+    Mat_<float> measurement(2, 1);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < nIter; i++){
+        const Point2f &m = meas[i & 1023];
+        kf.predict();
+        kf.statePre.copyTo(kf.statePost);
+        kf.errorCovPre.copyTo(kf.errorCovPost);
+        measurement(0) = m.x;
+        measurement(1) = m.y;
+        sink += kf.correct(measurement).at<float>(0);
+    }
+    double cvNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / nIter;
+
+    // Batched bank of tracks, time per track per update
+    const int nTracks = 512;
+    LaneTrackerBank bank;
+    for (int t = 0; t < nTracks; t++){
+        bank.addTrack(0, 0);
+    }
+    vector<float> rho(nTracks), theta(nTracks);
+    vector<unsigned char> valid(nTracks, 1);
+    int nSweeps = max(1, nIter / nTracks);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < nSweeps; i++){
+        for (int t = 0; t < nTracks; t++){
+            const Point2f &m = meas[(i + t) & 1023];
+            rho[t] = m.x;
+            theta[t] = m.y;
+        }
+        bank.predictAll();
+        bank.correctAll(rho.data(), theta.data(), valid.data());
+    }
+    sink += bank.getState(0).x;
+    double bankNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ((double)nSweeps * nTracks);
+
+    cout << "filter,ns_per_update" << endl;
+    cout << "FixedKalman<4,2>," << fixedNs << endl;
+    cout << "cv::KalmanFilter," << cvNs << endl;
+    cout << "LaneTrackerBank(" << nTracks << ")," << bankNs << endl;
+
+    return sink == 0 ? 1 : 0;
+}
+
+/*
+ * Bench Result -> Summary of the timed repetitions of one building block (in microseconds)
+ */
+struct BenchResult {
+    string block;
+    string resolution;
+    string input;
+    int reps;
+    double mean, stddev, min, median, p95, max;
+};
+
+/********************************************************************************************
+ * TIME BLOCK
+ ********************************************************************************************
+ * This function runs a building block for the warm-up and timed repetitions
+ * Output -> statistics of the timed repetitions
+ * \param block - name of the building block
+ * \param resolution - name of the input resolution
+ * \param input - name of the input source
+ * \param warmup - number of untimed repetitions
+ * \param reps - number of timed repetitions
+ * \param run - the building block
+ */
+static BenchResult timeBlock(const string &block, const string &resolution, const string &input, int warmup, int reps, const function<void()> &run){
+
+    for (int i = 0; i < warmup; i++){
+        run();
+    }
+
+    vector<double> us(reps);
+    for (int i = 0; i < reps; i++){
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        run();
+        us[i] = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    }
+    sort(us.begin(), us.end());
+
+    BenchResult r;
+    r.block = block;
+    r.resolution = resolution;
+    r.input = input;
+    r.reps = reps;
+    double sum = 0, sumSq = 0;
+    for (int i = 0; i < reps; i++){
+        sum += us[i];
+        sumSq += us[i]*us[i];
+    }
+    r.mean = sum / reps;
+    r.stddev = sqrt(max(0.0, sumSq / reps - r.mean*r.mean));
+    r.min = us.front();
+    r.median = us[reps/2];
+    r.p95 = us[min(reps - 1, (int)(0.95*reps))];
+    r.max = us.back();
+    return r;
+}
+
+/********************************************************************************************
+ * DEFAULT IPM POINTS
+ ********************************************************************************************
+ * This function scales the default IPM points of LaneDetectorController to the frame size
+ * Output -> the original points (orgPts) and the destination points (dstPts)
+ */
+static void defaultIPMPoints(Size size, vector<Point2f> &orgPts, vector<Point2f> &dstPts){
+
+    float sx = size.width / 1920.f, sy = size.height / 1080.f;
+    orgPts.clear();
+    orgPts.push_back( Point2f(0, size.height) );
+    orgPts.push_back( Point2f(size.width, size.height) );
+    orgPts.push_back( Point2f(size.width/2 + 150*sx, 700*sy) );
+    orgPts.push_back( Point2f(size.width/2 - 300*sx, 700*sy) );
+
+    dstPts.clear();
+    dstPts.push_back( Point2f(0, size.height) );
+    dstPts.push_back( Point2f(size.width, size.height) );
+    dstPts.push_back( Point2f(size.width, 0) );
+    dstPts.push_back( Point2f(0, 0) );
+}
+
+/********************************************************************************************
+ * BENCHMARK SUITE
+ ********************************************************************************************
+ * This function times each building block in isolation at 720p, 1080p and 4K
+ * Output -> the results of every block, resolution and input
+ * \param video_name - recorded input (first frame is resized to each resolution), empty to skip
+ * \param car_cascade_name - haar cascade for the vehicle detector, empty to skip
+ * \param warmup - number of untimed repetitions
+ * \param reps - number of timed repetitions
+ */
+static vector<BenchResult> benchSuite(const string &video_name, const string &car_cascade_name, int warmup, int reps){
+
+    vector<BenchResult> results;
+
+    const Size sizes[] = { Size(1280, 720), Size(1920, 1080), Size(3840, 2160) };
+    const char *names[] = { "720p", "1080p", "4K" };
+
+    // Recorded input
+    Mat recorded;
+    if (!video_name.empty()){
+        VideoCapture cap(video_name);
+        cap >> recorded;
+        if (recorded.empty()){
+            cout << "Error opening video file!" << endl;
+        }
+    }
+
+    CascadeClassifier car_cascade;
+    bool haveCascade = !car_cascade_name.empty() && car_cascade.load(car_cascade_name);
+
+    // The lane tracker does not depend on the input
+    LaneTracker tracker;
+    tracker.initKalman(0, 0);
+    results.push_back(timeBlock("LaneTracker::predictKalman+correctKalman", "-", "synthetic", warmup, reps, [&](){
+        tracker.predictKalman();
+        tracker.correctKalman(100, 0.5);
+    }));
+
+    for (int s = 0; s < 3; s++){
+        for (int in = 0; in < 2; in++){
+
+            // Build the input frame
+            Mat frame;
+            string input = in == 0 ? "synthetic" : "recorded";
+            if (in == 0){
+                RoadGenerator road(sizes[s], 42);
+                road.setDashed(true);
+                road.setLighting(0, 12);
+                frame = road.nextFrame();
+            } else if (!recorded.empty()){
+                resize(recorded, frame, sizes[s]);
+            } else {
+                continue;
+            }
+            string res = names[s];
+
+            Mat gray;
+            cvtColor(frame, gray, COLOR_BGR2GRAY);
+
+            // Inverse perspective mapping
+            vector<Point2f> orgPts, dstPts;
+            defaultIPMPoints(sizes[s], orgPts, dstPts);
+            results.push_back(timeBlock("IPM::createMaps", res, input, warmup, reps, [&](){
+                IPM ipm(sizes[s], sizes[s], orgPts, dstPts);
+            }));
+            IPM ipm(sizes[s], sizes[s], orgPts, dstPts);
+            Mat imgIpm;
+            results.push_back(timeBlock("IPM::applyHomography", res, input, warmup, reps, [&](){
+                ipm.applyHomography(gray, imgIpm);
+            }));
+
+            // Left half of the IPM image, as used by LaneDetector
+            Mat half = imgIpm(Rect(0, 0, imgIpm.cols/2, imgIpm.rows)).clone();
+            Mat thres;
+            adaptiveThreshold(half, thres, 255, ADAPTIVE_THRESH_GAUSSIAN_C, THRESH_BINARY, 15, -5);
+
+            // Line finder (fresh finder each time as findLines adapts the minimum vote)
+            results.push_back(timeBlock("LineFinder::findLines", res, input, warmup, reps, [&](){
+                LineFinder finder;
+                finder.setImageThres(thres);
+                finder.findLines(0);
+            }));
+            results.push_back(timeBlock("LineFinder::findLinesP", res, input, warmup, reps, [&](){
+                LineFinder finder;
+                finder.setLenthGap(200, 30);
+                finder.setImageThres(thres);
+                finder.findLinesP(0);
+            }));
+            LineFinder finder;
+            finder.setImage(half);
+            finder.setImageThres(thres);
+            finder.findLines(0);
+            results.push_back(timeBlock("LineFinder::drawLines", res, input, warmup, reps, [&](){
+                finder.drawLines(0);
+            }));
+
+            // Lane detector stages
+            LaneDetector ldetect;
+            ldetect.setImageIPM(half);
+            results.push_back(timeBlock("LaneDetector::detectLanes", res, input, warmup, reps, [&](){
+                Mat img = half.clone();
+                ldetect.detectLanes(img, 0);
+            }));
+            results.push_back(timeBlock("LaneDetector::sampleLine", res, input, warmup, reps, [&](){
+                ldetect.sampleLine(0);
+            }));
+            results.push_back(timeBlock("LaneDetector::calcLineParams", res, input, warmup, reps, [&](){
+                ldetect.calcLineParams(0);
+            }));
+
+            // Vehicle detector
+            if (haveCascade){
+                VehicleDetector vdetect;
+                results.push_back(timeBlock("VehicleDetector::process", res, input, warmup, reps, [&](){
+                    vdetect.process(frame, car_cascade);
+                }));
+            }
+        }
+    }
+
+    return results;
+}
+
+/********************************************************************************************
+ * WRITE RESULTS
+ ********************************************************************************************
+ * This function writes the benchmark results as CSV or JSON
+ * Output -> no output
+ * \param os - output stream
+ * \param results - benchmark results
+ * \param json - true for JSON, false for CSV
+ */
+static void writeResults(ostream &os, const vector<BenchResult> &results, bool json){
+
+    if (json){
+        os << "[" << endl;
+        for (size_t i = 0; i < results.size(); i++){
+            const BenchResult &r = results[i];
+            os << "  {\"block\":\"" << r.block << "\",\"resolution\":\"" << r.resolution << "\",\"input\":\"" << r.input << "\",\"reps\":" << r.reps
+               << ",\"mean_us\":" << r.mean << ",\"stddev_us\":" << r.stddev << ",\"min_us\":" << r.min << ",\"median_us\":" << r.median
+               << ",\"p95_us\":" << r.p95 << ",\"max_us\":" << r.max << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        os << "]" << endl;
+    } else {
+        os << "block,resolution,input,reps,mean_us,stddev_us,min_us,median_us,p95_us,max_us" << endl;
+        for (size_t i = 0; i < results.size(); i++){
+            const BenchResult &r = results[i];
+            os << r.block << "," << r.resolution << "," << r.input << "," << r.reps << "," << r.mean << "," << r.stddev << ","
+               << r.min << "," << r.median << "," << r.p95 << "," << r.max << endl;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+
+    string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "vehicle" && argc > 3){
+        int nFrames = argc > 4 ? atoi(argv[4]) : 300;
+        return benchVehicleScale(argv[2], argv[3], nFrames);
+    }
+    if (mode == "tracker"){
+        int nIter = argc > 2 ? atoi(argv[2]) : 1000000;
+        return benchTracker(nIter);
+    }
+    if (mode == "suite"){
+
+        // Options
+        string video_name, car_cascade_name, out_name;
+        bool json = false;
+        int warmup = 3, reps = 20;
+        for (int i = 2; i < argc; i++){
+            string arg = argv[i];
+            if (arg == "--json"){
+                json = true;
+            } else if (i + 1 < argc && arg == "--video"){
+                video_name = argv[++i];
+            } else if (i + 1 < argc && arg == "--cascade"){
+                car_cascade_name = argv[++i];
+            } else if (i + 1 < argc && arg == "--warmup"){
+                warmup = atoi(argv[++i]);
+            } else if (i + 1 < argc && arg == "--reps"){
+                reps = max(1, atoi(argv[++i]));
+            } else if (i + 1 < argc && arg == "--out"){
+                out_name = argv[++i];
+            }
+        }
+
+        // Fixed seed so every build sees the same inputs
+        setRNGSeed(42);
+        vector<BenchResult> results = benchSuite(video_name, car_cascade_name, warmup, reps);
+
+        if (out_name.empty()){
+            writeResults(cout, results, json);
+        } else {
+            ofstream out(out_name.c_str());
+            writeResults(out, results, json);
+        }
+        return 0;
+    }
+
+    cout << "Usage: " << argv[0] << " vehicle <video> <haar cascade> [frames]" << endl;
+    cout << "       " << argv[0] << " tracker [iterations]" << endl;
+    cout << "       " << argv[0] << " suite [--video file] [--cascade file] [--warmup n] [--reps n] [--json] [--out file]" << endl;
+    return -1;
+}
@@ -0,0 +1,88 @@
+//
+//  changeDetector.cpp
+//  cv_autonomous_vehicle
+//
+//  Detects frames that are nearly identical to the last processed frame
+//
+
+#include "changeDetector.hpp"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+/********************************************************************************************
+ * IS STATIC
+ ********************************************************************************************
+ * This function compares a region of the frame with the last frame that was processed
+ * Output -> true if the region has not changed (the last result can be reused), false if
+ *           the frame must be processed (it becomes the new reference)
+ * \param frame - the input image
+ * \param region - region compared (empty -> the whole frame)
+ */
+bool ChangeDetector::isStatic(const Mat &frame, Rect region){
+
+    if (threshold <= 0 || frame.empty()){
+        return false;
+    }
+    nChecked++;
+
+    Rect roi( 0, 0, frame.cols, frame.rows );
+    if (region.area() > 0 && (region & roi).area() > 0){
+        roi &= region;
+    }
+
+    // Shrink before converting, so only the thumbnail is converted to gray
+    Size size( max(roi.width/scale, 1), max(roi.height/scale, 1) );
+    resize( frame(roi), small, size, 0, 0, INTER_AREA );
+    if (small.channels() == 3){
+        cvtColor( small, thumb, COLOR_BGR2GRAY );
+    } else {
+        small.copyTo(thumb);
+    }
+
+    bool same = !reference.empty() && reference.size() == thumb.size() && skipped < maxSkip
+                && norm( thumb, reference, NORM_L1 ) / thumb.total() < threshold;
+    if (same){
+        skipped++;
+        nStatic++;
+        return true;
+    }
+
+    thumb.copyTo(reference);
+    skipped = 0;
+    return false;
+}
+
+// Forget the reference
+void ChangeDetector::reset(){
+    reference.release();
+    skipped = 0;
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the static threshold and the most static frames in a row
+void ChangeDetector::setThreshold(double threshold_, int maxSkip_){
+    threshold = threshold_;
+    maxSkip = max(maxSkip_, 1);
+    reset();
+}
+
+// Get the static threshold
+double ChangeDetector::getThreshold() const {
+    return threshold;
+}
+
+// Get the number of frames found static
+long long ChangeDetector::getStatic() const {
+    return nStatic;
+}
+
+// Get the number of frames compared
+long long ChangeDetector::getChecked() const {
+    return nChecked;
+}
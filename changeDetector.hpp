@@ -0,0 +1,80 @@
+//
+//  changeDetector.hpp
+//  cv_autonomous_vehicle
+//
+//  Detects frames that are nearly identical to the last processed frame
+//
+
+#ifndef changeDetector_hpp
+#define changeDetector_hpp
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+/*
+ * Change Detector -> Cheap test of whether a region of the frame has changed
+ * The region is shrunk by an area average and compared to the thumbnail of the last frame
+ * that was processed, using the mean absolute difference of the gray levels (SAD / pixels).
+ * Comparing to the last processed frame rather than the previous frame means a slow change
+ * still adds up and is eventually detected. A frame is always reported as changed after
+ * maxSkip static frames in a row, which bounds how old a reused result can be.
+ */
+class ChangeDetector {
+
+    private:
+
+        // Mean absolute difference (gray levels) below which a frame is static (0 -> never static)
+        double threshold;
+
+        // Most static frames in a row before a frame is processed anyway
+        int maxSkip;
+
+        // Downsampling factor of the thumbnails
+        int scale;
+
+        // Thumbnails of the current frame and of the last frame processed
+        cv::Mat small;
+        cv::Mat thumb;
+        cv::Mat reference;
+
+        // Static frames in a row and counters
+        int skipped;
+        long long nStatic;
+        long long nChecked;
+
+    public:
+
+        ChangeDetector(double threshold_ = 0, int maxSkip_ = 30) : threshold(threshold_), maxSkip(maxSkip_), scale(8), skipped(0), nStatic(0), nChecked(0) {}
+
+        /********************************************************************************************
+         * IS STATIC
+         ********************************************************************************************
+         * This function compares a region of the frame with the last frame that was processed
+         * Output -> true if the region has not changed (the last result can be reused), false if
+         *           the frame must be processed (it becomes the new reference)
+         * \param frame - the input image
+         * \param region - region compared (empty -> the whole frame)
+         */
+        bool isStatic(const cv::Mat &frame, cv::Rect region);
+
+        // Forget the reference (the next frame is processed)
+        void reset();
+
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+
+        // Set the static threshold (0 -> never static) and the most static frames in a row
+        void setThreshold(double threshold_, int maxSkip_);
+
+        // Get the static threshold
+        double getThreshold() const;
+
+        // Get the number of frames found static
+        long long getStatic() const;
+
+        // Get the number of frames compared
+        long long getChecked() const;
+};
+
+#endif /* changeDetector_hpp */
@@ -0,0 +1,345 @@
+//
+//  config.cpp
+//  cv_autonomous_vehicle
+//
+//  Detector parameters read from a configuration file, reloaded while running
+//
+
+#include "config.hpp"
+
+#include <sys/stat.h>
+#include <chrono>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+// Read a value if the key is present
+template<typename T>
+static void readKey(const FileNode &node, const char *key, T &value){
+    FileNode n = node[key];
+    if (!n.empty()){
+        n >> value;
+    }
+}
+
+static void readKey(const FileNode &node, const char *key, bool &value){
+    FileNode n = node[key];
+    if (!n.empty()){
+        value = (int)n != 0;
+    }
+}
+
+// Read a sequence of numbers if the key is present
+static bool readSeq(const FileNode &node, const char *key, vector<float> &values){
+    FileNode n = node[key];
+    if (n.empty() || !n.isSeq()){
+        return false;
+    }
+    values.clear();
+    for (size_t i = 0; i < n.size(); i++){
+        values.push_back((float)n[(int)i]);
+    }
+    return true;
+}
+
+// Report a value the detectors cannot use
+static bool checkKey(bool valid, const char *key){
+    if (!valid){
+        cerr << "Invalid configuration value for " << key << endl;
+    }
+    return valid;
+}
+
+/********************************************************************************************
+ * VALID CONFIG
+ ********************************************************************************************
+ * This function checks every parameter is in the range its detector accepts, OpenCV throws
+ * (and a reload would stop the pipeline) on e.g. an even adaptive threshold block size, a
+ * hough resolution <= 0 or a detectMultiScale scale step <= 1
+ * Output -> false if any value is out of range (each one is reported)
+ * \param c - the configuration
+ */
+static bool validConfig(const Config &c){
+
+    bool ok = true;
+    ok &= checkKey(c.orgPts.empty() || c.orgPts.size() == 4, "ipm");
+    ok &= checkKey(c.blockSizeAt >= 3 && c.blockSizeAt % 2 == 1, "laneDetector: blockSizeAt");
+    ok &= checkKey(c.nSample >= 2, "laneDetector: nSample");
+    ok &= checkKey(c.minVote >= 1, "laneDetector: minVote");
+    ok &= checkKey(c.minLen >= 0, "laneDetector: minLen");
+    ok &= checkKey(c.maxGap >= 0, "laneDetector: maxGap");
+    ok &= checkKey(c.deltaRho > 0, "laneDetector: deltaRho");
+    ok &= checkKey(c.deltaTheta > 0 && c.deltaTheta <= PI, "laneDetector: deltaTheta");
+    ok &= checkKey(c.scaleFactor > 1, "vehicleDetector: scaleFactor");
+    ok &= checkKey(c.minSize >= 0, "vehicleDetector: minSize");
+    ok &= checkKey(c.detectScale > 0 && c.detectScale <= 1, "vehicleDetector: detectScale");
+    ok &= checkKey(c.detectROI.width >= 0 && c.detectROI.height >= 0, "vehicleDetector: detectROI");
+    ok &= checkKey(c.corridorSigma >= 0, "performance: corridorSigma");
+    ok &= checkKey(c.corridorMargin >= 0, "performance: corridorMargin");
+    ok &= checkKey(c.innovationGate > 0, "performance: innovationGate");
+    ok &= checkKey(c.maxRhoStd > 0, "performance: maxRhoStd");
+    ok &= checkKey(c.prefetchDepth >= 1, "performance: prefetchDepth");
+    ok &= checkKey(c.frameBudget >= 0, "performance: frameBudget");
+    ok &= checkKey(c.staticThreshold >= 0, "performance: staticThreshold");
+    ok &= checkKey(c.staticMaxSkip >= 1, "performance: staticMaxSkip");
+    ok &= checkKey(c.outputQueue >= 1, "output: queue");
+    return ok;
+}
+
+/********************************************************************************************
+ * LOAD CONFIG
+ ********************************************************************************************
+ * This function reads a configuration file
+ * Output -> false if the file could not be opened or parsed, or a value is out of range (config is unchanged)
+ * \param fileName - configuration file path and name
+ * \param config - the configuration (missing keys keep their current values)
+ */
+bool loadConfig(const string &fileName, Config &config){
+
+    Config c = config;
+    try {
+        FileStorage fs(fileName, FileStorage::READ);
+        if (!fs.isOpened()){
+            return false;
+        }
+
+        // Inputs
+        readKey(fs.root(), "video", c.videoName);
+        readKey(fs.root(), "cascade", c.cascadeName);
+
+        // IPM points as x1, y1, ..., x4, y4 (an empty sequence selects the defaults)
+        vector<float> pts;
+        if (readSeq(fs.root(), "ipm", pts)){
+            if (!pts.empty() && pts.size() != 8){
+                return false;
+            }
+            c.orgPts.clear();
+            for (size_t i = 0; i + 1 < pts.size(); i += 2){
+                c.orgPts.push_back(Point2f(pts[i], pts[i+1]));
+            }
+        }
+
+        FileNode lane = fs["laneDetector"];
+        readKey(lane, "blockSizeAt", c.blockSizeAt);
+        readKey(lane, "cAt", c.cAt);
+        readKey(lane, "nSample", c.nSample);
+        readKey(lane, "minVote", c.minVote);
+        readKey(lane, "minLen", c.minLen);
+        readKey(lane, "maxGap", c.maxGap);
+        readKey(lane, "deltaRho", c.deltaRho);
+        readKey(lane, "deltaTheta", c.deltaTheta);
+
+        FileNode vehicle = fs["vehicleDetector"];
+        readKey(vehicle, "scaleFactor", c.scaleFactor);
+        readKey(vehicle, "minSize", c.minSize);
+        readKey(vehicle, "detectScale", c.detectScale);
+        readKey(vehicle, "smoothLUT", c.smoothLUT);
+        vector<float> roi;
+        if (readSeq(vehicle, "detectROI", roi)){
+            if (!roi.empty() && roi.size() != 4){
+                return false;
+            }
+            c.detectROI = roi.empty() ? Rect() : Rect(cvRound(roi[0]), cvRound(roi[1]), cvRound(roi[2]), cvRound(roi[3]));
+        }
+
+        FileNode perf = fs["performance"];
+        readKey(perf, "trackingMode", c.trackingMode);
+        readKey(perf, "corridorSigma", c.corridorSigma);
+        readKey(perf, "corridorMargin", c.corridorMargin);
+        readKey(perf, "innovationGate", c.innovationGate);
+        readKey(perf, "maxRhoStd", c.maxRhoStd);
+        readKey(perf, "prefetchDepth", c.prefetchDepth);
+        readKey(perf, "frameBudget", c.frameBudget);
+        readKey(perf, "staticThreshold", c.staticThreshold);
+        readKey(perf, "staticMaxSkip", c.staticMaxSkip);
+
+        FileNode output = fs["output"];
+        readKey(output, "video", c.outputName);
+        readKey(output, "queue", c.outputQueue);
+        readKey(output, "dropFrames", c.outputDrop);
+        readKey(output, "display", c.display);
+        readKey(output, "drawInPlace", c.drawInPlace);
+    } catch (const cv::Exception &){
+        // Parse error (e.g. the file was read while half written)
+        return false;
+    }
+    if (!validConfig(c)){
+        return false;
+    }
+
+    config = c;
+    return true;
+}
+
+/********************************************************************************************
+ * SAVE CONFIG
+ ********************************************************************************************
+ * This function writes every parameter of a configuration
+ * Output -> false if the file could not be written
+ * \param fileName - configuration file path and name
+ * \param config - the configuration
+ */
+bool saveConfig(const string &fileName, const Config &config){
+
+    FileStorage fs(fileName, FileStorage::WRITE);
+    if (!fs.isOpened()){
+        return false;
+    }
+
+    fs << "video" << config.videoName;
+    fs << "cascade" << config.cascadeName;
+    fs << "ipm" << "[";
+    for (size_t i = 0; i < config.orgPts.size(); i++){
+        fs << config.orgPts[i].x << config.orgPts[i].y;
+    }
+    fs << "]";
+
+    fs << "laneDetector" << "{";
+    fs << "blockSizeAt" << config.blockSizeAt << "cAt" << config.cAt << "nSample" << config.nSample;
+    fs << "minVote" << config.minVote << "minLen" << config.minLen << "maxGap" << config.maxGap;
+    fs << "deltaRho" << config.deltaRho << "deltaTheta" << config.deltaTheta;
+    fs << "}";
+
+    fs << "vehicleDetector" << "{";
+    fs << "scaleFactor" << config.scaleFactor << "minSize" << config.minSize << "detectScale" << config.detectScale;
+    fs << "detectROI" << "[";
+    if (config.detectROI.area() > 0){
+        fs << config.detectROI.x << config.detectROI.y << config.detectROI.width << config.detectROI.height;
+    }
+    fs << "]";
+    fs << "smoothLUT" << (int)config.smoothLUT;
+    fs << "}";
+
+    fs << "performance" << "{";
+    fs << "trackingMode" << (int)config.trackingMode << "corridorSigma" << config.corridorSigma;
+    fs << "corridorMargin" << config.corridorMargin << "innovationGate" << config.innovationGate << "maxRhoStd" << config.maxRhoStd;
+    fs << "prefetchDepth" << config.prefetchDepth;
+    fs << "frameBudget" << config.frameBudget;
+    fs << "staticThreshold" << config.staticThreshold << "staticMaxSkip" << config.staticMaxSkip;
+    fs << "}";
+
+    fs << "output" << "{";
+    fs << "video" << config.outputName << "queue" << config.outputQueue;
+    fs << "dropFrames" << (int)config.outputDrop << "display" << (int)config.display;
+    fs << "drawInPlace" << (int)config.drawInPlace;
+    fs << "}";
+
+    return true;
+}
+
+/********************************************************************************************
+ * CONFIG WATCHER
+ ********************************************************************************************
+ * This function publishes the default configuration (start() loads the file)
+ * Output -> no output
+ * \param fileName - configuration file path and name
+ * \param intervalMs - time between checks of the file (ms)
+ */
+ConfigWatcher::ConfigWatcher(const string &fileName_, int intervalMs_) : fileName(fileName_), intervalMs(intervalMs_), current(new Config()),
+    version(0), lastModified(-1), lastSize(-1), running(false) {}
+
+/********************************************************************************************
+ * START
+ ********************************************************************************************
+ * This function loads the file (or writes the defaults if it does not exist) and starts watching it
+ * Output -> false if the file exists but could not be parsed (the defaults are used)
+ */
+bool ConfigWatcher::start(){
+
+    stop();
+
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0){
+        saveConfig(fileName, *get());
+    }
+    bool ok = reload();
+
+    running = true;
+    watcher = std::thread(&ConfigWatcher::watch, this);
+    return ok;
+}
+
+// Stop watching the file
+void ConfigWatcher::stop(){
+    running = false;
+    if (watcher.joinable()){
+        watcher.join();
+    }
+}
+
+/********************************************************************************************
+ * RELOAD
+ ********************************************************************************************
+ * This function parses the file if its modification time (to the nanosecond) or size has changed
+ * The new snapshot starts from the current one so keys missing from the file keep their values
+ * Output -> true if a new snapshot was published
+ */
+bool ConfigWatcher::reload(){
+
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0){
+        return false;
+    }
+    // Seconds alone miss a second write within the same second that keeps the size
+#ifdef __APPLE__
+    long long modified = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    long long modified = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    if (modified == lastModified && (long long)st.st_size == lastSize){
+        return false;
+    }
+    lastModified = modified;
+    lastSize = st.st_size;
+
+    std::shared_ptr<Config> next(new Config(*get()));
+    if (!loadConfig(fileName, *next)){
+        cerr << "Error loading configuration " << fileName << ", keeping the previous parameters" << endl;
+        return false;
+    }
+
+    // Publish the snapshot before the version so a reader that sees the version also sees it
+    next->version = version.load() + 1;
+    std::shared_ptr<const Config> published(next);
+    {
+        std::lock_guard<std::mutex> lock(currentMutex);
+        current.swap(published);
+    }
+    version.store(next->version, std::memory_order_release);
+    return true;
+}
+
+// Check the file until stopped
+void ConfigWatcher::watch(){
+    while (running){
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        if (running && reload()){
+            cerr << "Reloaded configuration " << fileName << " (version " << version.load() << ")" << endl;
+        }
+    }
+}
+
+/********************************************************************************************
+ * POLL
+ ********************************************************************************************
+ * This function checks for a new snapshot (one atomic load unless the file has changed)
+ * Output -> true if snapshot was replaced by a newer one
+ * \param snapshot - the caller's snapshot
+ * \param seenVersion - version of the caller's snapshot (-1 initially)
+ */
+bool ConfigWatcher::poll(std::shared_ptr<const Config> &snapshot, long &seenVersion) const {
+
+    if (version.load(std::memory_order_acquire) == seenVersion){
+        return false;
+    }
+    snapshot = get();
+    seenVersion = snapshot->version;
+    return true;
+}
+
+// Get the current snapshot
+std::shared_ptr<const Config> ConfigWatcher::get() const {
+    std::lock_guard<std::mutex> lock(currentMutex);
+    return current;
+}
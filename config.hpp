@@ -0,0 +1,181 @@
+//
+//  config.hpp
+//  cv_autonomous_vehicle
+//
+//  Detector parameters read from a configuration file, reloaded while running
+//
+
+#ifndef config_hpp
+#define config_hpp
+
+#include "opencv2/core.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+# define PI 3.14159265358979323846  /* pi */
+
+/*
+ * Config -> Every detector parameter, the input names and the performance modes
+ * The defaults are the same as the detector constructor defaults. The file is read with
+ * cv::FileStorage (YAML, XML or JSON) and keys that are missing keep their defaults, so the
+ * file written by autotune.cpp can be used directly.
+ */
+struct Config {
+
+    // Input video and haar cascade file path and name (empty -> not set)
+    std::string videoName;
+    std::string cascadeName;
+
+    // IPM -> Selected 4 points on input image (empty -> LaneDetectorController defaults)
+    std::vector<cv::Point2f> orgPts;
+
+    // Lane detector -> adaptive threshold, number of sample points
+    int blockSizeAt;
+    int cAt;
+    int nSample;
+
+    // Lane detector -> hough transform for finding candidate lines
+    int minVote;
+    double minLen;
+    double maxGap;
+    double deltaRho;
+    double deltaTheta;
+
+    // Vehicle detector -> detectMultiScale scale step and minimum size, downscale, search region
+    double scaleFactor;
+    int minSize;
+    double detectScale;
+    cv::Rect detectROI;
+    bool smoothLUT;
+
+    // Performance modes -> corridor tracking
+    bool trackingMode;
+    float corridorSigma;
+    int corridorMargin;
+    float innovationGate;
+    float maxRhoStd;
+
+    // Performance modes -> frames decoded ahead of the pipeline (FrameSource buffers), per-frame processing
+    // budget in ms before work is shed (0 -> never)
+    int prefetchDepth;
+    double frameBudget;
+    
+    // Performance modes -> reuse the last results while the frame changes less than staticThreshold
+    // (mean absolute gray level difference of a downsampled frame, 0 -> never), at most staticMaxSkip frames in a row
+    double staticThreshold;
+    int staticMaxSkip;
+
+    // Output -> annotated video (empty -> none), encoder queue and policy when it is full, show the result,
+    // draw the overlay straight into the decoded frame
+    std::string outputName;
+    int outputQueue;
+    bool outputDrop;
+    bool display;
+    bool drawInPlace;
+
+    // Counts the snapshots published by ConfigWatcher
+    long version;
+
+    Config() : blockSizeAt(15), cAt(-5), nSample(30), minVote(80), minLen(200), maxGap(30), deltaRho(2.5), deltaTheta(PI/180),
+               scaleFactor(1.1), minSize(100), detectScale(1.0), smoothLUT(false),
+               trackingMode(false), corridorSigma(3), corridorMargin(25), innovationGate(15), maxRhoStd(0.25), prefetchDepth(4), frameBudget(0), staticThreshold(0), staticMaxSkip(30),
+               outputQueue(8), outputDrop(true), display(true), drawInPlace(false), version(0) {}
+};
+
+/********************************************************************************************
+ * LOAD CONFIG
+ ********************************************************************************************
+ * This function reads a configuration file
+ * Output -> false if the file could not be opened or parsed, or a value is out of range (config is unchanged)
+ * \param fileName - configuration file path and name
+ * \param config - the configuration (missing keys keep their current values)
+ */
+bool loadConfig(const std::string &fileName, Config &config);
+
+/********************************************************************************************
+ * SAVE CONFIG
+ ********************************************************************************************
+ * This function writes every parameter of a configuration
+ * Output -> false if the file could not be written
+ * \param fileName - configuration file path and name
+ * \param config - the configuration
+ */
+bool saveConfig(const std::string &fileName, const Config &config);
+
+/*
+ * Config Watcher -> Reloads a configuration file when it changes and publishes immutable snapshots
+ * A background thread polls the modification time of the file. Each successfully parsed
+ * file becomes a new snapshot which is swapped in under a mutex, so readers never see a
+ * partially updated configuration. The pipeline threads only read an atomic version number
+ * per frame and copy the snapshot when it changes, so the hot path takes no locks.
+ */
+class ConfigWatcher {
+
+    private:
+
+        // Configuration file path and name
+        std::string fileName;
+
+        // Time between checks of the file (ms)
+        int intervalMs;
+
+        // Current snapshot (only copied or replaced under currentMutex)
+        std::shared_ptr<const Config> current;
+        mutable std::mutex currentMutex;
+
+        // Version of the current snapshot
+        std::atomic<long> version;
+
+        // Last seen modification time (ns) and size of the file
+        long long lastModified;
+        long long lastSize;
+
+        // Watcher thread
+        std::thread watcher;
+        std::atomic<bool> running;
+
+        // Reload the file if it has changed, true if a new snapshot was published
+        bool reload();
+
+        // Thread function
+        void watch();
+
+    public:
+
+        ConfigWatcher(const std::string &fileName_, int intervalMs_ = 500);
+
+        ~ConfigWatcher(){
+            stop();
+        }
+
+        /********************************************************************************************
+         * START
+         ********************************************************************************************
+         * This function loads the file (or writes the defaults if it does not exist) and starts watching it
+         * Output -> false if the file exists but could not be parsed (the defaults are used)
+         */
+        bool start();
+
+        // Stop watching the file
+        void stop();
+
+        /********************************************************************************************
+         * POLL
+         ********************************************************************************************
+         * This function checks for a new snapshot (one atomic load unless the config has changed)
+         * Output -> true if snapshot was replaced by a newer one
+         * \param snapshot - the caller's snapshot
+         * \param seenVersion - version of the caller's snapshot (-1 initially)
+         */
+        bool poll(std::shared_ptr<const Config> &snapshot, long &seenVersion) const;
+
+        // Get the current snapshot
+        std::shared_ptr<const Config> get() const;
+};
+
+#endif /* config_hpp */
@@ -9,6 +9,8 @@
 #ifndef controller_hpp
 #define controller_hpp
 
+#include "tracer.hpp"
+
 /* 
  * Base Controller -> This is the base controller class
  */
@@ -22,14 +24,26 @@ class Controller {
         // Resulting image
         cv::Mat result;
     
+        // Id of the current frame (counts the frames set)
+        long long frameId;
+    
     public:
     
+        Controller() : frameId(-1) {}
+    
         // Read input frame
         bool setVideoFrame(cv::Mat frame){
             
             image = frame;
+            frameId++;
             return true;
         }
+    
+        // Return the id of the current frame
+        long long getFrameId() const {
+            
+            return frameId;
+        }
         
         // Return input image
         const cv::Mat getInputImage() const {
@@ -40,50 +54,64 @@ class Controller {
         // Perform processing
         virtual void process() {}
     
-        //Draws the lane markers on the original image
-        void drawResult(cv::Mat frame, std::vector<float> points){
-            frame.copyTo(result);
-
-            // plot the lines that could be road
-            cv::line( result, cv::Point (points[0],points[1]), cv::Point (points[2],points[3]), cv::Scalar(255), 8);
-        
-            // plot the lines that could be road
-            cv::line( result, cv::Point (points[4],points[5]), cv::Point (points[6],points[7]), cv::Scalar(255), 8);
-            
+        // Draws the lane markers on the input image
+        void drawResult(const cv::Mat &frame, const std::vector<float> &points){
+            drawResult(frame, points, std::vector<cv::Rect>());
         }
     
         // Draw detected vehicles on input image
-        void drawResult(cv::Mat frame, std::vector<cv::Rect> cars){
-            frame.copyTo(result);
-            
-            for( size_t i = 0; i < cars.size(); i++ ){
-                
-                // Draw the car on the image
-                cv::Point center( cars[i].x + cars[i].width/2, cars[i].y + cars[i].height/2 );
-                ellipse( result, center, cv::Size( cars[i].width/2, cars[i].height/2 ), 0, 0, 360, cv::Scalar( 0, 0, 255 ), 2, 8, 0 );
+        void drawResult(const cv::Mat &frame, const std::vector<cv::Rect> &cars){
+            drawResult(frame, std::vector<float>(), cars);
+        }
+    
+        // Draw detected vehicles and lane markers on a copy of the input image (the frame is not modified)
+        void drawResult(const cv::Mat &frame, const std::vector<float> &points, const std::vector<cv::Rect> &cars){
+            if (result.data == frame.data){
+                result.release();
             }
-            
+            renderResult(frame, points, cars, result);
         }
     
-        // Draw detected vehicles and lane markers on input image
-        void drawResult(cv::Mat frame, std::vector<float> points, std::vector<cv::Rect> cars){
-            frame.copyTo(result);
+        // Draw detected vehicles and lane markers straight into the frame, which saves a copy
+        // Only for frames owned by the caller and not needed after drawing (the result shares its pixels)
+        void drawResultInPlace(cv::Mat &frame, const std::vector<float> &points, const std::vector<cv::Rect> &cars){
+            result = frame;
+            renderResult(frame, points, cars, result);
+        }
+    
+        /********************************************************************************************
+         * RENDER RESULT
+         ********************************************************************************************
+         * This function draws the lane markers and vehicles into a caller owned buffer in one pass
+         * Output -> no output
+         * \param frame - input image
+         * \param points - lane end points (empty -> no lanes)
+         * \param cars - detected vehicles
+         * \param dst - output image, reused if it has the frame's size and type, drawn on without a
+         *               copy if it shares the frame's pixels
+         */
+        void renderResult(const cv::Mat &frame, const std::vector<float> &points, const std::vector<cv::Rect> &cars, cv::Mat &dst) const {
             
-            // plot the lines that could be road
-            cv::line( result, cv::Point (points[0],points[1]), cv::Point (points[2],points[3]), cv::Scalar(255), 8);
+            if (dst.data != frame.data){
+                frame.copyTo(dst);
+            }
             
-            // plot the lines that could be road
-            cv::line( result, cv::Point (points[4],points[5]), cv::Point (points[6],points[7]), cv::Scalar(255), 8);
+            // plot both lines that could be road in one call
+            if (points.size() >= 8){
+                cv::Point lanes[2][2] = { { cv::Point(points[0],points[1]), cv::Point(points[2],points[3]) },
+                                          { cv::Point(points[4],points[5]), cv::Point(points[6],points[7]) } };
+                const cv::Point *curves[2] = { lanes[0], lanes[1] };
+                const int counts[2] = { 2, 2 };
+                cv::polylines( dst, curves, counts, 2, false, cv::Scalar(255), 8);
+            }
             
             for( size_t i = 0; i < cars.size(); i++ ){
                 
                 // Draw the car on the image
                 cv::Point center( cars[i].x + cars[i].width/2, cars[i].y + cars[i].height/2 );
-                ellipse( result, center, cv::Size( cars[i].width/2, cars[i].height/2 ), 0, 0, 360, cv::Scalar( 0, 0, 255 ), 2, 8, 0 );
+                ellipse( dst, center, cv::Size( cars[i].width/2, cars[i].height/2 ), 0, 0, 360, cv::Scalar( 0, 0, 255 ), 2, 8, 0 );
             }
-            
         }
-
     
         // Get the result
         const cv::Mat getLastResult() const {
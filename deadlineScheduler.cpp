@@ -0,0 +1,216 @@
+//
+//  deadlineScheduler.cpp
+//  cv_autonomous_vehicle
+//
+//  Sheds detector work in stages when frames are at risk of missing their deadline
+//
+
+#include "deadlineScheduler.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+/********************************************************************************************
+ * DEADLINE SCHEDULER
+ ********************************************************************************************
+ * This function sets the budget and where decisions are logged
+ * Output -> no output
+ * \param budgetMs_ - per-frame processing budget in ms (0 -> never degrade)
+ * \param log_ - output stream for the decisions (NULL for none)
+ */
+DeadlineScheduler::DeadlineScheduler(double budgetMs_, ostream *log_) : budgetMs(max(budgetMs_, 0.0)), highWater(0.9), lowWater(0.6),
+    settleFrames(10), holdFrames(60), alpha(0.2), vehicleReduction(0.5), maxStage(STAGE_PREDICT_LANES), stage(STAGE_FULL),
+    averageMs(-1), sinceChange(0), frameId(-1), totalMs(0), stats(), log(log_) {
+    
+    fill(enabled, enabled + N_DEGRADE_STAGES, true);
+}
+
+/********************************************************************************************
+ * BEGIN FRAME
+ ********************************************************************************************
+ * This function starts timing a frame and plans its work from the current stage
+ * Vehicles run on even frames and lanes on odd frames once both skip frames, so the two
+ * detectors share the load instead of both running on the same frame. Stages that are not
+ * used are not applied, even when a later stage is reached
+ * Output -> the work to do for the frame
+ * \param frameId_ - id of the frame (alternate frames are skipped by the later stages)
+ */
+FramePlan DeadlineScheduler::beginFrame(long long frameId_){
+
+    frameId = frameId_;
+    frameStart = chrono::steady_clock::now();
+    stats.framesAt[stage]++;
+
+    FramePlan plan;
+    plan.houghP = !applies(STAGE_SKIP_HOUGHP);
+    plan.vehicleScale = applies(STAGE_VEHICLE_SCALE) ? vehicleReduction : 1.0;
+    plan.detectVehicles = !applies(STAGE_VEHICLE_KEYFRAMES) || frameId % 2 == 0;
+    plan.detectLanes = !applies(STAGE_PREDICT_LANES) || frameId % 2 != 0;
+    return plan;
+}
+
+/********************************************************************************************
+ * END FRAME
+ ********************************************************************************************
+ * This function stops timing the frame and degrades or restores work if needed
+ * Output -> processing time of the frame (ms)
+ */
+double DeadlineScheduler::endFrame(){
+
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count();
+    stats.frames++;
+    totalMs += elapsed;
+    stats.meanMs = totalMs / stats.frames;
+    averageMs = averageMs < 0 ? elapsed : alpha*elapsed + (1 - alpha)*averageMs;
+    sinceChange++;
+    if (budgetMs <= 0){
+        return elapsed;
+    }
+    if (elapsed > budgetMs){
+        stats.missed++;
+    }
+
+    // Shed work as soon as the average nears the deadline, restore it only once well clear of it
+    DegradeStage degraded = nextStage(1);
+    if (degraded != stage && sinceChange >= settleFrames && averageMs > highWater*budgetMs){
+        setStage(degraded);
+    } else if (stage > STAGE_FULL && sinceChange >= holdFrames && averageMs < lowWater*budgetMs){
+        setStage(nextStage(-1));
+    }
+    return elapsed;
+}
+
+// Change the stage and log the decision
+void DeadlineScheduler::setStage(DegradeStage next){
+
+    if (log){
+        *log << "frame " << frameId << ": " << averageMs << " ms average for a " << budgetMs << " ms budget, "
+             << (next > stage ? "degrading" : "restoring") << " to stage " << next << " (" << stageName(next) << ")" << endl;
+    }
+    stage = next;
+    sinceChange = 0;
+    stats.changes++;
+}
+
+// Get the next stage used after (step 1) or before (step -1) the current one (the current stage if none)
+DegradeStage DeadlineScheduler::nextStage(int step) const {
+
+    for (int s = stage + step; s >= STAGE_FULL && s <= maxStage; s += step){
+        if (enabled[s]){
+            return (DegradeStage)s;
+        }
+    }
+    return stage;
+}
+
+// Check if a stage is used and reached
+bool DeadlineScheduler::applies(DegradeStage s) const {
+    return enabled[s] && stage >= s;
+}
+
+/********************************************************************************************
+ * REPORT
+ ********************************************************************************************
+ * This function prints the frames missed and the frames processed at each stage
+ * Output -> no output
+ * \param os - the output stream
+ */
+void DeadlineScheduler::report(ostream &os) const {
+
+    os << "Budget: " << budgetMs << " ms, mean: " << stats.meanMs << " ms, missed: " << stats.missed << " of " << stats.frames
+       << " frames, stage changes: " << stats.changes << endl;
+    for (int s = 0; s < N_DEGRADE_STAGES; s++){
+        if (stats.framesAt[s] > 0){
+            os << "  stage " << s << " (" << stageName((DegradeStage)s) << "): " << stats.framesAt[s] << " frames" << endl;
+        }
+    }
+}
+
+// Get the name of a stage
+const char *DeadlineScheduler::stageName(DegradeStage stage){
+
+    switch (stage){
+        case STAGE_FULL:                return "full processing";
+        case STAGE_SKIP_HOUGHP:         return "skip probabilistic hough";
+        case STAGE_VEHICLE_SCALE:       return "reduce vehicle resolution";
+        case STAGE_VEHICLE_KEYFRAMES:   return "vehicles on alternate frames";
+        case STAGE_PREDICT_LANES:       return "lanes predicted on alternate frames";
+        default:                        return "unknown";
+    }
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the per-frame budget in ms
+void DeadlineScheduler::setBudget(double budgetMs_){
+    budgetMs = max(budgetMs_, 0.0);
+    if (budgetMs <= 0 && stage != STAGE_FULL){
+        setStage(STAGE_FULL);
+    }
+}
+
+// Set the fractions of the budget above which work is shed and below which it is restored
+void DeadlineScheduler::setThresholds(double highWater_, double lowWater_){
+    if (lowWater_ > 0 && lowWater_ < highWater_){
+        highWater = highWater_;
+        lowWater = lowWater_;
+    }
+}
+
+// Set the frames to wait after a change before degrading further and before restoring work
+void DeadlineScheduler::setHold(int settleFrames_, int holdFrames_){
+    settleFrames = max(settleFrames_, 1);
+    holdFrames = max(holdFrames_, 1);
+}
+
+// Set the most degraded stage used
+void DeadlineScheduler::setMaxStage(DegradeStage maxStage_){
+    maxStage = min(maxStage_, STAGE_PREDICT_LANES);
+    if (stage > maxStage){
+        setStage(maxStage);
+    }
+}
+
+// Set the stages used, e.g. only the lane stages when vehicles are not detected
+void DeadlineScheduler::setStages(const vector<DegradeStage> &stages){
+    fill(enabled, enabled + N_DEGRADE_STAGES, false);
+    enabled[STAGE_FULL] = true;
+    for (size_t i = 0; i < stages.size(); i++){
+        if (stages[i] >= STAGE_FULL && stages[i] < N_DEGRADE_STAGES){
+            enabled[stages[i]] = true;
+        }
+    }
+    if (!enabled[stage]){
+        setStage(nextStage(-1));
+    }
+}
+
+// Set the fraction of the vehicle detection scale used from STAGE_VEHICLE_SCALE
+void DeadlineScheduler::setVehicleReduction(double reduction){
+    if (reduction > 0 && reduction <= 1.0){
+        vehicleReduction = reduction;
+    }
+}
+
+// Set the output stream for the decisions
+void DeadlineScheduler::setLog(ostream *log_){
+    log = log_;
+}
+
+// Get the per-frame budget in ms
+double DeadlineScheduler::getBudget() const {
+    return budgetMs;
+}
+
+// Get the current stage
+DegradeStage DeadlineScheduler::getStage() const {
+    return stage;
+}
+
+// Get the counters
+SchedulerStats DeadlineScheduler::getStats() const {
+    return stats;
+}
@@ -0,0 +1,165 @@
+//
+//  deadlineScheduler.hpp
+//  cv_autonomous_vehicle
+//
+//  Sheds detector work in stages when frames are at risk of missing their deadline
+//
+
+#ifndef deadlineScheduler_hpp
+#define deadlineScheduler_hpp
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/*
+ * Degrade Stage -> How much work is shed, each stage includes the ones before it
+ */
+enum DegradeStage {
+    STAGE_FULL,                 // every step of both detectors
+    STAGE_SKIP_HOUGHP,          // lane candidates from the standard hough transform only
+    STAGE_VEHICLE_SCALE,        // vehicle detection at a reduced resolution
+    STAGE_VEHICLE_KEYFRAMES,    // vehicle detection on even frames only, the last vehicles are kept in between
+    STAGE_PREDICT_LANES,        // lane detection on odd frames only, the Kalman prediction is used in between
+    N_DEGRADE_STAGES
+};
+
+/*
+ * Frame Plan -> The work to do for one frame
+ */
+struct FramePlan {
+    bool houghP;            // run the probabilistic hough transform
+    bool detectLanes;       // search the frame for lanes (false -> follow the Kalman prediction)
+    bool detectVehicles;    // run the vehicle detector (false -> keep the last vehicles)
+    double vehicleScale;    // fraction of the configured vehicle detection scale
+};
+
+/*
+ * Scheduler Statistics -> Counters of a DeadlineScheduler
+ */
+struct SchedulerStats {
+    long long frames;
+    long long missed;                           // frames that took longer than the budget
+    long long changes;                          // stage changes
+    double meanMs;                              // mean processing time per frame
+    long long framesAt[N_DEGRADE_STAGES];       // frames processed at each stage
+};
+
+/*
+ * Deadline Scheduler -> Keeps the per-frame processing time within a budget
+ * beginFrame() returns the work to do for a frame and endFrame() measures how long it took.
+ * The scheduler keeps a moving average of the processing time. It moves to the next stage when
+ * the average is above highWater of the budget, and back when it is below lowWater. After a
+ * change it waits a few frames for the average to reflect the new stage before degrading again
+ * (settleFrames), and longer before restoring work (holdFrames), so the stage does not oscillate.
+ * Every change is logged with the frame, the average time and the budget.
+ * setStages() limits the stages to those that apply to the detectors being run, the stages
+ * left out are stepped over when degrading and restoring.
+ */
+class DeadlineScheduler {
+
+    private:
+
+        // Deadline and thresholds
+        double budgetMs; // per-frame budget (0 -> never degrade)
+        double highWater; // degrade above this fraction of the budget
+        double lowWater; // restore below this fraction of the budget
+        int settleFrames; // frames after a change before degrading further
+        int holdFrames; // frames after a change before restoring work
+        double alpha; // weight of the latest frame in the moving average
+        double vehicleReduction; // fraction of the vehicle detection scale at STAGE_VEHICLE_SCALE
+        DegradeStage maxStage;
+        bool enabled[N_DEGRADE_STAGES]; // stages used (STAGE_FULL is always used)
+
+        // State
+        DegradeStage stage;
+        double averageMs;
+        int sinceChange;
+        long long frameId;
+        std::chrono::steady_clock::time_point frameStart;
+        double totalMs;
+        SchedulerStats stats;
+
+        // Decisions are written here (NULL -> not logged)
+        std::ostream *log;
+
+        // Change the stage and log the decision
+        void setStage(DegradeStage next);
+    
+        // Get the next stage used after (step 1) or before (step -1) the current one (the current stage if none)
+        DegradeStage nextStage(int step) const;
+    
+        // Check if a stage is used and reached
+        bool applies(DegradeStage s) const;
+
+    public:
+
+        /********************************************************************************************
+         * DEADLINE SCHEDULER
+         ********************************************************************************************
+         * This function sets the budget and where decisions are logged
+         * Output -> no output
+         * \param budgetMs_ - per-frame processing budget in ms (0 -> never degrade)
+         * \param log_ - output stream for the decisions (NULL for none)
+         */
+        DeadlineScheduler(double budgetMs_ = 0, std::ostream *log_ = &std::cout);
+
+        /********************************************************************************************
+         * BEGIN FRAME
+         ********************************************************************************************
+         * This function starts timing a frame and plans its work from the current stage
+         * Output -> the work to do for the frame
+         * \param frameId_ - id of the frame (alternate frames are skipped by the later stages)
+         */
+        FramePlan beginFrame(long long frameId_);
+
+        /********************************************************************************************
+         * END FRAME
+         ********************************************************************************************
+         * This function stops timing the frame and degrades or restores work if needed
+         * Output -> processing time of the frame (ms)
+         */
+        double endFrame();
+
+        // Print the frames missed and the frames processed at each stage
+        void report(std::ostream &os) const;
+
+        // Get the name of a stage
+        static const char *stageName(DegradeStage stage);
+
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+
+        // Set the per-frame budget in ms (0 -> never degrade, the stage goes back to full)
+        void setBudget(double budgetMs_);
+
+        // Set the fractions of the budget above which work is shed and below which it is restored
+        void setThresholds(double highWater_, double lowWater_);
+
+        // Set the frames to wait after a change before degrading further and before restoring work
+        void setHold(int settleFrames_, int holdFrames_);
+
+        // Set the most degraded stage used
+        void setMaxStage(DegradeStage maxStage_);
+    
+        // Set the stages used, e.g. only the lane stages when vehicles are not detected
+        void setStages(const std::vector<DegradeStage> &stages);
+
+        // Set the fraction of the vehicle detection scale used from STAGE_VEHICLE_SCALE
+        void setVehicleReduction(double reduction);
+
+        // Set the output stream for the decisions (NULL for none)
+        void setLog(std::ostream *log_);
+
+        // Get the per-frame budget in ms
+        double getBudget() const;
+
+        // Get the current stage
+        DegradeStage getStage() const;
+
+        // Get the counters
+        SchedulerStats getStats() const;
+};
+
+#endif /* deadlineScheduler_hpp */
@@ -0,0 +1,432 @@
+//
+//  distributed.cpp
+//  cv_autonomous_vehicle
+//
+//  Coordinator and workers for processing clips on several machines
+//
+
+#include "distributed.hpp"
+
+#include "opencv2/videoio.hpp"
+
+#include "offlineProcessor.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+// Send/receive exactly n bytes
+static bool sendAll(int fd, const char *data, size_t n){
+    while (n > 0){
+        ssize_t sent = send(fd, data, n, 0);
+        if (sent <= 0){
+            return false;
+        }
+        data += sent;
+        n -= sent;
+    }
+    return true;
+}
+
+static bool recvAll(int fd, char *data, size_t n){
+    while (n > 0){
+        ssize_t got = recv(fd, data, n, 0);
+        if (got <= 0){
+            return false;
+        }
+        data += got;
+        n -= got;
+    }
+    return true;
+}
+
+// Send/receive one message (type, length, payload)
+static bool sendMessage(int fd, uint32_t type, const string &payload){
+    uint32_t header[2] = { type, (uint32_t)payload.size() };
+    return sendAll(fd, reinterpret_cast<const char*>(header), sizeof(header)) && sendAll(fd, payload.data(), payload.size());
+}
+
+static bool recvMessage(int fd, uint32_t &type, string &payload){
+    uint32_t header[2];
+    if (!recvAll(fd, reinterpret_cast<char*>(header), sizeof(header))){
+        return false;
+    }
+    type = header[0];
+    if (header[1] > MAX_MESSAGE_BYTES){
+        return false;
+    }
+    payload.resize(header[1]);
+    return header[1] == 0 || recvAll(fd, &payload[0], header[1]);
+}
+
+// Write/read a plain value in host byte order
+template<typename T>
+static void putValue(ostream &out, const T &value){
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool getValue(istream &in, T &value){
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+//********************************************************************************************
+//* COORDINATOR
+//********************************************************************************************
+
+/********************************************************************************************
+ * ADD CLIP
+ ********************************************************************************************
+ * This function splits a clip into jobs
+ * Output -> false if the clip could not be opened
+ * \param video_name - video file path and name (the same path must be readable by the workers)
+ * \param chunks - number of jobs (1 -> the whole clip is one job)
+ * \param overlap - frames each chunk warms up on
+ */
+bool Coordinator::addClip(const string &video_name, int chunks, int overlap){
+
+    VideoCapture cap(video_name);
+    if (!cap.isOpened()){
+        return false;
+    }
+    long nFrames = (long)cap.get(CV_CAP_PROP_FRAME_COUNT);
+
+    // Same chunking as OfflineProcessor, the last chunk runs to the end of the video
+    chunks = nFrames > 0 ? (int)max(1L, min((long)max(chunks, 1), nFrames)) : 1;
+    long chunkLen = (nFrames + chunks - 1) / chunks;
+    for (int c = 0; c < chunks; c++){
+        Job job;
+        job.clip = nClips;
+        job.video = video_name;
+        job.begin = c * chunkLen;
+        job.end = c + 1 < chunks ? (c + 1) * chunkLen : -1;
+        job.overlap = overlap;
+        jobs.push_back(job);
+    }
+    nClips++;
+    return true;
+}
+
+/********************************************************************************************
+ * RUN
+ ********************************************************************************************
+ * This function accepts workers until every job has finished
+ * Output -> false if the port could not be opened or a job failed on every attempt
+ * \param clipResults - the result of every frame of each clip, in order
+ */
+bool Coordinator::run(vector<vector<FrameResult> > &clipResults){
+
+    // A worker that disconnects must not kill the coordinator
+    signal(SIGPIPE, SIG_IGN);
+
+    jobResults.assign(jobs.size(), vector<FrameResult>());
+    attempts.assign(jobs.size(), 0);
+    succeeded.assign(jobs.size(), false);
+    pending.clear();
+    for (size_t j = 0; j < jobs.size(); j++){
+        pending.push_back(j);
+    }
+    nFinished = 0;
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd, 16) != 0){
+        cerr << "Error listening on port " << port << endl;
+        if (listenFd >= 0){
+            close(listenFd);
+        }
+        return false;
+    }
+
+    // Accept workers until every job has finished
+    vector<thread> connections;
+    for (;;){
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (nFinished == jobs.size()){
+                break;
+            }
+        }
+        pollfd pfd = { listenFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 200) > 0){
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd >= 0){
+                connections.push_back(thread(&Coordinator::serve, this, fd));
+            }
+        }
+    }
+    close(listenFd);
+
+    // Waiting workers are told there are no jobs left
+    changed.notify_all();
+    for (size_t i = 0; i < connections.size(); i++){
+        connections[i].join();
+    }
+
+    // Merge the chunks of each clip in frame order
+    bool ok = true;
+    clipResults.assign(nClips, vector<FrameResult>());
+    for (size_t j = 0; j < jobs.size(); j++){
+        vector<FrameResult> &out = clipResults[jobs[j].clip];
+        out.insert(out.end(), jobResults[j].begin(), jobResults[j].end());
+        ok = ok && succeeded[j];
+    }
+    return ok;
+}
+
+/********************************************************************************************
+ * SERVE
+ ********************************************************************************************
+ * This function answers the requests of one worker
+ * If the connection ends, or the worker holding a job sends nothing (not even a heartbeat)
+ * for the job timeout, the job is queued again
+ * Output -> no output
+ * \param fd - the connection
+ */
+void Coordinator::serve(int fd){
+
+    timeval timeout = { jobTimeout, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    size_t job = 0;
+    bool holding = false;
+    uint32_t type;
+    string payload;
+    while (recvMessage(fd, type, payload)){
+
+        if (type == MSG_REQUEST && !holding){
+            if (!nextJob(job)){
+                sendMessage(fd, MSG_DONE, "");
+                break;
+            }
+            holding = true;
+
+            ostringstream msg;
+            const Job &j = jobs[job];
+            putValue(msg, (int64_t)job);
+            putValue(msg, (int64_t)j.begin);
+            putValue(msg, (int64_t)j.end);
+            putValue(msg, (int32_t)j.overlap);
+            putValue(msg, (uint32_t)j.video.size());
+            msg.write(j.video.data(), j.video.size());
+            if (!sendMessage(fd, MSG_JOB, msg.str())){
+                break;
+            }
+            continue;
+        }
+
+        // The result must be for the job the worker holds
+        istringstream in(payload);
+        int64_t id;
+        if (!holding || (type != MSG_RESULT && type != MSG_FAILED && type != MSG_HEARTBEAT) || !getValue(in, id) || (size_t)id != job){
+            break;
+        }
+        if (type == MSG_HEARTBEAT){
+            continue;
+        }
+        if (type == MSG_FAILED){
+            holding = false;
+            jobFinished(job, false, NULL);
+            continue;
+        }
+
+        uint32_t n;
+        vector<FrameResult> results;
+        bool ok = getValue(in, n);
+        for (uint32_t i = 0; ok && i < n; i++){
+            FrameResult res;
+            ok = readFrameResult(in, res);
+            results.push_back(res);
+        }
+        if (!ok){
+            break;
+        }
+        holding = false;
+        jobFinished(job, true, &results);
+    }
+
+    // Reassign the job of a worker that failed
+    if (holding){
+        cerr << "Worker lost while processing job " << job << endl;
+        jobFinished(job, false, NULL);
+    }
+    close(fd);
+}
+
+/********************************************************************************************
+ * NEXT JOB
+ ********************************************************************************************
+ * This function waits for a job to hand out
+ * A worker waits while the last jobs are running, in case one of them fails and is queued again
+ * Output -> false when every job has finished
+ * \param job - index of the job
+ */
+bool Coordinator::nextJob(size_t &job){
+
+    unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this](){ return !pending.empty() || nFinished == jobs.size(); });
+    if (pending.empty()){
+        return false;
+    }
+    job = pending.front();
+    pending.pop_front();
+    return true;
+}
+
+/********************************************************************************************
+ * JOB FINISHED
+ ********************************************************************************************
+ * This function records the outcome of a job (a failed job is queued again)
+ * Output -> no output
+ * \param job - index of the job
+ * \param ok - the job succeeded
+ * \param results - the results of the job (if it succeeded)
+ */
+void Coordinator::jobFinished(size_t job, bool ok, vector<FrameResult> *results){
+
+    lock_guard<std::mutex> lock(mutex);
+    if (ok){
+        jobResults[job].swap(*results);
+        succeeded[job] = true;
+        nFinished++;
+    } else if (++attempts[job] < maxAttempts){
+        pending.push_back(job);
+    } else {
+        cerr << "Giving up on job " << job << " (" << jobs[job].video << " from frame " << jobs[job].begin << ")" << endl;
+        nFinished++;
+    }
+    changed.notify_all();
+}
+
+// Set the time a worker has to return a job (s) and the attempts before a job is given up
+void Coordinator::setRetry(int timeoutSeconds, int attempts_){
+    // A shorter timeout would expire before the first heartbeat and requeue every job
+    jobTimeout = max(2 * HEARTBEAT_SECONDS, timeoutSeconds);
+    maxAttempts = max(1, attempts_);
+}
+
+//********************************************************************************************
+//* WORKER
+//********************************************************************************************
+
+/********************************************************************************************
+ * RUN
+ ********************************************************************************************
+ * This function requests and processes jobs until the coordinator has none left
+ * Output -> number of jobs processed, -1 if the coordinator could not be reached
+ */
+int Worker::run(){
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // Resolve the coordinator and connect (it may still be starting)
+    addrinfo hints, *info = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &info) != 0){
+        return -1;
+    }
+    int fd = -1;
+    for (int attempt = 0; attempt < 20 && fd < 0; attempt++){
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) != 0){
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0){
+            this_thread::sleep_for(chrono::milliseconds(500));
+        }
+    }
+    freeaddrinfo(info);
+    if (fd < 0){
+        return -1;
+    }
+
+    int processed = 0;
+    uint32_t type;
+    string payload;
+    while (sendMessage(fd, MSG_REQUEST, "") && recvMessage(fd, type, payload) && type == MSG_JOB){
+
+        // Decode the job
+        istringstream in(payload);
+        int64_t id, begin, end;
+        int32_t overlap;
+        uint32_t len;
+        if (!getValue(in, id) || !getValue(in, begin) || !getValue(in, end) || !getValue(in, overlap) || !getValue(in, len)){
+            break;
+        }
+        string video(len, '\0');
+        if (len > 0 && !in.read(&video[0], len)){
+            break;
+        }
+
+        // Process the chunk with the same pipeline as an offline run
+        OfflineProcessor processor(video, config, cascadeName);
+        processor.setOverlap(overlap);
+        vector<FrameResult> results;
+        ostringstream msg;
+        putValue(msg, id);
+
+        // Heartbeats tell the coordinator the job is still running (only this thread sends until it is joined)
+        std::mutex heartbeatMutex;
+        condition_variable stop;
+        bool finished = false;
+        string heartbeat = msg.str();
+        thread beat([&](){
+            unique_lock<std::mutex> lock(heartbeatMutex);
+            while (!stop.wait_for(lock, chrono::seconds(HEARTBEAT_SECONDS), [&finished](){ return finished; })){
+                sendMessage(fd, MSG_HEARTBEAT, heartbeat);
+            }
+        });
+        bool ok = processor.processChunk((long)begin, (long)end, results);
+        {
+            lock_guard<std::mutex> lock(heartbeatMutex);
+            finished = true;
+        }
+        stop.notify_all();
+        beat.join();
+
+        if (!ok){
+            cerr << "Error opening " << video << endl;
+            if (!sendMessage(fd, MSG_FAILED, msg.str())){
+                break;
+            }
+            continue;
+        }
+
+        putValue(msg, (uint32_t)results.size());
+        for (size_t i = 0; i < results.size(); i++){
+            writeFrameResult(msg, results[i]);
+        }
+        if (!sendMessage(fd, MSG_RESULT, msg.str())){
+            break;
+        }
+        processed++;
+    }
+
+    close(fd);
+    return processed;
+}
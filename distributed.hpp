@@ -0,0 +1,148 @@
+//
+//  distributed.hpp
+//  cv_autonomous_vehicle
+//
+//  Coordinator and workers for processing clips on several machines
+//
+
+#ifndef distributed_hpp
+#define distributed_hpp
+
+#include "config.hpp"
+#include "frameResult.hpp"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Messages of the coordinator/worker protocol
+ * Each message is a uint32 type and a uint32 payload length followed by the payload (host byte order)
+ * A message longer than MAX_MESSAGE_BYTES closes the connection
+ */
+enum MessageType {
+    MSG_REQUEST = 1,    // worker -> coordinator, asks for a job (no payload)
+    MSG_JOB,            // coordinator -> worker, int64 job id, int64 begin, int64 end, int32 overlap, uint32 length, video
+    MSG_DONE,           // coordinator -> worker, no jobs are left (no payload)
+    MSG_RESULT,         // worker -> coordinator, int64 job id, uint32 number of frames, FrameResult records
+    MSG_FAILED,         // worker -> coordinator, int64 job id (the worker could not open the video or cascade)
+    MSG_HEARTBEAT       // worker -> coordinator, int64 job id (sent every HEARTBEAT_SECONDS while the job runs)
+};
+
+// Longest payload accepted (the length comes from the peer)
+const uint32_t MAX_MESSAGE_BYTES = 1u << 28;
+
+// Time between the heartbeats of a worker processing a job (s)
+const int HEARTBEAT_SECONDS = 5;
+
+/*
+ * Job -> A chunk of a clip processed by one worker
+ */
+struct Job {
+    size_t clip;
+    std::string video;
+    long begin, end;    // frames [begin, end), end < 0 -> until the video ends
+    int overlap;        // frames the LaneTracker warms up on before begin
+};
+
+/*
+ * Coordinator -> Hands out jobs to the workers that connect and merges their results
+ * Each worker connection is served by its own thread. A worker sends a heartbeat while it
+ * processes a job, so the job timeout limits the time without any message from the worker, not
+ * the length of the job. A job is reassigned if its worker disconnects, is silent for longer
+ * than the timeout or reports a failure, up to a maximum number of attempts. The results of the chunks of each clip are merged in frame order.
+ */
+class Coordinator {
+
+    private:
+
+        // Port the coordinator listens on
+        int port;
+
+        // Time a worker holding a job may go without sending a message (s), attempts before a job is given up
+        int jobTimeout;
+        int maxAttempts;
+
+        // Jobs and their results
+        std::vector<Job> jobs;
+        std::vector<std::vector<FrameResult> > jobResults;
+        std::vector<int> attempts;
+        std::vector<bool> succeeded;
+        size_t nClips;
+
+        // Jobs waiting for a worker, jobs finished (succeeded or given up)
+        std::deque<size_t> pending;
+        size_t nFinished;
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        // Serve one worker connection
+        void serve(int fd);
+
+        // Wait for a job to hand out, false when every job has finished
+        bool nextJob(size_t &job);
+
+        // Record the outcome of a job (a failed job is queued again)
+        void jobFinished(size_t job, bool ok, std::vector<FrameResult> *results);
+
+    public:
+
+        Coordinator(int port_) : port(port_), jobTimeout(60), maxAttempts(3), nClips(0), nFinished(0) {}
+
+        /********************************************************************************************
+         * ADD CLIP
+         ********************************************************************************************
+         * This function splits a clip into jobs
+         * Output -> false if the clip could not be opened
+         * \param video_name - video file path and name (the same path must be readable by the workers)
+         * \param chunks - number of jobs (1 -> the whole clip is one job)
+         * \param overlap - frames each chunk warms up on
+         */
+        bool addClip(const std::string &video_name, int chunks = 1, int overlap = 30);
+
+        /********************************************************************************************
+         * RUN
+         ********************************************************************************************
+         * This function accepts workers until every job has finished
+         * Output -> false if the port could not be opened or a job failed on every attempt
+         * \param clipResults - the result of every frame of each clip, in order
+         */
+        bool run(std::vector<std::vector<FrameResult> > &clipResults);
+
+        // Set the time a worker may go without a message (s, at least 2*HEARTBEAT_SECONDS) and the attempts before a job is given up
+        void setRetry(int timeoutSeconds, int attempts_);
+};
+
+/*
+ * Worker -> Connects to a coordinator and processes jobs until there are none left
+ */
+class Worker {
+
+    private:
+
+        // Coordinator address
+        std::string host;
+        int port;
+
+        // Parameters and haar cascade (empty for lane detection only)
+        Config config;
+        std::string cascadeName;
+
+    public:
+
+        Worker(const std::string &host_, int port_, const Config &config_ = Config(), const std::string &car_cascade_name = "") :
+            host(host_), port(port_), config(config_), cascadeName(car_cascade_name) {}
+
+        /********************************************************************************************
+         * RUN
+         ********************************************************************************************
+         * This function requests and processes jobs until the coordinator has none left
+         * Output -> number of jobs processed, -1 if the coordinator could not be reached
+         */
+        int run();
+};
+
+#endif /* distributed_hpp */
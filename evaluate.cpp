@@ -0,0 +1,239 @@
+//
+//  evaluate.cpp
+//  cv_autonomous_vehicle
+//
+//  Accuracy versus throughput of the lane detection performance modes
+//
+
+#include <opencv2/core.hpp>
+#include "opencv2/highgui.hpp"
+
+#include "laneDetectorController.hpp"
+
+#include "laneTracker.hpp"
+#include "laneEvaluator.hpp"
+#include "roadGenerator.hpp"
+#include "profiler.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+/*
+ * Evaluation Mode -> A performance mode of the lane detector
+ */
+struct EvalMode {
+    const char *name;
+    bool tracking;      // search only a corridor around the Kalman prediction
+};
+
+// The available performance modes
+static const EvalMode MODES[] = {
+    { "full", false },
+    { "tracking", true },
+};
+static const int N_MODES = sizeof(MODES) / sizeof(MODES[0]);
+
+/*
+ * Mode Result -> Accuracy and throughput of one mode
+ */
+struct ModeResult {
+    string name;
+    LaneEvaluator eval;
+    int frames;
+    double seconds;
+    vector<StageStats> stages;
+};
+
+/********************************************************************************************
+ * RUN MODE
+ ********************************************************************************************
+ * This function runs the lane detector in one mode over every labelled clip
+ * Output -> false if an image could not be read
+ * \param mode - the performance mode
+ * \param root - dataset root directory
+ * \param labels - the labels
+ * \param sequence - process the preceding frames of each clip
+ * \param res - the accuracy and throughput of the mode
+ */
+static bool runMode(const EvalMode &mode, const string &root, const vector<LaneLabel> &labels, bool sequence, ModeResult &res){
+
+    res.name = mode.name;
+    res.eval.reset();
+    res.frames = 0;
+    res.seconds = 0;
+    Profiler::reset();
+
+    vector<Point2f> orgPts;
+    for (size_t l = 0; l < labels.size(); l++){
+
+        // Clips are independent so the tracker starts again for each
+        LaneDetectorController lController;
+        LaneTracker lTracker, rTracker;
+        lTracker.initKalman(0, 0);
+        rTracker.initKalman(0, 0);
+        lController.initKalman(lTracker, rTracker);
+        lController.setTrackingMode(mode.tracking);
+
+        vector<string> frames = LaneEvaluator::clipFrames(root, labels[l], sequence);
+        Mat frame;
+        for (size_t i = 0; i < frames.size(); i++){
+            frame = imread(frames[i]);
+            if (frame.empty()){
+                cout << "Error reading image " << frames[i] << endl;
+                return false;
+            }
+
+            // Only the lane detection is timed (not reading the image)
+            double start = (double)getTickCount();
+            lController.setVideoFrame(frame);
+            lController.initIPM(orgPts);
+            lController.process();
+            res.seconds += ((double)getTickCount() - start) / getTickFrequency();
+            res.frames++;
+        }
+
+        res.eval.addFrame(labels[l], frame.cols, lController.getPoints());
+    }
+
+    res.stages = Profiler::summary();
+    return true;
+}
+
+/********************************************************************************************
+ * RUN SYNTHETIC MODE
+ ********************************************************************************************
+ * This function runs the lane detector in one mode over a generated road, labelling every frame
+ * Output -> no output
+ * \param mode - the performance mode
+ * \param nFrames - number of frames to generate
+ * \param res - the accuracy and throughput of the mode
+ */
+static void runSyntheticMode(const EvalMode &mode, int nFrames, ModeResult &res){
+
+    res.name = mode.name;
+    res.eval.reset();
+    res.frames = 0;
+    res.seconds = 0;
+    Profiler::reset();
+
+    RoadGenerator road(Size(1920, 1080), 1);
+    road.setDashed(true);
+    road.setCurvature(2e-4);
+    road.setLighting(0.2, 8);
+    road.setOccluders(2);
+
+    LaneDetectorController lController;
+    LaneTracker lTracker, rTracker;
+    lTracker.initKalman(0, 0);
+    rTracker.initKalman(0, 0);
+    lController.initKalman(lTracker, rTracker);
+    lController.setTrackingMode(mode.tracking);
+
+    vector<Point2f> orgPts;
+    Mat frame;
+    LaneLabel label;
+    label.hSamples = road.getSampleRows();
+    label.lanes.resize(2);
+    for (int i = 0; i < nFrames; i++){
+        road.nextFrame(frame);
+
+        double start = (double)getTickCount();
+        lController.setVideoFrame(frame);
+        lController.initIPM(orgPts);
+        lController.process();
+        res.seconds += ((double)getTickCount() - start) / getTickFrequency();
+        res.frames++;
+
+        // Ground truth of the generated frame in the same form as a TuSimple label
+        for (int side = 0; side < 2; side++){
+            const vector<float> &x = road.getLaneX(side);
+            label.lanes[side].assign(x.begin(), x.end());
+        }
+        res.eval.addFrame(label, frame.cols, lController.getPoints());
+    }
+
+    res.stages = Profiler::summary();
+}
+
+/********************************************************************************************
+ * WRITE TABLE
+ ********************************************************************************************
+ * This function prints the accuracy, throughput and per-stage latency of each mode
+ * Output -> no output
+ * \param results - the result of each mode
+ */
+static void writeTable(const vector<ModeResult> &results){
+
+    for (size_t m = 0; m < results.size(); m++){
+        const ModeResult &r = results[m];
+        cout << "mode: " << r.name << endl;
+        cout << "frames,fps,precision,recall,f1,lateral_error_px" << endl;
+        cout << r.frames << "," << (r.seconds > 0 ? r.frames / r.seconds : 0) << "," << r.eval.getPrecision() << ","
+             << r.eval.getRecall() << "," << r.eval.getF1() << "," << r.eval.getLateralError() << endl;
+
+        // Only available when built with -DENABLE_PROFILING
+        if (!r.stages.empty()){
+            cout << "stage,count,mean_us,p50_us,p95_us,p99_us,max_us" << endl;
+            for (size_t s = 0; s < r.stages.size(); s++){
+                const StageStats &st = r.stages[s];
+                cout << st.name << "," << st.count << "," << st.mean << "," << st.p50 << "," << st.p95 << "," << st.p99 << "," << st.max << endl;
+            }
+        }
+        cout << endl;
+    }
+}
+
+int main(int argc, char **argv) {
+
+    string labels_name = argc > 1 ? argv[1] : "";
+
+    // Options
+    string root = ".";
+    bool sequence = true;
+    int nFrames = 300;
+    double pixelThresh = 20, accuracyThresh = 0.85;
+    for (int i = 2; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--root" && hasValue){
+            root = argv[++i];
+        } else if (arg == "--frames" && hasValue){
+            nFrames = atoi(argv[++i]);
+        } else if (arg == "--pixel-thresh" && hasValue){
+            pixelThresh = atof(argv[++i]);
+        } else if (arg == "--accuracy-thresh" && hasValue){
+            accuracyThresh = atof(argv[++i]);
+        } else if (arg == "--single"){
+            sequence = false;
+        }
+    }
+
+    if (labels_name.empty()){
+        cout << "Usage: " << argv[0] << " <label json> [--root dataset directory] [--single] [--pixel-thresh px] [--accuracy-thresh fraction]" << endl;
+        cout << "       " << argv[0] << " synthetic [--frames n]" << endl;
+        return -1;
+    }
+
+    vector<LaneLabel> labels;
+    if (labels_name != "synthetic" && !LaneEvaluator::loadTuSimple(labels_name, labels)){
+        cout << "Error reading labels " << labels_name << endl;
+        return -1;
+    }
+
+    vector<ModeResult> results(N_MODES);
+    for (int m = 0; m < N_MODES; m++){
+        results[m].eval.setThresholds(pixelThresh, accuracyThresh);
+        if (labels_name == "synthetic"){
+            runSyntheticMode(MODES[m], nFrames, results[m]);
+        } else if (!runMode(MODES[m], root, labels, sequence, results[m])){
+            return -1;
+        }
+    }
+
+    writeTable(results);
+    return 0;
+}
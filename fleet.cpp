@@ -0,0 +1,110 @@
+//
+//  fleet.cpp
+//  cv_autonomous_vehicle
+//
+//  Reprocessing of recorded clips spread over several worker processes or machines
+//
+
+#include <opencv2/core.hpp>
+
+#include "distributed.hpp"
+#include "config.hpp"
+#include "frameResult.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+int main(int argc, char **argv) {
+
+    string mode = argc > 1 ? argv[1] : "";
+
+    // Options
+    string host = "127.0.0.1", car_cascade_name, config_name, out_name = "results";
+    int port = 5555, nChunks = 1, overlap = 30, timeout = 60, attempts = 3;
+    vector<string> clips;
+    for (int i = 2; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue){
+            host = argv[++i];
+        } else if (arg == "--port" && hasValue){
+            port = atoi(argv[++i]);
+        } else if (arg == "--chunks" && hasValue){
+            nChunks = atoi(argv[++i]);
+        } else if (arg == "--overlap" && hasValue){
+            overlap = atoi(argv[++i]);
+        } else if (arg == "--timeout" && hasValue){
+            timeout = atoi(argv[++i]);
+        } else if (arg == "--attempts" && hasValue){
+            attempts = atoi(argv[++i]);
+        } else if (arg == "--cascade" && hasValue){
+            car_cascade_name = argv[++i];
+        } else if (arg == "--config" && hasValue){
+            config_name = argv[++i];
+        } else if (arg == "--out" && hasValue){
+            out_name = argv[++i];
+        } else {
+            clips.push_back(arg);
+        }
+    }
+
+    if (mode == "coordinator" && !clips.empty()){
+
+        Coordinator coordinator(port);
+        coordinator.setRetry(timeout, attempts);
+        for (size_t c = 0; c < clips.size(); c++){
+            if (!coordinator.addClip(clips[c], nChunks, overlap)){
+                cout << "Error opening " << clips[c] << endl;
+                return -1;
+            }
+        }
+
+        double start = (double)getTickCount();
+        vector<vector<FrameResult> > results;
+        bool ok = coordinator.run(results);
+        double seconds = ((double)getTickCount() - start) / getTickFrequency();
+
+        // One file of FrameResult records per clip, in order
+        long total = 0;
+        for (size_t c = 0; c < results.size(); c++){
+            string name = out_name + "_" + to_string(c) + ".bin";
+            ofstream out(name.c_str(), ios::binary);
+            for (size_t i = 0; i < results[c].size(); i++){
+                writeFrameResult(out, results[c][i]);
+            }
+            cout << clips[c] << ": " << results[c].size() << " frames -> " << name << endl;
+            total += results[c].size();
+        }
+        cout << total << " frames in " << seconds << " s (" << total / seconds << " fps)" << endl;
+        return ok ? 0 : 1;
+    }
+    if (mode == "worker"){
+
+        Config config;
+        if (!config_name.empty() && !loadConfig(config_name, config)){
+            cout << "Error reading configuration " << config_name << endl;
+            return -1;
+        }
+
+        // One job at a time per worker process, so OpenCV may use the cores of the machine
+        Worker worker(host, port, config, car_cascade_name);
+        int processed = worker.run();
+        if (processed < 0){
+            cout << "Error connecting to " << host << ":" << port << endl;
+            return -1;
+        }
+        cout << "Processed " << processed << " jobs" << endl;
+        return 0;
+    }
+
+    cout << "Usage: " << argv[0] << " coordinator clip... [--port 5555] [--chunks n] [--overlap 30] [--timeout s] [--attempts 3] [--out results]" << endl;
+    cout << "       " << argv[0] << " worker [--host 127.0.0.1] [--port 5555] [--cascade file] [--config file]" << endl;
+    cout << "Workers send a heartbeat every " << HEARTBEAT_SECONDS << " s while processing, so --timeout is the time a worker may" << endl;
+    cout << "go silent before its job is reassigned (not the length of a job), at least " << 2 * HEARTBEAT_SECONDS << " s" << endl;
+    return -1;
+}
@@ -0,0 +1,108 @@
+//
+//  frameResult.cpp
+//  cv_autonomous_vehicle
+//
+//  Per-frame output of the lane and vehicle detection pipelines
+//
+
+#include "frameResult.hpp"
+
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+// Write/read a plain value in host byte order
+template<typename T>
+static void writeValue(ostream &out, const T &value){
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool readValue(istream &in, T &value){
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+/********************************************************************************************
+ * WRITE FRAME RESULT
+ ********************************************************************************************
+ * This function writes a frame result in a compact binary form (host byte order)
+ * Layout -> int64 frame id, float64 timestamp, uint8 number of points, float32 points,
+ * uint16 number of cars, int32 x,y,width,height per car
+ * Output -> false if the stream failed
+ * \param out - binary output stream
+ * \param res - the frame result
+ */
+bool writeFrameResult(ostream &out, const FrameResult &res){
+
+    writeValue(out, (int64_t)res.frameId);
+    writeValue(out, res.timestamp);
+
+    uint8_t nPoints = (uint8_t)min(res.points.size(), (size_t)255);
+    writeValue(out, nPoints);
+    if (nPoints > 0){
+        out.write(reinterpret_cast<const char*>(&res.points[0]), nPoints * sizeof(float));
+    }
+
+    uint16_t nCars = (uint16_t)min(res.cars.size(), (size_t)65535);
+    writeValue(out, nCars);
+    for (size_t i = 0; i < nCars; i++){
+        int32_t rect[4] = { res.cars[i].x, res.cars[i].y, res.cars[i].width, res.cars[i].height };
+        out.write(reinterpret_cast<const char*>(rect), sizeof(rect));
+    }
+
+    return out.good();
+}
+
+/********************************************************************************************
+ * READ FRAME RESULT
+ ********************************************************************************************
+ * This function reads a frame result written by writeFrameResult
+ * Output -> false if the stream ended or the record is malformed
+ * \param in - binary input stream
+ * \param res - the frame result
+ */
+bool readFrameResult(istream &in, FrameResult &res){
+
+    int64_t frameId;
+    uint8_t nPoints;
+    if (!readValue(in, frameId) || !readValue(in, res.timestamp) || !readValue(in, nPoints)){
+        return false;
+    }
+    res.frameId = frameId;
+
+    res.points.resize(nPoints);
+    if (nPoints > 0 && !in.read(reinterpret_cast<char*>(&res.points[0]), nPoints * sizeof(float))){
+        return false;
+    }
+
+    uint16_t nCars;
+    if (!readValue(in, nCars)){
+        return false;
+    }
+    res.cars.resize(nCars);
+    for (size_t i = 0; i < nCars; i++){
+        int32_t rect[4];
+        if (!in.read(reinterpret_cast<char*>(rect), sizeof(rect))){
+            return false;
+        }
+        res.cars[i] = Rect(rect[0], rect[1], rect[2], rect[3]);
+    }
+
+    return true;
+}
+
+/********************************************************************************************
+ * INTERSECTION OVER UNION
+ ********************************************************************************************
+ * This function calculates the overlap of two rectangles
+ * Output -> area of the intersection divided by the area of the union
+ * \param a - first rectangle
+ * \param b - second rectangle
+ */
+double intersectionOverUnion(const Rect &a, const Rect &b){
+
+    double inter = (a & b).area();
+    double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0;
+}
@@ -0,0 +1,72 @@
+//
+//  frameResult.hpp
+//  cv_autonomous_vehicle
+//
+//  Per-frame output of the lane and vehicle detection pipelines
+//
+
+#ifndef frameResult_hpp
+#define frameResult_hpp
+
+#include "opencv2/core.hpp"
+
+#include <iostream>
+#include <vector>
+
+/*
+ * Frame Result -> The lane marker points and detected vehicles for one frame
+ */
+struct FrameResult {
+
+    // Id of the frame (counts from 0 from the start of the clip)
+    long long frameId;
+
+    // Position of the frame in the video (ms)
+    double timestamp;
+
+    // x1,y1,x2,y2 of the left line followed by the right line (LaneDetectorController::getPoints)
+    std::vector<float> points;
+
+    // Detected vehicles (VehicleDetectorController::getCars)
+    std::vector<cv::Rect> cars;
+
+    // Rho, theta found for the left then right lane, the Kalman prediction and state of each (not
+    // written by writeFrameResult, see LaneDetectorController::getLines, getPredicted and getTrackerState)
+    std::vector<float> lines;
+    std::vector<float> predicted;
+    std::vector<float> state;
+
+    FrameResult() : frameId(-1), timestamp(0) {}
+};
+
+/********************************************************************************************
+ * WRITE FRAME RESULT
+ ********************************************************************************************
+ * This function writes a frame result in a compact binary form (host byte order)
+ * Output -> false if the stream failed
+ * \param out - binary output stream
+ * \param res - the frame result
+ */
+bool writeFrameResult(std::ostream &out, const FrameResult &res);
+
+/********************************************************************************************
+ * READ FRAME RESULT
+ ********************************************************************************************
+ * This function reads a frame result written by writeFrameResult
+ * Output -> false if the stream ended or the record is malformed
+ * \param in - binary input stream
+ * \param res - the frame result
+ */
+bool readFrameResult(std::istream &in, FrameResult &res);
+
+/********************************************************************************************
+ * INTERSECTION OVER UNION
+ ********************************************************************************************
+ * This function calculates the overlap of two rectangles
+ * Output -> area of the intersection divided by the area of the union
+ * \param a - first rectangle
+ * \param b - second rectangle
+ */
+double intersectionOverUnion(const cv::Rect &a, const cv::Rect &b);
+
+#endif /* frameResult_hpp */
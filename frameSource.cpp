@@ -0,0 +1,175 @@
+//
+//  frameSource.cpp
+//  cv_autonomous_vehicle
+//
+//  Video input decoded ahead of the pipeline into a reusable set of frame buffers
+//
+
+#include "frameSource.hpp"
+
+#include <chrono>
+
+using namespace cv;
+using namespace std;
+
+/********************************************************************************************
+ * OPEN
+ ********************************************************************************************
+ * This function opens a video and starts decoding it
+ * Output -> false if the video could not be opened
+ * \param video_name - video file path and name
+ */
+bool FrameSource::open(const string &video_name){
+
+    close();
+    if (!cap.open(video_name)){
+        return false;
+    }
+    fps = cap.get(CV_CAP_PROP_FPS);
+
+    // Frames still held from a previous video keep the old pool alive
+    pool = make_shared<Pool>();
+    pool->slots.resize(depth);
+    for (int i = 0; i < depth; i++){
+        pool->free.push_back(i);
+    }
+    pool->ended = false;
+    pool->closing = false;
+    pool->stats = FrameSourceStats();
+
+    decoder = thread(&FrameSource::decode, this);
+    return true;
+}
+
+// Stop the decoder and close the video (frames still held stay valid)
+void FrameSource::close(){
+
+    if (decoder.joinable()){
+        {
+            lock_guard<mutex> lock(pool->mutex);
+            pool->closing = true;
+        }
+        pool->changed.notify_all();
+        decoder.join();
+    }
+    cap.release();
+}
+
+/********************************************************************************************
+ * DECODE
+ ********************************************************************************************
+ * This function reads frames into free buffers until the video ends or the source is closed
+ * Output -> no output
+ */
+void FrameSource::decode(){
+
+    shared_ptr<Pool> p = pool;
+    long long index = 0;
+    for (;;){
+
+        // Wait for a buffer the consumers have released
+        size_t slot;
+        {
+            unique_lock<mutex> lock(p->mutex);
+            if (p->free.empty() && !p->closing){
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                p->changed.wait(lock, [&p](){ return !p->free.empty() || p->closing; });
+                p->stats.decoderStalls++;
+                p->stats.decoderWaitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            }
+            if (p->closing){
+                break;
+            }
+            slot = p->free.front();
+            p->free.pop_front();
+        }
+
+        // The buffer is not shared while it is free, so read() decodes into it in place
+        SourceFrame &frame = p->slots[slot];
+        bool ok = cap.read(frame.image) && !frame.image.empty();
+        frame.index = index++;
+        frame.timestamp = ok ? cap.get(CV_CAP_PROP_POS_MSEC) : 0;
+
+        {
+            lock_guard<mutex> lock(p->mutex);
+            if (!ok){
+                p->free.push_back(slot);
+                break;
+            }
+            p->ready.push_back(slot);
+            p->stats.decoded++;
+        }
+        p->changed.notify_all();
+    }
+
+    {
+        lock_guard<mutex> lock(p->mutex);
+        p->ended = true;
+    }
+    p->changed.notify_all();
+}
+
+/********************************************************************************************
+ * NEXT
+ ********************************************************************************************
+ * This function waits for the next decoded frame
+ * Output -> the frame (NULL when the video has ended), its buffer is reused once released
+ */
+shared_ptr<const SourceFrame> FrameSource::next(){
+
+    if (!pool){
+        return shared_ptr<const SourceFrame>();
+    }
+
+    shared_ptr<Pool> p = pool;
+    unique_lock<mutex> lock(p->mutex);
+    if (p->ready.empty() && !p->ended){
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        p->changed.wait(lock, [&p](){ return !p->ready.empty() || p->ended; });
+        p->stats.consumerStalls++;
+        p->stats.consumerWaitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    if (p->ready.empty()){
+        return shared_ptr<const SourceFrame>();
+    }
+    size_t slot = p->ready.front();
+    p->ready.pop_front();
+
+    // The deleter hands the buffer back instead of freeing it
+    return shared_ptr<const SourceFrame>(&p->slots[slot], [p, slot](const SourceFrame *){ release(p, slot); });
+}
+
+// Return a buffer to the decoder (deleter of the frames handed out)
+void FrameSource::release(const shared_ptr<Pool> &p, size_t slot){
+
+    {
+        lock_guard<mutex> lock(p->mutex);
+        p->free.push_back(slot);
+    }
+    p->changed.notify_all();
+}
+
+// Set the number of buffers (takes effect at the next open)
+void FrameSource::setDepth(int depth_){
+    depth = max(depth_, 2);
+}
+
+// Get the number of buffers
+int FrameSource::getDepth() const {
+    return depth;
+}
+
+// Get the decoder and consumer counters
+FrameSourceStats FrameSource::getStats() const {
+
+    if (!pool){
+        return FrameSourceStats();
+    }
+    lock_guard<mutex> lock(pool->mutex);
+    return pool->stats;
+}
+
+// Get the frame rate of the video (0 if unknown)
+double FrameSource::getFps() const {
+    return fps;
+}
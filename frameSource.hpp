@@ -0,0 +1,137 @@
+//
+//  frameSource.hpp
+//  cv_autonomous_vehicle
+//
+//  Video input decoded ahead of the pipeline into a reusable set of frame buffers
+//
+
+#ifndef frameSource_hpp
+#define frameSource_hpp
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Source Frame -> One decoded frame held in a buffer of the FrameSource
+ */
+struct SourceFrame {
+    cv::Mat image;
+    long long index;    // frame number from the start of the video
+    double timestamp;   // position in the video (ms)
+
+    // Get the image for writing (e.g. drawing an overlay into it). The decoder only reads into a
+    // buffer once every copy of the pointer is released, so a consumer that holds the only copy owns
+    // the pixels until it releases it
+    cv::Mat mutableImage() const {
+        return image;
+    }
+};
+
+/*
+ * Frame Source Statistics -> Counters of a FrameSource
+ */
+struct FrameSourceStats {
+    long long decoded;          // frames decoded
+    long long consumerStalls;   // calls to next() that had to wait for the decoder
+    long long decoderStalls;    // frames the decoder had to wait for a free buffer for
+    double consumerWaitMs;      // total time next() waited
+    double decoderWaitMs;       // total time the decoder waited
+};
+
+/*
+ * Frame Source -> Decodes a video on its own thread into a fixed ring of frame buffers
+ * The buffers are allocated once and the decoder reads into them in place, so no frame
+ * is allocated after the first lap of the ring. next() hands out a buffer as a shared_ptr,
+ * and the buffer goes back to the decoder when the last copy of the pointer is released.
+ * Mat headers taken from a frame share its buffer, so they must not be used after the
+ * pointer is released (copy the image to keep it). A consumer that does not share the pointer may
+ * write into its frame through mutableImage(). If every buffer is held by the consumers
+ * the decoder waits, and if no frame is decoded yet next() waits; both are counted as stalls.
+ */
+class FrameSource {
+
+    private:
+
+        /*
+         * Pool -> The buffers and queues, shared with the frames handed out so a frame may
+         * outlive the source
+         */
+        struct Pool {
+            std::vector<SourceFrame> slots;
+            std::deque<size_t> free;    // buffers the decoder can read into
+            std::deque<size_t> ready;   // decoded frames in order
+            bool ended;                 // the video ended or the source was closed
+            bool closing;
+            FrameSourceStats stats;
+            std::mutex mutex;
+            std::condition_variable changed;
+        };
+
+        // Number of buffers
+        int depth;
+
+        // Frame rate of the video (read before the decoder starts)
+        double fps;
+
+        std::shared_ptr<Pool> pool;
+        cv::VideoCapture cap;
+        std::thread decoder;
+
+        // Decoder thread function
+        void decode();
+
+        // Return a buffer to the decoder (deleter of the frames handed out)
+        static void release(const std::shared_ptr<Pool> &pool, size_t slot);
+
+    public:
+
+        FrameSource(int depth_ = 4) : depth(std::max(depth_, 2)), fps(0) {}
+
+        // Stops the decoder
+        ~FrameSource(){
+            close();
+        }
+
+        /********************************************************************************************
+         * OPEN
+         ********************************************************************************************
+         * This function opens a video and starts decoding it
+         * Output -> false if the video could not be opened
+         * \param video_name - video file path and name
+         */
+        bool open(const std::string &video_name);
+
+        // Stop the decoder and close the video (frames still held stay valid)
+        void close();
+
+        /********************************************************************************************
+         * NEXT
+         ********************************************************************************************
+         * This function waits for the next decoded frame
+         * Output -> the frame (NULL when the video has ended), its buffer is reused once released
+         */
+        std::shared_ptr<const SourceFrame> next();
+
+        // Set the number of buffers (takes effect at the next open)
+        void setDepth(int depth_);
+
+        // Get the number of buffers
+        int getDepth() const;
+
+        // Get the decoder and consumer counters
+        FrameSourceStats getStats() const;
+
+        // Get the frame rate of the video (0 if unknown)
+        double getFps() const;
+};
+
+#endif /* frameSource_hpp */
@@ -0,0 +1,262 @@
+//
+//  kalmanFilter.hpp
+//  cv_autonomous_vehicle
+//
+//  Fixed size Kalman filter with the dimensions known at compile time
+//
+
+#ifndef kalmanFilter_hpp
+#define kalmanFilter_hpp
+
+#include <cmath>
+
+/*
+ * Fixed Kalman -> Kalman filter with N state and M measurement parameters
+ * All matrices are plain arrays held inside the object (no heap allocation) and the
+ * loops have compile time bounds so the compiler can unroll them.
+ * The update equations match cv::KalmanFilter (without a control input).
+ */
+template<int N, int M>
+class FixedKalman {
+
+    public:
+
+        // Corrected state (x(k)) and error covariance (P(k))
+        float statePost[N];
+        float errorCovPost[N][N];
+
+        // State transition matrix (F)
+        float transitionMatrix[N][N];
+
+        // Measurement matrix (H)
+        float measurementMatrix[M][N];
+
+        // Process noise covariance (Q)
+        float processNoiseCov[N][N];
+
+        // Measurement noise covariance (R)
+        float measurementNoiseCov[M][M];
+
+        // Innovation (z - H*x) and its covariance (H*P*H' + R) from the last correction
+        float innovation[M];
+        float innovationCov[M][M];
+
+        /********************************************************************************************
+         * INITIATE KALMAN FILTER
+         ********************************************************************************************
+         * This function sets the state to zero and all matrices to (scaled) identity
+         * Output -> no output
+         */
+        void init(){
+            for (int i = 0; i < N; i++){
+                statePost[i] = 0;
+                for (int j = 0; j < N; j++){
+                    errorCovPost[i][j] = 0;
+                    transitionMatrix[i][j] = (i == j);
+                    processNoiseCov[i][j] = (i == j);
+                }
+            }
+            for (int i = 0; i < M; i++){
+                innovation[i] = 0;
+                for (int j = 0; j < N; j++){
+                    measurementMatrix[i][j] = (i == j);
+                }
+                for (int j = 0; j < M; j++){
+                    measurementNoiseCov[i][j] = (i == j);
+                    innovationCov[i][j] = 0;
+                }
+            }
+        }
+
+        /********************************************************************************************
+         * PREDICT
+         ********************************************************************************************
+         * This function predicts the state, x = F*x and P = F*P*F' + Q
+         * Output -> the predicted state
+         */
+        const float* predict(){
+
+            // x = F*x
+            float x[N];
+            for (int i = 0; i < N; i++){
+                x[i] = 0;
+                for (int k = 0; k < N; k++){
+                    x[i] += transitionMatrix[i][k] * statePost[k];
+                }
+            }
+
+            // FP = F*P
+            float FP[N][N];
+            for (int i = 0; i < N; i++){
+                for (int j = 0; j < N; j++){
+                    FP[i][j] = 0;
+                    for (int k = 0; k < N; k++){
+                        FP[i][j] += transitionMatrix[i][k] * errorCovPost[k][j];
+                    }
+                }
+            }
+
+            // P = FP*F' + Q
+            for (int i = 0; i < N; i++){
+                statePost[i] = x[i];
+                for (int j = 0; j < N; j++){
+                    float sum = processNoiseCov[i][j];
+                    for (int k = 0; k < N; k++){
+                        sum += FP[i][k] * transitionMatrix[j][k];
+                    }
+                    errorCovPost[i][j] = sum;
+                }
+            }
+            return statePost;
+        }
+
+        /********************************************************************************************
+         * CORRECT
+         ********************************************************************************************
+         * This function corrects the state with a measurement
+         * K = P*H'*inv(H*P*H' + R), x = x + K*(z - H*x), P = P - K*H*P
+         * Output -> the corrected state
+         * \param z - the measurement
+         */
+        const float* correct(const float z[M]){
+
+            // HP = H*P
+            float HP[M][N];
+            for (int i = 0; i < M; i++){
+                for (int j = 0; j < N; j++){
+                    HP[i][j] = 0;
+                    for (int k = 0; k < N; k++){
+                        HP[i][j] += measurementMatrix[i][k] * errorCovPost[k][j];
+                    }
+                }
+            }
+
+            // S = HP*H' + R
+            for (int i = 0; i < M; i++){
+                for (int j = 0; j < M; j++){
+                    float sum = measurementNoiseCov[i][j];
+                    for (int k = 0; k < N; k++){
+                        sum += HP[i][k] * measurementMatrix[j][k];
+                    }
+                    innovationCov[i][j] = sum;
+                }
+            }
+
+            // y = z - H*x
+            for (int i = 0; i < M; i++){
+                float hx = 0;
+                for (int k = 0; k < N; k++){
+                    hx += measurementMatrix[i][k] * statePost[k];
+                }
+                innovation[i] = z[i] - hx;
+            }
+
+            // K = HP'*inv(S) (S is symmetric)
+            float Sinv[M][M];
+            if (!invert(innovationCov, Sinv)){
+                return statePost;
+            }
+            float K[N][M];
+            for (int i = 0; i < N; i++){
+                for (int j = 0; j < M; j++){
+                    K[i][j] = 0;
+                    for (int k = 0; k < M; k++){
+                        K[i][j] += HP[k][i] * Sinv[k][j];
+                    }
+                }
+            }
+
+            // x = x + K*y, P = P - K*HP
+            for (int i = 0; i < N; i++){
+                for (int k = 0; k < M; k++){
+                    statePost[i] += K[i][k] * innovation[k];
+                }
+                for (int j = 0; j < N; j++){
+                    float sum = 0;
+                    for (int k = 0; k < M; k++){
+                        sum += K[i][k] * HP[k][j];
+                    }
+                    errorCovPost[i][j] -= sum;
+                }
+            }
+            return statePost;
+        }
+
+        /********************************************************************************************
+         * NORMALISED INNOVATION SQUARED
+         ********************************************************************************************
+         * This function calculates y'*inv(S)*y for the last correction (used for gating)
+         * Output -> the squared Mahalanobis distance of the last measurement
+         */
+        float innovationDistance() const {
+            float Sinv[M][M];
+            if (!invert(innovationCov, Sinv)){
+                return 0;
+            }
+            float d = 0;
+            for (int i = 0; i < M; i++){
+                for (int j = 0; j < M; j++){
+                    d += innovation[i] * Sinv[i][j] * innovation[j];
+                }
+            }
+            return d;
+        }
+
+    private:
+
+        /********************************************************************************************
+         * INVERT MATRIX
+         ********************************************************************************************
+         * This function inverts a small M x M matrix using Gauss-Jordan elimination
+         * Output -> false if the matrix is singular
+         * \param A - the matrix to invert
+         * \param Ainv - the inverse
+         */
+        static bool invert(const float A[M][M], float Ainv[M][M]){
+            float a[M][M];
+            for (int i = 0; i < M; i++){
+                for (int j = 0; j < M; j++){
+                    a[i][j] = A[i][j];
+                    Ainv[i][j] = (i == j);
+                }
+            }
+            for (int c = 0; c < M; c++){
+
+                // Partial pivoting
+                int p = c;
+                for (int r = c + 1; r < M; r++){
+                    if (std::fabs(a[r][c]) > std::fabs(a[p][c])){
+                        p = r;
+                    }
+                }
+                if (a[p][c] == 0){
+                    return false;
+                }
+                if (p != c){
+                    for (int j = 0; j < M; j++){
+                        float t = a[c][j]; a[c][j] = a[p][j]; a[p][j] = t;
+                        t = Ainv[c][j]; Ainv[c][j] = Ainv[p][j]; Ainv[p][j] = t;
+                    }
+                }
+
+                // Eliminate the column from the other rows
+                float d = 1 / a[c][c];
+                for (int j = 0; j < M; j++){
+                    a[c][j] *= d;
+                    Ainv[c][j] *= d;
+                }
+                for (int r = 0; r < M; r++){
+                    if (r != c){
+                        float f = a[r][c];
+                        for (int j = 0; j < M; j++){
+                            a[r][j] -= f * a[c][j];
+                            Ainv[r][j] -= f * Ainv[c][j];
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+};
+
+#endif /* kalmanFilter_hpp */
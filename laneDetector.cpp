@@ -26,6 +26,9 @@
 // Lane tracker header file
 #include "laneTracker.hpp"
 
+// Profiler header file
+#include "profiler.hpp"
+
 #define dtof(d) ((float)d)
 
 using namespace cv;
@@ -40,12 +43,15 @@ using namespace std;
  */
 vector<float> LaneDetector::process(const Mat &image){
     
+    PROFILE_SCOPE(LANE_TOTAL);
+    
     //******************************************************************************************
     // Pre-Processing
     //******************************************************************************************
     // Set region of interest
     //    Rect ROI = Rect(image.cols/7,image.rows/1.33,image.cols-image.cols/7,image.rows-image.rows/1.33);
     //    at imgROI = image(ROI);
+    PROFILE_SCOPE(LANE_GRAY);
     Mat imgROI;
     image.copyTo(imgROI);
     
@@ -56,14 +62,19 @@ vector<float> LaneDetector::process(const Mat &image){
     } else {
         imgROI.copyTo(imgG);
     }
+    PROFILE_STOP(LANE_GRAY);
     
     // Inverse perspective mapping
+    PROFILE_SCOPE(LANE_IPM);
     IPM::IPM ipm( Size(imgG.cols, imgG.rows), Size(imgG.cols, imgG.rows), orgPts, dstPts ); // IPM object
     Mat imgIpm; // ipm image
     ipm.applyHomography( imgG, imgIpm );
+    PROFILE_STOP(LANE_IPM);
     
     // Create lane detector instances for left and right lanes
     LaneDetector lDetect, rDetect;
+    copyParams(lDetect);
+    copyParams(rDetect);
     
     // Split the original image into two halves
     lDetect.setImageOrg(imgROI(Rect (0,0,imgROI.cols/2,imgROI.rows)));
@@ -73,6 +84,22 @@ vector<float> LaneDetector::process(const Mat &image){
     lDetect.setImageIPM(imgIpm(Rect (0,0,image.cols/2,image.rows)));
     rDetect.setImageIPM(imgIpm(Rect (image.cols/2,0,image.cols-image.cols/2,image.rows)));
     
+    //******************************************************************************************
+    // Kalman filter prediction
+    //******************************************************************************************
+    // Predict parameters
+    advanceTrackers();
+    
+    // In tracking mode only search a corridor around a confident prediction
+    if (trackingMode){
+        if (!reacquire[0] && lTracker.getRhoStd() < maxRhoStd){
+            reacquire[0] = !lDetect.setSearchCorridor(lTracker.getPredicted(), lTracker.getRhoStd());
+        }
+        if (!reacquire[1] && rTracker.getRhoStd() < maxRhoStd){
+            reacquire[1] = !rDetect.setSearchCorridor(rTracker.getPredicted(), rTracker.getRhoStd());
+        }
+    }
+    
     //******************************************************************************************
     // Detect the lanes
     //******************************************************************************************
@@ -97,18 +124,25 @@ vector<float> LaneDetector::process(const Mat &image){
     //******************************************************************************************
     // Kalman filter for lane tracking
     //******************************************************************************************
-    // Predict parameters
-    lTracker.predictKalman();
-    rTracker.predictKalman();
-    
     // Correct the kalmen filter if a line was found
-    if ( rDetect.getLines()[0] != 0 && rDetect.getLines()[1] != 0){
-        rTracker.correctKalman(rDetect.getLines()[0], rDetect.getLines()[1]);
-    }
-    if ( lDetect.getLines()[0] != 0 && lDetect.getLines()[1] != 0){
-        lTracker.correctKalman(lDetect.getLines()[0], lDetect.getLines()[1]);
+    bool rFound = rDetect.getLines()[0] != 0 && rDetect.getLines()[1] != 0;
+    bool lFound = lDetect.getLines()[0] != 0 && lDetect.getLines()[1] != 0;
+    measured[0] = lDetect.getLines();
+    measured[1] = rDetect.getLines();
+    {
+        PROFILE_SCOPE(LANE_KALMAN_CORRECT);
+        if (rFound){
+            rTracker.correctKalman(rDetect.getLines()[0], rDetect.getLines()[1]);
+        }
+        if (lFound){
+            lTracker.correctKalman(lDetect.getLines()[0], lDetect.getLines()[1]);
+        }
     }
     
+    // Fall back to a full frame search if no line was found or it is far from the prediction
+    reacquire[0] = !lFound || fabs(lTracker.getInnovation().x) > innovationGate;
+    reacquire[1] = !rFound || fabs(rTracker.getInnovation().x) > innovationGate;
+    
 //    //******************************************************************************************
 //    // Drawn lane markers on the original image
 //    //******************************************************************************************
@@ -128,6 +162,7 @@ vector<float> LaneDetector::process(const Mat &image){
     // Calcualte lane markers on the original image
     //******************************************************************************************
     // If no line found use Kalman prediction
+    PROFILE_SCOPE(LANE_BACKPROJECT);
     vector<float> outputPts;
     vector<float> outputPts2;
     if ( lDetect.getLines()[0] == 0 && lDetect.getLines()[1] == 0){
@@ -142,6 +177,7 @@ vector<float> LaneDetector::process(const Mat &image){
         outputPts2 = rDetect.calcResult(rDetect.getLines()[0], rDetect.getLines()[1], ipm, 1);
     }
     outputPts.insert(std::end(outputPts), std::begin(outputPts2), std::end(outputPts2));
+    PROFILE_STOP(LANE_BACKPROJECT);
     
 //    cout << "pts2 1:" << outputPts[0] << endl;
 //    cout << "pts2 2: " << outputPts[1] << endl;
@@ -210,41 +246,73 @@ void LaneDetector::drawResult(float rho, float theta, IPM ipm, int side){
 vector<float> LaneDetector::calcResult(float rho, float theta, IPM ipm, int side){
     imageOrg.copyTo(result);
     
-    if (side == 0){
-        Point pt1R(rho/cos(theta),0); // intersection - first row
-        Point pt2R((rho-result.rows*sin(theta))/cos(theta),result.rows); // intersection - last row
-        
-        pt1R = ipm.applyHomographyInv(Point2f(pt1R.x, pt1R.y));
-        pt2R = ipm.applyHomographyInv(Point2f(pt2R.x, pt2R.y));
-        
-        vector<float> outputPts;
-        outputPts.push_back(pt1R.x);
-        outputPts.push_back(pt1R.y);
-        outputPts.push_back(pt2R.x);
-        outputPts.push_back(pt2R.y);
-        return outputPts;
-    } else {
-        Point pt1R(rho/cos(theta)+result.cols,0); // intersection - first row
-        Point pt2R((rho-result.rows*sin(theta))/cos(theta)+result.cols,result.rows); // intersection - last row
-        
-        pt1R = ipm.applyHomographyInv(Point2f(pt1R.x, pt1R.y));
-        pt2R = ipm.applyHomographyInv(Point2f(pt2R.x, pt2R.y));
-        
+    vector<float> outputPts = backProject(rho, theta, ipm.getHinv(), result.size(), side);
+    if (side != 0){
         Mat output(Size (1920,1080),CV_8UC3,Scalar(0,0,0)); // 3 channel output image
         hconcat(result, result, output);
         
         // plot the lines that could be road
-        line( output, pt1R, pt2R, Scalar(255), 8);
+        line( output, Point(outputPts[0], outputPts[1]), Point(outputPts[2], outputPts[3]), Scalar(255), 8);
         
         result = output(Rect (output.cols/2,0,output.cols-output.cols/2,output.rows)); // right half image
-        
-        vector<float> outputPts;
-        outputPts.push_back(pt1R.x);
-        outputPts.push_back(pt1R.y);
-        outputPts.push_back(pt2R.x);
-        outputPts.push_back(pt2R.y);
-        return outputPts;
     }
+    return outputPts;
+}
+
+/********************************************************************************************
+ * BACK PROJECT LANE MARKER
+ ********************************************************************************************
+ * This function projects a line found on one half of the IPM image back onto the original image
+ * Output -> vector<[x1,y1,x2,y2]> -> end points of the line on the first and last rows
+ * \param rho -  line parameter
+ * \param theta -  line parameter
+ * \param Hinv - homography from the IPM image to the original image
+ * \param half - size of the half image the line was found on
+ * \param side - left (0) or right (1), the right half is offset by the width of the half
+ */
+vector<float> LaneDetector::backProject(float rho, float theta, const Mat &Hinv, Size half, int side) const {
+    
+    int offset = side == 0 ? 0 : half.width;
+    Point pt1R(rho/cos(theta)+offset,0); // intersection - first row
+    Point pt2R((rho-half.height*sin(theta))/cos(theta)+offset,half.height); // intersection - last row
+    
+    vector<Point2f> ends(2), mapped;
+    ends[0] = Point2f(pt1R.x, pt1R.y);
+    ends[1] = Point2f(pt2R.x, pt2R.y);
+    perspectiveTransform(ends, mapped, Hinv);
+    pt1R = mapped[0];
+    pt2R = mapped[1];
+    
+    vector<float> outputPts;
+    outputPts.push_back(pt1R.x);
+    outputPts.push_back(pt1R.y);
+    outputPts.push_back(pt2R.x);
+    outputPts.push_back(pt2R.y);
+    return outputPts;
+}
+
+/*******************************************************************************************
+ * PREDICT LANES
+ *******************************************************************************************
+ * This function advances the Kalman filters without searching the frame for lane markers
+ * Used when there is no time to process the frame, the lanes follow the tracked motion
+ * Only the inverse homography is needed (not the IPM remap tables), it is cached until the points change
+ * Output -> the predicted lane marker points, in the same layout as process
+ * \param image -> the input image (only its size is used)
+ */
+vector<float> LaneDetector::predict(const Mat &image){
+    
+    if (predictHinv.empty() || orgPts != predictOrgPts || dstPts != predictDstPts){
+        predictHinv = getPerspectiveTransform(dstPts, orgPts);
+        predictOrgPts = orgPts;
+        predictDstPts = dstPts;
+    }
+    advanceTrackers();
+    
+    vector<float> outputPts = backProject(lTracker.getPredicted().x, lTracker.getPredicted().y, predictHinv, Size(image.cols/2, image.rows), 0);
+    vector<float> outputPts2 = backProject(rTracker.getPredicted().x, rTracker.getPredicted().y, predictHinv, Size(image.cols-image.cols/2, image.rows), 1);
+    outputPts.insert(std::end(outputPts), std::begin(outputPts2), std::end(outputPts2));
+    return outputPts;
 }
 
 
@@ -258,18 +326,32 @@ vector<float> LaneDetector::calcResult(float rho, float theta, IPM ipm, int side
  */
 void LaneDetector::detectLanes(Mat &image, int side){
     
+    // Search the whole image unless a corridor has been set
+    Rect rect = searchRect.area() > 0 ? searchRect : Rect(0, 0, image.cols, image.rows);
+    
     // Apply adaptive threshold
+    PROFILE_SCOPE(LANE_THRESHOLD);
     Mat imgAt(image.size(),CV_8UC1, Scalar(0)); // 1 channel left adaptive threshold image
-    adaptiveThreshold(image, imgAt, 255, ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY,blockSizeAt,cAt);
+    Mat imgAtRect = imgAt(rect);
+    adaptiveThreshold(image(rect), imgAtRect, 255, ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY,blockSizeAt,cAt);
+    
+    // Remove edges outside of the corridor so they get no votes
+    if (!searchMask.empty()){
+        bitwise_and(imgAt, searchMask, imgAt);
+    }
+    PROFILE_STOP(LANE_THRESHOLD);
 
     
     //******************************************************************************************
     // Hough Transform to find lanes
     //******************************************************************************************
+    PROFILE_SCOPE(LANE_HOUGH);
     LineFinder finder; // create instance of line finder class
     
     // Set parameters
-    finder.setLenthGap(200,30);
+    finder.setLenthGap(houghMinLen,houghMaxGap);
+    finder.setMinVote(houghMinVote);
+    finder.setRes(houghDeltaRho,houghDeltaTheta);
     
     // Set images
     finder.setImage(image);
@@ -280,32 +362,50 @@ void LaneDetector::detectLanes(Mat &image, int side){
     
     // Draw hough lines
     finder.drawLines(side); // detected left lane lines overlayed on original image
+    PROFILE_STOP(LANE_HOUGH);
     
     
     //******************************************************************************************
     // Probabalistic Hough Transform to find lanes
     //******************************************************************************************
-    // Perform probabalistic hough transform to find lines
-    finder.findLinesP(side);
-    
-    // Draw probabilistic hough lines
-    finder.drawLinesP(side); // detected left lane lines overlayed on original image
-    
-    
-    //******************************************************************************************
-    // Combine results and generate possible lines
-    //******************************************************************************************
-    // "bitwise_and" of probabilistic and normal hough transforms
+    // Perform probabalistic hough transform to find lines (skipped when short of time)
     Mat imgBit(image.size(),CV_8UC1,Scalar(0)); // 1 channel image for resulting lane marker lines
-    bitwise_and(finder.getHoughP(),finder.getHough(),imgBit);
+    if (skipHoughP){
+        imgBit = finder.getHough();
+    } else {
+        PROFILE_SCOPE(LANE_HOUGHP);
+        finder.findLinesP(side);
+        
+        // Draw probabilistic hough lines
+        finder.drawLinesP(side); // detected left lane lines overlayed on original image
+        PROFILE_STOP(LANE_HOUGHP);
+        
+        
+        //******************************************************************************************
+        // Combine results and generate possible lines
+        //******************************************************************************************
+        // "bitwise_and" of probabilistic and normal hough transforms
+        PROFILE_SCOPE(LANE_AND);
+        bitwise_and(finder.getHoughP(),finder.getHough(),imgBit);
+        PROFILE_STOP(LANE_AND);
+    }
     
     // Invert resulting image from bitwise operation and perform adaptive thresholding
+    PROFILE_SCOPE(LANE_RETHRESHOLD);
     Mat imgInv(image.size(),CV_8UC1,Scalar(0)); // 1 channel image for inverted left lane
     Mat imgBitAt(image.size(),CV_8UC1,Scalar(0)); // 1 channel image for thresholded left lane
     threshold(imgBit,imgInv,150,255,THRESH_BINARY_INV);
-    adaptiveThreshold(imgInv, imgBitAt, 255, ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY,blockSizeAt,cAt);
+    Mat imgBitAtRect = imgBitAt(rect);
+    adaptiveThreshold(imgInv(rect), imgBitAtRect, 255, ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY,blockSizeAt,cAt);
+    
+    // The threshold responds along the corridor's edge inside its bounding box, keep the corridor only
+    if (!searchMask.empty()){
+        bitwise_and(imgBitAt, searchMask, imgBitAt);
+    }
+    PROFILE_STOP(LANE_RETHRESHOLD);
     
     // Create instances of line finder class
+    PROFILE_SCOPE(LANE_HOUGH2);
     LineFinder finderB;
     
     // Set parameters for hough transform
@@ -327,6 +427,49 @@ void LaneDetector::detectLanes(Mat &image, int side){
 }
 
 
+/********************************************************************************************
+ * SET SEARCH CORRIDOR
+ ********************************************************************************************
+ * This function restricts detectLanes to a corridor around the predicted line
+ * The corridor is drawn as a thick line on a mask (half width = corridorSigma*rhoStd + corridorMargin)
+ * and its bounding box limits the adaptive thresholding
+ * Output -> false if the corridor does not intersect the image or is wider than it (full frame is searched)
+ * \param predicted - predicted line parameters (rho, theta)
+ * \param rhoStd - standard deviation of the predicted rho
+ */
+bool LaneDetector::setSearchCorridor(Point_<float> predicted, float rhoStd){
+    
+    searchMask.release();
+    searchRect = Rect();
+    
+    float rho = predicted.x;
+    float theta = predicted.y;
+    if (fabs(cos(theta)) < 1e-3){
+        return false;
+    }
+    
+    // Intersections of the predicted line with the first and last rows
+    Point pt1(rho/cos(theta),0);
+    Point pt2((rho-image.rows*sin(theta))/cos(theta),image.rows);
+    
+    // Corridor half width along a row, unbounded for near horizontal lines (and line() limits the thickness)
+    float halfWidthF = (corridorSigma*rhoStd + corridorMargin) / fabs(cos(theta));
+    if (halfWidthF > image.cols){
+        return false;
+    }
+    int halfWidth = cvCeil(halfWidthF);
+    
+    Rect box = Rect(Point(min(pt1.x, pt2.x) - halfWidth, 0), Point(max(pt1.x, pt2.x) + halfWidth + 1, image.rows)) & Rect(0, 0, image.cols, image.rows);
+    if (box.area() == 0){
+        return false;
+    }
+    
+    searchMask = Mat::zeros(image.size(), CV_8UC1);
+    line(searchMask, pt1, pt2, Scalar(255), 2*halfWidth + 1);
+    searchRect = box;
+    return true;
+}
+
 /********************************************************************************************
  * FIND RHO, THETA FOR BEST FOR LINE
  ********************************************************************************************
@@ -337,6 +480,8 @@ void LaneDetector::detectLanes(Mat &image, int side){
  */
 void LaneDetector::calcLineParams(int side){
     
+    PROFILE_SCOPE(LANE_LINE_PARAMS);
+    
     // Create instance of line finder class
     LineFinder finder;
 
@@ -389,6 +534,7 @@ void LaneDetector::drawDashedLine(Mat image, Point startPoint, Point endPoint, i
  * \param overlayFlag - 1 results in best fit line being overlayed on original image
  */
 void LaneDetector::sampleLine(int overlayFlag){
+    PROFILE_SCOPE(LANE_SAMPLE);
     vector<Point> pts; // initialise vector of points
     pts.clear();
     
@@ -420,9 +566,12 @@ void LaneDetector::sampleLine(int overlayFlag){
         }
     }
     
+    PROFILE_STOP(LANE_SAMPLE);
+    
     if (!pts.empty()){
         
         // fit a line through the points using least squares regression
+        PROFILE_SCOPE(LANE_FIT);
         fitLine(pts, lsLine, CV_DIST_HUBER, 0, 0.01, 0.01);
         
         // calculate the line start and end points
@@ -482,6 +631,93 @@ void LaneDetector::setSampleN(int sample){
     nSample = sample;
 }
 
+// Set the adaptive threshold parameters (block size must be odd and > 1)
+void LaneDetector::setThreshold(int blockSize, int c){
+    if (blockSize > 1 && blockSize % 2 == 1){
+        blockSizeAt = blockSize;
+    }
+    cAt = c;
+}
+
+// Set the hough transform parameters for finding candidate lines
+void LaneDetector::setHoughParams(int minVote, double minLen, double maxGap, double deltaRho, double deltaTheta){
+    houghMinVote = minVote;
+    houghMinLen = minLen;
+    houghMaxGap = maxGap;
+    houghDeltaRho = deltaRho;
+    houghDeltaTheta = deltaTheta;
+}
+
+// Copy the tunable parameters to the detector of one half of the image
+void LaneDetector::copyParams(LaneDetector &detect) const {
+    detect.blockSizeAt = blockSizeAt;
+    detect.cAt = cAt;
+    detect.nSample = nSample;
+    detect.houghMinVote = houghMinVote;
+    detect.houghMinLen = houghMinLen;
+    detect.houghMaxGap = houghMaxGap;
+    detect.houghDeltaRho = houghDeltaRho;
+    detect.houghDeltaTheta = houghDeltaTheta;
+    detect.corridorSigma = corridorSigma;
+    detect.corridorMargin = corridorMargin;
+    detect.skipHoughP = skipHoughP;
+}
+
+// Advance the Kalman filters by one frame, nothing is measured until lines are found in the frame
+void LaneDetector::advanceTrackers(){
+    PROFILE_SCOPE(LANE_KALMAN_PREDICT);
+    lTracker.predictKalman();
+    rTracker.predictKalman();
+    measured[0] = measured[1] = Vec2f(0, 0);
+}
+
+// Keep the tracker state (Kalman filters, last measurements and full frame searches pending)
+void LaneDetector::saveTracks(){
+    savedTracker[0] = lTracker;
+    savedTracker[1] = rTracker;
+    for (int side = 0; side < 2; side++){
+        savedMeasured[side] = measured[side];
+        savedReacquire[side] = reacquire[side];
+    }
+}
+
+// Go back to the tracker state kept by saveTracks
+void LaneDetector::restoreTracks(){
+    lTracker = savedTracker[0];
+    rTracker = savedTracker[1];
+    for (int side = 0; side < 2; side++){
+        measured[side] = savedMeasured[side];
+        reacquire[side] = savedReacquire[side];
+    }
+}
+
+// Skip the probabilistic hough transform
+void LaneDetector::setSkipHoughP(bool skip){
+    skipHoughP = skip;
+}
+
+// Set tracking mode
+void LaneDetector::setTrackingMode(bool tracking){
+    trackingMode = tracking;
+    reacquire[0] = reacquire[1] = true;
+}
+
+// Set the corridor width
+void LaneDetector::setCorridor(float sigma, int margin){
+    corridorSigma = sigma;
+    corridorMargin = margin;
+}
+
+// Set the std of the predicted rho below which the corridor is searched
+void LaneDetector::setMaxRhoStd(float maxStd){
+    maxRhoStd = maxStd;
+}
+
+// Set the innovation gate for falling back to a full frame search
+void LaneDetector::setInnovationGate(float gate){
+    innovationGate = gate;
+}
+
 // Set original points for IPM
 void LaneDetector::setOrgPts(std::vector<cv::Point2f> org_Pts){
     orgPts = org_Pts;
@@ -526,3 +762,13 @@ cv::Vec2f LaneDetector::getLines(){
 cv::Mat LaneDetector::getResult(){
     return result;
 }
+
+// Get the rho, theta found for one side (0 left, 1 right) in the last frame (0,0 -> not found)
+cv::Vec2f LaneDetector::getMeasured(int side){
+    return measured[side];
+}
+
+// Get the tracker of one side (0 left, 1 right)
+LaneTracker LaneDetector::getTracker(int side){
+    return side == 0 ? lTracker : rTracker;
+}
@@ -45,6 +45,13 @@ class LaneDetector{
         // Number of sample points
         int nSample;
     
+        // Hough transform parameters for finding candidate lines (see LineFinder)
+        int houghMinVote; // min votes required for a line
+        double houghMinLen; // min length of a line segment
+        double houghMaxGap; // max gap along a line segment
+        double houghDeltaRho; // rho resolution of the accumulator
+        double houghDeltaTheta; // theta resolution of the accumulator
+    
         // Vector for least squares line
         cv::Vec4f lsLine;
     
@@ -57,13 +64,49 @@ class LaneDetector{
         // Lane tracker object
         LaneTracker lTracker, rTracker;
     
+        // Rho, theta found for the left and right lane in the last frame (0,0 -> not found)
+        cv::Vec2f measured[2];
+    
         // Image containing the result
         cv::Mat result;
     
+        // Tracking mode -> search only a corridor around the tracker's prediction
+        bool trackingMode;
+        float corridorSigma; // corridor half width in standard deviations of rho
+        int corridorMargin; // extra corridor half width in pixels
+        float maxRhoStd; // prediction is confident if the std of its rho is below this (LaneTracker units)
+        float innovationGate; // re-acquire on the full frame if the rho innovation exceeds this (pixels)
+        bool reacquire[2]; // left/right lane needs a full frame search
+    
+        // Skip the probabilistic hough transform (the candidates come from the standard transform only)
+        bool skipHoughP;
+    
+        // Search corridor (mask and its bounding box) used by detectLanes, empty -> full frame
+        cv::Mat searchMask;
+        cv::Rect searchRect;
+    
+        // Copy the tunable parameters to the detector of one half of the image
+        void copyParams(LaneDetector &detect) const;
+    
+        // Project a line found on one half of the IPM image back onto the original image (x1, y1, x2, y2)
+        std::vector<float> backProject(float rho, float theta, const cv::Mat &Hinv, cv::Size half, int side) const;
+    
+        // Tracker state kept by saveTracks
+        LaneTracker savedTracker[2];
+        cv::Vec2f savedMeasured[2];
+        bool savedReacquire[2];
+    
+        // Inverse homography used by predict, and the IPM points it was computed from
+        cv::Mat predictHinv;
+        std::vector<cv::Point2f> predictOrgPts;
+        std::vector<cv::Point2f> predictDstPts;
+    
     public:
     
         // Default parameter initialization
-        LaneDetector() : blockSizeAt(15), cAt(-5), nSample(30){}
+        LaneDetector() : blockSizeAt(15), cAt(-5), nSample(30), houghMinVote(80), houghMinLen(200), houghMaxGap(30), houghDeltaRho(2.5), houghDeltaTheta(PI/180), trackingMode(false), corridorSigma(3), corridorMargin(25), maxRhoStd(0.25), innovationGate(15), skipHoughP(false){
+            reacquire[0] = reacquire[1] = true;
+        }
     
         /********************************************************************************************
          * DETECR LANES
@@ -75,6 +118,16 @@ class LaneDetector{
          */
         void detectLanes(cv::Mat &image, int side);
     
+        /********************************************************************************************
+         * SET SEARCH CORRIDOR
+         ********************************************************************************************
+         * This function restricts detectLanes to a corridor around the predicted line
+         * Output -> false if the corridor does not intersect the image (full frame is searched)
+         * \param predicted - predicted line parameters (rho, theta)
+         * \param rhoStd - standard deviation of the predicted rho
+         */
+        bool setSearchCorridor(cv::Point_<float> predicted, float rhoStd);
+    
         /*******************************************************************************************
          * LANE DETECTOR
          *******************************************************************************************
@@ -84,6 +137,22 @@ class LaneDetector{
          */
         std::vector<float> process(const cv::Mat &image);
     
+        /*******************************************************************************************
+         * PREDICT LANES
+         *******************************************************************************************
+         * This function advances the Kalman filters without searching the frame for lane markers
+         * Output -> the predicted lane marker points, in the same layout as process
+         * \param image -> the input image (only its size is used)
+         */
+        std::vector<float> predict(const cv::Mat &image);
+    
+        // Advance the Kalman filters by one frame without a measurement (getMeasured reports none until lines are found)
+        void advanceTrackers();
+    
+        // Keep the tracker state, restoreTracks undoes the frames processed since (e.g. a torn frame)
+        void saveTracks();
+        void restoreTracks();
+    
         /********************************************************************************************
          * FIND RHO, THETA FOR BEST FOR LINE
          ********************************************************************************************
@@ -173,6 +242,28 @@ class LaneDetector{
         // Set number of sample points
         void setSampleN(int sample);
     
+        // Set the adaptive threshold block size and constant
+        void setThreshold(int blockSize, int c);
+    
+        // Set the hough transform parameters for finding candidate lines
+        void setHoughParams(int minVote, double minLen, double maxGap, double deltaRho, double deltaTheta);
+    
+        // Set tracking mode (search corridor around the Kalman prediction)
+        void setTrackingMode(bool tracking);
+    
+        // Set the corridor width (standard deviations of rho and pixel margin)
+        void setCorridor(float sigma, int margin);
+    
+        // Set the innovation gate (pixels) for falling back to a full frame search
+        void setInnovationGate(float gate);
+    
+        // Set the std of the predicted rho below which the corridor is searched (the tracker's
+        // prediction std starts at 0.32, settles near 0.16 and grows while no line is found)
+        void setMaxRhoStd(float maxStd);
+    
+        // Skip the probabilistic hough transform in detectLanes
+        void setSkipHoughP(bool skip);
+    
         // Get original image
         cv::Mat getImgOrg();
         
@@ -191,6 +282,12 @@ class LaneDetector{
         // Get result with best fit line overlayed on original image
         cv::Mat getResult();
     
+        // Get the rho, theta found for one side (0 left, 1 right) in the last frame (0,0 -> not found)
+        cv::Vec2f getMeasured(int side);
+    
+        // Get the tracker of one side (0 left, 1 right)
+        LaneTracker getTracker(int side);
+    
 };
 
 
@@ -15,6 +15,10 @@
 
 #include "controller.hpp"
 
+#include "changeDetector.hpp"
+
+#include "config.hpp"
+
 class LaneDetectorController: public Controller {
     
     private:
@@ -24,6 +28,11 @@ class LaneDetectorController: public Controller {
     
         // Vector containing lane marker points
         std::vector<float> resultPts;
+        std::vector<float> savedPts; // kept by saveState
+    
+        // Skips frames whose IPM region has not changed since the last frame processed
+        ChangeDetector change;
+        cv::Rect ipmRect; // bounding box of the IPM points on the input image
     
     public:
         
@@ -43,28 +52,117 @@ class LaneDetectorController: public Controller {
             dstPts.push_back( cv::Point2f(image.cols, 0) );
             dstPts.push_back( cv::Point2f(0, 0) );
             
-            // Set defualt image coordinates for IPM if not already set
+            // Set defualt image coordinates for IPM if not already set (chosen for 1080p, scaled to other sizes)
             if (orgPts.empty()){
+                float sx = image.cols / 1920.f, sy = image.rows / 1080.f;
                 orgPts.push_back( cv::Point2f(0, image.rows) );
                 orgPts.push_back( cv::Point2f(image.cols, image.rows) );
-                orgPts.push_back( cv::Point2f(image.cols/2+150, 700) );
-                orgPts.push_back( cv::Point2f(image.cols/2-300, 700) );
+                orgPts.push_back( cv::Point2f(image.cols/2+150*sx, 700*sy) );
+                orgPts.push_back( cv::Point2f(image.cols/2-300*sx, 700*sy) );
             }
             
             ldetect->setDstPts(dstPts);
             ldetect->setOrgPts(orgPts);
+            ipmRect = cv::boundingRect(orgPts);
         }
     
         // Perform processing
         void process() {
             
+            TRACE_SCOPE("LaneDetectorController::process", frameId);
+            
+            // Nothing moved on the road since the last frame processed -> keep its lanes, the trackers still advance
+            // and getLines reports no measurement for the frame
+            if (!resultPts.empty() && change.isStatic(image, ipmRect)){
+                ldetect->advanceTrackers();
+                return;
+            }
             resultPts = ldetect->process(image);
         }
     
+        // Follow the Kalman prediction without searching the frame (when there is no time to process it)
+        void predict() {
+            
+            TRACE_SCOPE("LaneDetectorController::predict", frameId);
+            resultPts = ldetect->predict(image);
+        }
+    
+        // Keep the trackers and lanes, restoreState drops the frames processed since (e.g. a torn frame)
+        void saveState(){
+            
+            ldetect->saveTracks();
+            savedPts = resultPts;
+        }
+    
+        // Go back to the state kept by saveState (the next frame is compared with nothing and processed)
+        void restoreState(){
+            
+            ldetect->restoreTracks();
+            resultPts = savedPts;
+            change.reset();
+        }
+    
+        // Skip the probabilistic hough transform (cheaper, less selective candidate lines)
+        void setSkipHoughP(bool skip){
+            
+            ldetect->setSkipHoughP(skip);
+        }
+    
         // Initialise the Kalman filters
         void initKalman(LaneTracker lTrack, LaneTracker rTrack){
             
             ldetect->initKalman(lTrack, rTrack);
+            change.reset();
+        }
+    
+        // Search only a corridor around the Kalman prediction once the tracker is confident
+        void setTrackingMode(bool tracking){
+            
+            ldetect->setTrackingMode(tracking);
+        }
+    
+        // Set the adaptive threshold block size and constant
+        void setThreshold(int blockSize, int c){
+            
+            ldetect->setThreshold(blockSize, c);
+        }
+    
+        // Set the number of sample points
+        void setSampleN(int sample){
+            
+            ldetect->setSampleN(sample);
+        }
+    
+        // Set the hough transform parameters for finding candidate lines
+        void setHoughParams(int minVote, double minLen, double maxGap, double deltaRho, double deltaTheta){
+            
+            ldetect->setHoughParams(minVote, minLen, maxGap, deltaRho, deltaTheta);
+        }
+    
+        // Apply the lane detector parameters and performance modes of a configuration
+        void applyConfig(const Config &config){
+            
+            ldetect->setThreshold(config.blockSizeAt, config.cAt);
+            ldetect->setSampleN(config.nSample);
+            ldetect->setHoughParams(config.minVote, config.minLen, config.maxGap, config.deltaRho, config.deltaTheta);
+            ldetect->setCorridor(config.corridorSigma, config.corridorMargin);
+            ldetect->setInnovationGate(config.innovationGate);
+            ldetect->setMaxRhoStd(config.maxRhoStd);
+            ldetect->setTrackingMode(config.trackingMode);
+            change.setThreshold(config.staticThreshold, config.staticMaxSkip);
+        }
+    
+        // Reuse the lanes of frames whose IPM region changed less than threshold (mean gray levels, 0 -> never),
+        // for at most maxSkip frames in a row
+        void setStaticSkip(double threshold, int maxSkip){
+            
+            change.setThreshold(threshold, maxSkip);
+        }
+    
+        // Get the number of frames whose lanes were reused
+        long long getStaticFrames() const {
+            
+            return change.getStatic();
         }
     
         // Get the points for the detected lane markers
@@ -72,6 +170,41 @@ class LaneDetectorController: public Controller {
             return resultPts;
         }
     
+        // Get the rho, theta found for the left then right lane (0,0 -> not found, the prediction was used)
+        std::vector<float> getLines(){
+            
+            std::vector<float> lines;
+            for (int side = 0; side < 2; side++){
+                cv::Vec2f l = ldetect->getMeasured(side);
+                lines.push_back(l[0]);
+                lines.push_back(l[1]);
+            }
+            return lines;
+        }
+    
+        // Get the Kalman prediction (rho, theta) of the left then right lane for the current frame
+        std::vector<float> getPredicted(){
+            
+            std::vector<float> predicted;
+            for (int side = 0; side < 2; side++){
+                cv::Point_<float> p = ldetect->getTracker(side).getPredicted();
+                predicted.push_back(p.x);
+                predicted.push_back(p.y);
+            }
+            return predicted;
+        }
+    
+        // Get the Kalman state (rho, theta, rho rate, theta rate) of the left then right lane
+        std::vector<float> getTrackerState(){
+            
+            std::vector<float> state;
+            for (int side = 0; side < 2; side++){
+                cv::Vec4f s = ldetect->getTracker(side).getStateVector();
+                state.insert(state.end(), s.val, s.val + 4);
+            }
+            return state;
+        }
+    
         // Delete all processor objects created by controller
         ~LaneDetectorController() {
             
@@ -0,0 +1,295 @@
+//
+//  laneEvaluator.cpp
+//  cv_autonomous_vehicle
+//
+//  Accuracy of the detected lane markers against labelled lane datasets
+//
+
+#include "laneEvaluator.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+
+using namespace std;
+
+// Skip white space and return the next character (0 at the end)
+static char nextChar(const string &s, size_t &pos){
+    while (pos < s.size() && isspace((unsigned char)s[pos])){
+        pos++;
+    }
+    return pos < s.size() ? s[pos] : 0;
+}
+
+// Move to the value of a key, false if the key is missing
+static bool findKey(const string &s, const string &key, size_t &pos){
+    pos = s.find("\"" + key + "\"");
+    if (pos == string::npos){
+        return false;
+    }
+    pos += key.size() + 2;
+    if (nextChar(s, pos) != ':'){
+        return false;
+    }
+    pos++;
+    return true;
+}
+
+// Parse an array of integers starting at pos
+static bool parseIntArray(const string &s, size_t &pos, vector<int> &values){
+    values.clear();
+    if (nextChar(s, pos) != '['){
+        return false;
+    }
+    pos++;
+    if (nextChar(s, pos) == ']'){
+        pos++;
+        return true;
+    }
+    for (;;){
+        nextChar(s, pos);
+        char *end;
+        double v = strtod(s.c_str() + pos, &end);
+        if (end == s.c_str() + pos){
+            return false;
+        }
+        values.push_back((int)floor(v + 0.5));
+        pos = end - s.c_str();
+        char c = nextChar(s, pos);
+        pos++;
+        if (c == ']'){
+            return true;
+        }
+        if (c != ','){
+            return false;
+        }
+    }
+}
+
+/********************************************************************************************
+ * LOAD TUSIMPLE
+ ********************************************************************************************
+ * This function reads TuSimple label file (one JSON object per line with "lanes",
+ * "h_samples" and "raw_file")
+ * Output -> false if the file could not be read or a line could not be parsed
+ * \param fileName - label file path and name
+ * \param labels - the labels in the file
+ */
+bool LaneEvaluator::loadTuSimple(const string &fileName, vector<LaneLabel> &labels){
+
+    ifstream in(fileName.c_str());
+    if (!in.is_open()){
+        return false;
+    }
+
+    string line;
+    while (getline(in, line)){
+        if (line.find_first_not_of(" \t\r") == string::npos){
+            continue;
+        }
+
+        LaneLabel label;
+        size_t pos;
+
+        // Image path
+        if (!findKey(line, "raw_file", pos) || nextChar(line, pos) != '"'){
+            return false;
+        }
+        size_t end = line.find('"', pos + 1);
+        if (end == string::npos){
+            return false;
+        }
+        label.rawFile = line.substr(pos + 1, end - pos - 1);
+
+        // Sampled rows
+        if (!findKey(line, "h_samples", pos) || !parseIntArray(line, pos, label.hSamples)){
+            return false;
+        }
+
+        // Array of lanes
+        if (!findKey(line, "lanes", pos) || nextChar(line, pos) != '['){
+            return false;
+        }
+        pos++;
+        while (nextChar(line, pos) == '['){
+            vector<int> lane;
+            if (!parseIntArray(line, pos, lane) || lane.size() != label.hSamples.size()){
+                return false;
+            }
+            label.lanes.push_back(lane);
+            if (nextChar(line, pos) == ','){
+                pos++;
+            }
+        }
+        if (nextChar(line, pos) != ']'){
+            return false;
+        }
+
+        labels.push_back(label);
+    }
+
+    return true;
+}
+
+/********************************************************************************************
+ * EGO LANES
+ ********************************************************************************************
+ * This function finds the labelled lanes either side of the image centre
+ * Output -> no output
+ * \param label - the label of the image
+ * \param width - image width
+ * \param left - index of the left ego lane (-1 if none)
+ * \param right - index of the right ego lane (-1 if none)
+ */
+void LaneEvaluator::egoLanes(const LaneLabel &label, int width, int &left, int &right){
+
+    left = right = -1;
+    double centre = width / 2.0, leftX = -1, rightX = width;
+    for (size_t l = 0; l < label.lanes.size(); l++){
+
+        // x position at the lowest labelled row of the lane
+        int bottom = -1, x = -2;
+        for (size_t r = 0; r < label.hSamples.size(); r++){
+            if (label.lanes[l][r] >= 0 && label.hSamples[r] > bottom){
+                bottom = label.hSamples[r];
+                x = label.lanes[l][r];
+            }
+        }
+        if (bottom < 0){
+            continue;
+        }
+
+        if (x < centre && x > leftX){
+            leftX = x;
+            left = (int)l;
+        } else if (x >= centre && x < rightX){
+            rightX = x;
+            right = (int)l;
+        }
+    }
+}
+
+/********************************************************************************************
+ * CLIP FRAMES
+ ********************************************************************************************
+ * This function lists the frames of the clip a label belongs to
+ * TuSimple labels the last frame (e.g. clips/0313-1/6040/20.jpg) of a clip of numbered frames
+ * Output -> image paths in order, ending with the labelled frame
+ * \param root - dataset root directory
+ * \param label - the label
+ * \param sequence - include the preceding frames of the clip (so the tracker can converge)
+ */
+vector<string> LaneEvaluator::clipFrames(const string &root, const LaneLabel &label, bool sequence){
+
+    vector<string> frames;
+    size_t slash = label.rawFile.find_last_of('/');
+    string dir = slash == string::npos ? "" : label.rawFile.substr(0, slash + 1);
+    string name = label.rawFile.substr(dir.size());
+    int last = atoi(name.c_str());
+    if (sequence && last > 1 && name == to_string(last) + ".jpg"){
+        for (int i = 1; i < last; i++){
+            frames.push_back(root + "/" + dir + to_string(i) + ".jpg");
+        }
+    }
+    frames.push_back(root + "/" + label.rawFile);
+    return frames;
+}
+
+/********************************************************************************************
+ * ADD FRAME
+ ********************************************************************************************
+ * This function scores the lane marker points from LaneDetectorController against a label
+ * Output -> no output
+ * \param label - the label of the image
+ * \param width - image width
+ * \param points - x1,y1,x2,y2 of the left line followed by the right line
+ */
+void LaneEvaluator::addFrame(const LaneLabel &label, int width, const vector<float> &points){
+
+    int ego[2];
+    egoLanes(label, width, ego[0], ego[1]);
+
+    for (int side = 0; side < 2; side++){
+
+        // A degenerate line counts as no detection
+        bool detected = (int)points.size() >= 4*(side+1) && points[4*side+3] != points[4*side+1];
+        if (ego[side] < 0){
+            fp += detected;
+            continue;
+        }
+        if (!detected){
+            fn++;
+            continue;
+        }
+
+        // Compare the line with each labelled point of the lane
+        const float *p = &points[4*side];
+        const vector<int> &lane = label.lanes[ego[side]];
+        int correct = 0, total = 0;
+        for (size_t r = 0; r < lane.size(); r++){
+            if (lane[r] < 0){
+                continue;
+            }
+            double x = p[0] + (label.hSamples[r] - p[1]) * (p[2] - p[0]) / (p[3] - p[1]);
+            double err = fabs(x - lane[r]);
+            correct += err < pixelThresh;
+            total++;
+            errTotal += err;
+            nErr++;
+        }
+
+        if (total > 0 && correct >= accuracyThresh * total){
+            tp++;
+        } else {
+            fp++;
+            fn++;
+        }
+    }
+
+    nFrames++;
+}
+
+// Discard the accumulated scores
+void LaneEvaluator::reset(){
+    tp = fp = fn = 0;
+    errTotal = 0;
+    nErr = 0;
+    nFrames = 0;
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the point distance (pixels) and lane accuracy thresholds
+void LaneEvaluator::setThresholds(double pixels, double accuracy){
+    pixelThresh = pixels;
+    accuracyThresh = accuracy;
+}
+
+// Get the precision of the ego lane markers
+double LaneEvaluator::getPrecision() const {
+    return tp + fp > 0 ? (double)tp / (tp + fp) : 0;
+}
+
+// Get the recall of the ego lane markers
+double LaneEvaluator::getRecall() const {
+    return tp + fn > 0 ? (double)tp / (tp + fn) : 0;
+}
+
+// Get the F1 score of the ego lane markers
+double LaneEvaluator::getF1() const {
+    double p = getPrecision(), r = getRecall();
+    return p + r > 0 ? 2 * p * r / (p + r) : 0;
+}
+
+// Get the mean absolute x difference (pixels) over the labelled points of detected lanes
+double LaneEvaluator::getLateralError() const {
+    return nErr > 0 ? errTotal / nErr : -1;
+}
+
+// Get the number of frames evaluated
+int LaneEvaluator::getFrames() const {
+    return nFrames;
+}
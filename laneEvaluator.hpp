@@ -0,0 +1,130 @@
+//
+//  laneEvaluator.hpp
+//  cv_autonomous_vehicle
+//
+//  Accuracy of the detected lane markers against labelled lane datasets
+//
+
+#ifndef laneEvaluator_hpp
+#define laneEvaluator_hpp
+
+#include <string>
+#include <vector>
+
+/*
+ * Lane Label -> TuSimple style annotation of one image
+ * Each lane is the x position of the lane marker at each of the sampled rows (-2 if absent)
+ */
+struct LaneLabel {
+
+    // Image path relative to the dataset root
+    std::string rawFile;
+
+    // Rows the lanes are sampled at
+    std::vector<int> hSamples;
+
+    // x position of each lane at each sampled row
+    std::vector<std::vector<int> > lanes;
+};
+
+/*
+ * Lane Evaluator -> Accumulates F1 and lateral error of the ego lane markers over a dataset
+ * The ego lane markers are the labelled lanes either side of the image centre at the bottom
+ * of the image. A detected line is a true positive if at least accuracyThresh of the labelled
+ * points of the marker are within pixelThresh of the line (as in the TuSimple benchmark).
+ */
+class LaneEvaluator {
+
+    private:
+
+        // Largest x difference for a point to be correct (pixels)
+        double pixelThresh;
+
+        // Fraction of correct points for a lane to be a true positive
+        double accuracyThresh;
+
+        // True positives, false positives and false negatives
+        int tp, fp, fn;
+
+        // Sum of the absolute x differences and number of points compared
+        double errTotal;
+        long nErr;
+
+        // Number of frames evaluated
+        int nFrames;
+
+    public:
+
+        LaneEvaluator() : pixelThresh(20), accuracyThresh(0.85) {
+            reset();
+        }
+
+        /********************************************************************************************
+         * LOAD TUSIMPLE
+         ********************************************************************************************
+         * This function reads TuSimple label file (one JSON object per line with "lanes",
+         * "h_samples" and "raw_file")
+         * Output -> false if the file could not be read or a line could not be parsed
+         * \param fileName - label file path and name
+         * \param labels - the labels in the file
+         */
+        static bool loadTuSimple(const std::string &fileName, std::vector<LaneLabel> &labels);
+
+        /********************************************************************************************
+         * EGO LANES
+         ********************************************************************************************
+         * This function finds the labelled lanes either side of the image centre
+         * Output -> no output
+         * \param label - the label of the image
+         * \param width - image width
+         * \param left - index of the left ego lane (-1 if none)
+         * \param right - index of the right ego lane (-1 if none)
+         */
+        static void egoLanes(const LaneLabel &label, int width, int &left, int &right);
+
+        /********************************************************************************************
+         * CLIP FRAMES
+         ********************************************************************************************
+         * This function lists the frames of the clip a label belongs to
+         * TuSimple labels the last frame (e.g. clips/0313-1/6040/20.jpg) of a clip of numbered frames
+         * Output -> image paths in order, ending with the labelled frame
+         * \param root - dataset root directory
+         * \param label - the label
+         * \param sequence - include the preceding frames of the clip (so the tracker can converge)
+         */
+        static std::vector<std::string> clipFrames(const std::string &root, const LaneLabel &label, bool sequence);
+    
+        /********************************************************************************************
+         * ADD FRAME
+         ********************************************************************************************
+         * This function scores the lane marker points from LaneDetectorController against a label
+         * Output -> no output
+         * \param label - the label of the image
+         * \param width - image width
+         * \param points - x1,y1,x2,y2 of the left line followed by the right line
+         */
+        void addFrame(const LaneLabel &label, int width, const std::vector<float> &points);
+
+        // Discard the accumulated scores
+        void reset();
+
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+
+        // Set the point distance (pixels) and lane accuracy thresholds
+        void setThresholds(double pixels, double accuracy);
+
+        // Get precision, recall and F1 of the ego lane markers
+        double getPrecision() const;
+        double getRecall() const;
+        double getF1() const;
+
+        // Get the mean absolute x difference (pixels) over the labelled points of detected lanes
+        double getLateralError() const;
+
+        // Get the number of frames evaluated
+        int getFrames() const;
+};
+
+#endif /* laneEvaluator_hpp */
@@ -30,40 +30,36 @@ void LaneTracker::initKalman(float rho, float theta){
     // Create kalman filter with 4 dynamic params, 2 measurement params
     // Measurements are rho & theta of best fit line
     // Dynamic parameters are rho, theta, rho_dot, theta_dot
-    laneKalman.init(4, 2, 0);
+    laneKalman.init();
+    innovationPt = Point_<float>(0, 0);
     
-    measurement = Mat_<float>::zeros(2,1);
-    measurement.at<float>(0, 0) = rho;
-    measurement.at<float>(0, 0) = theta;
+    measurement[0] = rho;
+    measurement[1] = theta;
     
-    laneKalman.statePre.setTo(0);
-    laneKalman.statePre.at<float>(0, 0) = rho;
-    laneKalman.statePre.at<float>(1, 0) = theta;
+    laneKalman.statePost[0] = rho;
+    laneKalman.statePost[1] = theta;
     
-    laneKalman.statePost.setTo(0);
-    laneKalman.statePost.at<float>(0, 0) = rho;
-    laneKalman.statePost.at<float>(1, 0) = theta;
-    
-    setIdentity(laneKalman.transitionMatrix);
-    setIdentity(laneKalman.measurementMatrix);
-    setIdentity(laneKalman.processNoiseCov, Scalar::all(0.005));
-    setIdentity(laneKalman.measurementNoiseCov, Scalar::all(1e-1));
-    setIdentity(laneKalman.errorCovPost, Scalar::all(0.1));
+    // Transition and measurement matrices are left as identity
+    for (int i = 0; i < 4; i++){
+        laneKalman.processNoiseCov[i][i] = 0.005;
+        laneKalman.errorCovPost[i][i] = 0.1;
+    }
+    for (int i = 0; i < 2; i++){
+        laneKalman.measurementNoiseCov[i][i] = 1e-1;
+    }
 }
 
 /********************************************************************************************
  * PREDICT PARAMETERS KALMAN FILTER FOR LANE TRACKING
  ********************************************************************************************
  * This function predicts the state
+ * The prediction is kept as the corrected state so it carries over frames without a measurement
  * Output -> no output
  */
 void LaneTracker::predictKalman(){
-    Mat prediction = laneKalman.predict();
-    predictPt.x = prediction.at<float>(0);
-    predictPt.y = prediction.at<float>(1);
-    
-    laneKalman.statePre.copyTo(laneKalman.statePost);
-    laneKalman.errorCovPre.copyTo(laneKalman.errorCovPost);
+    const float *prediction = laneKalman.predict();
+    predictPt.x = prediction[0];
+    predictPt.y = prediction[1];
 }
 
 /********************************************************************************************
@@ -75,22 +71,29 @@ void LaneTracker::predictKalman(){
  * \param theta - line parameter
  */
 void LaneTracker::correctKalman(float rho, float theta){
-    measurement(0) = rho;
-    measurement(1) = theta;
-    Mat estimated = laneKalman.correct(measurement);
-    statePt.x = estimated.at<float>(0);
-    statePt.y = estimated.at<float>(1);
+    measurement[0] = rho;
+    measurement[1] = theta;
+    const float *estimated = laneKalman.correct(measurement);
+    statePt.x = estimated[0];
+    statePt.y = estimated[1];
+    innovationPt.x = laneKalman.innovation[0];
+    innovationPt.y = laneKalman.innovation[1];
 }
 
 //********************************************************************************************
 //* SETTERS AND GETTERS
 //********************************************************************************************
 void LaneTracker::setState(cv::Mat state_){
-    state = state_;
+    Mat_<float> state = state_;
+    for (int i = 0; i < 4 && i < (int)state.total(); i++){
+        laneKalman.statePost[i] = state(i);
+    }
 }
 
 void LaneTracker::setMeasurement(cv::Mat measurement_){
-    measurement = measurement_;
+    Mat_<float> m = measurement_;
+    measurement[0] = m(0);
+    measurement[1] = m(1);
 }
 
 cv::Point_<float> LaneTracker::getState(){
@@ -100,3 +103,16 @@ cv::Point_<float> LaneTracker::getState(){
 cv::Point_<float> LaneTracker::getPredicted(){
     return predictPt;
 }
+
+cv::Point_<float> LaneTracker::getInnovation(){
+    return innovationPt;
+}
+
+float LaneTracker::getRhoStd(){
+    return std::sqrt(laneKalman.errorCovPost[0][0]);
+}
+
+// Get the full state (rho, theta, rho rate, theta rate)
+cv::Vec4f LaneTracker::getStateVector(){
+    return cv::Vec4f(laneKalman.statePost[0], laneKalman.statePost[1], laneKalman.statePost[2], laneKalman.statePost[3]);
+}
@@ -12,6 +12,9 @@
 // OpenCV header files
 #include "opencv2/video.hpp"
 
+// Fixed size Kalman filter header file
+#include "kalmanFilter.hpp"
+
 /*
  * Lane Tracker -> The main class used for tracking lane markers
  */
@@ -19,20 +22,20 @@ class LaneTracker {
     
     private:
         
-        // Kalman filter for lane marker tracking
-        cv::KalmanFilter laneKalman;
+        // Kalman filter for lane marker tracking (4 dynamic params, 2 measurement params)
+        FixedKalman<4, 2> laneKalman;
         
-        // Matrix containing the measured parameters (rho, theta)
-        cv::Mat_<float> measurement;
-    
-        // Matrix containing the state (rho, theta, rho_dot, theta_dot)
-        cv::Mat_<float> state;
+        // Array containing the measured parameters (rho, theta)
+        float measurement[2];
     
         // Point containing the state
         cv::Point_<float> statePt;
     
         // Point containing the predicted
         cv::Point_<float> predictPt;
+    
+        // Point containing the innovation (measured - predicted) of the last correction
+        cv::Point_<float> innovationPt;
         
     public:
     
@@ -75,6 +78,15 @@ class LaneTracker {
     
         cv::Point_<float> getPredicted();
     
+        // Get the innovation (measured - predicted rho, theta) of the last correction
+        cv::Point_<float> getInnovation();
+    
+        // Get the standard deviation of rho
+        float getRhoStd();
+    
+        // Get the full state (rho, theta, rho rate, theta rate)
+        cv::Vec4f getStateVector();
+    
 };
 
 #endif /* laneTracker_hpp */
@@ -0,0 +1,201 @@
+//
+//  laneTrackerBank.cpp
+//  cv_autonomous_vehicle
+//
+//  Batched lane tracking for many lanes and camera streams
+//
+
+#include "laneTrackerBank.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Index of covariance element (r,c) in the upper triangle
+int LaneTrackerBank::sym(int r, int c){
+    if (r > c){
+        int t = r; r = c; c = t;
+    }
+    return r*4 - r*(r-1)/2 + (c - r);
+}
+
+/********************************************************************************************
+ * ADD TRACK
+ ********************************************************************************************
+ * This function adds a lane marker track to the bank
+ * Output -> the index of the new track
+ * \param rho - initial line parameter
+ * \param theta - initial line parameter
+ */
+int LaneTrackerBank::addTrack(float rho, float theta){
+
+    for (int k = 0; k < 4; k++){
+        x[k].push_back(0);
+    }
+    for (int k = 0; k < 10; k++){
+        P[k].push_back(0);
+    }
+    predRho.push_back(rho);
+    predTheta.push_back(theta);
+
+    resetTrack(nTracks, rho, theta);
+    return nTracks++;
+}
+
+/********************************************************************************************
+ * RESET TRACK
+ ********************************************************************************************
+ * This function re-initialises the state and covariance of a track
+ * Output -> no output
+ * \param track - index of the track
+ * \param rho - line parameter
+ * \param theta - line parameter
+ */
+void LaneTrackerBank::resetTrack(int track, float rho, float theta){
+
+    x[0][track] = rho;
+    x[1][track] = theta;
+    x[2][track] = 0;
+    x[3][track] = 0;
+    for (int r = 0; r < 4; r++){
+        for (int c = r; c < 4; c++){
+            P[sym(r,c)][track] = (r == c) ? initialErrorCov : 0;
+        }
+    }
+}
+
+/********************************************************************************************
+ * PREDICT ALL TRACKS
+ ********************************************************************************************
+ * This function predicts the state of every track, x = F*x and P = F*P*F' + Q
+ * F = [I dt*I; 0 I], so with A, B, D the 2x2 blocks of P:
+ * A' = A + dt*(B + B') + dt^2*D, B' = B + dt*D, D' = D
+ * Output -> no output
+ */
+void LaneTrackerBank::predictAll(){
+
+    // Raw pointers to each component so the loop body is straight-line code
+    float *x0 = x[0].data(), *x1 = x[1].data(), *x2 = x[2].data(), *x3 = x[3].data();
+    float *p00 = P[sym(0,0)].data(), *p01 = P[sym(0,1)].data(), *p02 = P[sym(0,2)].data(), *p03 = P[sym(0,3)].data();
+    float *p11 = P[sym(1,1)].data(), *p12 = P[sym(1,2)].data(), *p13 = P[sym(1,3)].data();
+    float *p22 = P[sym(2,2)].data(), *p23 = P[sym(2,3)].data(), *p33 = P[sym(3,3)].data();
+    float *pr = predRho.data(), *pt = predTheta.data();
+    const float t = dt, t2 = dt*dt, q = processNoise;
+
+    for (int i = 0; i < nTracks; i++){
+
+        // State
+        x0[i] += t*x2[i];
+        x1[i] += t*x3[i];
+        pr[i] = x0[i];
+        pt[i] = x1[i];
+
+        // A block (uses the old B and D)
+        p00[i] += 2*t*p02[i] + t2*p22[i] + q;
+        p01[i] += t*(p03[i] + p12[i]) + t2*p23[i];
+        p11[i] += 2*t*p13[i] + t2*p33[i] + q;
+
+        // B block (uses D)
+        p02[i] += t*p22[i];
+        p03[i] += t*p23[i];
+        p12[i] += t*p23[i];
+        p13[i] += t*p33[i];
+
+        // D block
+        p22[i] += q;
+        p33[i] += q;
+    }
+}
+
+/********************************************************************************************
+ * CORRECT ALL TRACKS
+ ********************************************************************************************
+ * This function corrects every track that has a measurement
+ * H = [I 0] so S = A + R and K = P(:,0:1)*inv(S). Tracks without a measurement have their
+ * gain and innovation selected as zero rather than being skipped, which keeps the loop free of
+ * branches. They are selected rather than multiplied by a 0 mask, as an unused measurement
+ * (e.g. NaN) or a singular S would otherwise give 0*inf = NaN.
+ * Output -> no output
+ * \param rho - array of measured rho, one per track
+ * \param theta - array of measured theta, one per track
+ * \param valid - array of flags, non zero if the track has a measurement this frame
+ */
+void LaneTrackerBank::correctAll(const float *rho, const float *theta, const unsigned char *valid){
+
+    float *x0 = x[0].data(), *x1 = x[1].data(), *x2 = x[2].data(), *x3 = x[3].data();
+    float *p00 = P[sym(0,0)].data(), *p01 = P[sym(0,1)].data(), *p02 = P[sym(0,2)].data(), *p03 = P[sym(0,3)].data();
+    float *p11 = P[sym(1,1)].data(), *p12 = P[sym(1,2)].data(), *p13 = P[sym(1,3)].data();
+    float *p22 = P[sym(2,2)].data(), *p23 = P[sym(2,3)].data(), *p33 = P[sym(3,3)].data();
+    const float r = measurementNoise;
+
+    for (int i = 0; i < nTracks; i++){
+
+        // Inverse of the innovation covariance (2x2), zero for tracks without a measurement
+        bool has = valid[i] != 0;
+        float s00 = p00[i] + r, s01 = p01[i], s11 = p11[i] + r;
+        float invDet = has ? 1.f / (s00*s11 - s01*s01) : 0.f;
+        float i00 = s11*invDet, i01 = -s01*invDet, i11 = s00*invDet;
+
+        // Innovation (zero for tracks without a measurement, whatever their rho and theta hold)
+        float y0 = has ? rho[i] - x0[i] : 0.f;
+        float y1 = has ? theta[i] - x1[i] : 0.f;
+
+        // Columns of P used by the gain (P(:,0) and P(:,1))
+        float c0[4] = { p00[i], p01[i], p02[i], p03[i] };
+        float c1[4] = { p01[i], p11[i], p12[i], p13[i] };
+
+        // Gain K = [c0 c1]*inv(S)
+        float k0[4], k1[4];
+        for (int k = 0; k < 4; k++){
+            k0[k] = c0[k]*i00 + c1[k]*i01;
+            k1[k] = c0[k]*i01 + c1[k]*i11;
+        }
+
+        // State
+        x0[i] += k0[0]*y0 + k1[0]*y1;
+        x1[i] += k0[1]*y0 + k1[1]*y1;
+        x2[i] += k0[2]*y0 + k1[2]*y1;
+        x3[i] += k0[3]*y0 + k1[3]*y1;
+
+        // Covariance P = P - K*H*P (H*P is rows 0 and 1 of P, i.e. c0' and c1')
+        p00[i] -= k0[0]*c0[0] + k1[0]*c1[0];
+        p01[i] -= k0[0]*c0[1] + k1[0]*c1[1];
+        p02[i] -= k0[0]*c0[2] + k1[0]*c1[2];
+        p03[i] -= k0[0]*c0[3] + k1[0]*c1[3];
+        p11[i] -= k0[1]*c0[1] + k1[1]*c1[1];
+        p12[i] -= k0[1]*c0[2] + k1[1]*c1[2];
+        p13[i] -= k0[1]*c0[3] + k1[1]*c1[3];
+        p22[i] -= k0[2]*c0[2] + k1[2]*c1[2];
+        p23[i] -= k0[2]*c0[3] + k1[2]*c1[3];
+        p33[i] -= k0[3]*c0[3] + k1[3]*c1[3];
+    }
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the time step for the velocity terms
+void LaneTrackerBank::setTimeStep(float dt_){
+    dt = dt_;
+}
+
+// Set the process and measurement noise
+void LaneTrackerBank::setNoise(float process, float measurement){
+    processNoise = process;
+    measurementNoise = measurement;
+}
+
+// Get the number of tracks
+int LaneTrackerBank::size(){
+    return nTracks;
+}
+
+// Get the corrected (rho, theta) of a track
+cv::Point_<float> LaneTrackerBank::getState(int track){
+    return cv::Point_<float>(x[0][track], x[1][track]);
+}
+
+// Get the predicted (rho, theta) of a track
+cv::Point_<float> LaneTrackerBank::getPredicted(int track){
+    return cv::Point_<float>(predRho[track], predTheta[track]);
+}
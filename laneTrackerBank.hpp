@@ -0,0 +1,119 @@
+//
+//  laneTrackerBank.hpp
+//  cv_autonomous_vehicle
+//
+//  Batched lane tracking for many lanes and camera streams
+//
+
+#ifndef laneTrackerBank_hpp
+#define laneTrackerBank_hpp
+
+// OpenCV header files
+#include "opencv2/core.hpp"
+
+#include <vector>
+
+/*
+ * Lane Tracker Bank -> Tracks many lane markers with the same Kalman model as LaneTracker
+ * The states and covariances are stored as a structure of arrays (one array per component)
+ * so predict and correct are a single vectorisable sweep over all of the tracks.
+ * State is (rho, theta, rho_dot, theta_dot), measurement is (rho, theta).
+ * Only the kalman benchmark uses it so far: LaneDetector and StreamEngine still track each
+ * lane with its own LaneTracker.
+ */
+class LaneTrackerBank {
+
+    private:
+
+        // Number of tracks
+        int nTracks;
+
+        // Time step used for the velocity terms (0 -> identity transition as in LaneTracker)
+        float dt;
+
+        // Noise covariances (diagonal)
+        float processNoise;
+        float measurementNoise;
+
+        // Initial error covariance (diagonal)
+        float initialErrorCov;
+
+        // State components, x[k][track]
+        std::vector<float> x[4];
+
+        // Upper triangle of the symmetric error covariance, P[sym(r,c)][track]
+        std::vector<float> P[10];
+
+        // Predicted (rho, theta) from the last predict
+        std::vector<float> predRho, predTheta;
+
+        // Index of covariance element (r,c) in the upper triangle
+        static int sym(int r, int c);
+
+    public:
+
+        // Default parameter initialization (matches LaneTracker::initKalman)
+        LaneTrackerBank() : nTracks(0), dt(0), processNoise(0.005), measurementNoise(1e-1), initialErrorCov(0.1) {}
+
+        /********************************************************************************************
+         * ADD TRACK
+         ********************************************************************************************
+         * This function adds a lane marker track to the bank
+         * Output -> the index of the new track
+         * \param rho - initial line parameter
+         * \param theta - initial line parameter
+         */
+        int addTrack(float rho, float theta);
+
+        /********************************************************************************************
+         * RESET TRACK
+         ********************************************************************************************
+         * This function re-initialises the state and covariance of a track
+         * Output -> no output
+         * \param track - index of the track
+         * \param rho - line parameter
+         * \param theta - line parameter
+         */
+        void resetTrack(int track, float rho, float theta);
+
+        /********************************************************************************************
+         * PREDICT ALL TRACKS
+         ********************************************************************************************
+         * This function predicts the state of every track
+         * The prediction is kept as the corrected state so it carries over frames without a measurement
+         * Output -> no output
+         */
+        void predictAll();
+
+        /********************************************************************************************
+         * CORRECT ALL TRACKS
+         ********************************************************************************************
+         * This function corrects every track that has a measurement
+         * Output -> no output
+         * \param rho - array of measured rho, one per track
+         * \param theta - array of measured theta, one per track
+         * \param valid - array of flags, non zero if the track has a measurement this frame
+         */
+        void correctAll(const float *rho, const float *theta, const unsigned char *valid);
+
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+
+        // Set the time step for the velocity terms
+        void setTimeStep(float dt_);
+
+        // Set the process and measurement noise
+        void setNoise(float process, float measurement);
+
+        // Get the number of tracks
+        int size();
+
+        // Get the corrected (rho, theta) of a track
+        cv::Point_<float> getState(int track);
+
+        // Get the predicted (rho, theta) of a track
+        cv::Point_<float> getPredicted(int track);
+};
+
+#endif /* laneTrackerBank_hpp */
@@ -0,0 +1,107 @@
+//
+//  logExport.cpp
+//  cv_autonomous_vehicle
+//
+//  Exports a range of a result log as CSV
+//
+
+#include "resultLog.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+int main(int argc, char **argv) {
+
+    string log_name = argc > 1 ? argv[1] : "";
+
+    // Options
+    long long fromFrame = -1, toFrame = -1;
+    double fromTime = -1, toTime = -1;
+    string out_name;
+    for (int i = 2; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--from" && hasValue){
+            fromFrame = atoll(argv[++i]);
+        } else if (arg == "--to" && hasValue){
+            toFrame = atoll(argv[++i]);
+        } else if (arg == "--start" && hasValue){
+            fromTime = atof(argv[++i]);
+        } else if (arg == "--end" && hasValue){
+            toTime = atof(argv[++i]);
+        } else if (arg == "--out" && hasValue){
+            out_name = argv[++i];
+        }
+    }
+    if (log_name.empty()){
+        cout << "Usage: " << argv[0] << " <log> [--from frame] [--to frame] [--start ms] [--end ms] [--out file.csv]" << endl;
+        return -1;
+    }
+
+    ResultLogReader reader;
+    if (!reader.open(log_name)){
+        cout << "Error reading " << log_name << endl;
+        return -1;
+    }
+    if (reader.wasRecovered()){
+        cerr << log_name << " was not closed, the index was rebuilt from " << reader.size() << " records" << endl;
+    }
+
+    // Seek with the index to the first record of the range
+    size_t begin = 0, end = reader.size();
+    if (fromFrame >= 0){
+        begin = max(begin, reader.findFrame(fromFrame));
+    }
+    if (toFrame >= 0){
+        end = min(end, reader.findFrame(toFrame + 1));
+    }
+    if (fromTime >= 0){
+        begin = max(begin, reader.findTime(fromTime));
+    }
+    if (toTime >= 0){
+        end = min(end, reader.findTime(toTime));
+    }
+
+    ofstream file;
+    if (!out_name.empty()){
+        file.open(out_name.c_str());
+        if (!file.is_open()){
+            cout << "Error writing " << out_name << endl;
+            return -1;
+        }
+    }
+    ostream &out = out_name.empty() ? cout : file;
+
+    // One row per frame, the vehicles as x:y:width:height separated by spaces
+    out << "frame,timestamp_ms,lx1,ly1,lx2,ly2,rx1,ry1,rx2,ry2,l_rho,l_theta,r_rho,r_theta,"
+        << "l_pred_rho,l_pred_theta,r_pred_rho,r_pred_theta,n_cars,cars" << endl;
+    FrameResult res;
+    for (size_t i = begin; i < end; i++){
+        if (!reader.read(i, res)){
+            cerr << "Malformed record " << i << endl;
+            return -1;
+        }
+        out << res.frameId << "," << res.timestamp;
+        for (size_t p = 0; p < res.points.size(); p++){
+            out << "," << res.points[p];
+        }
+        for (size_t p = 0; p < res.lines.size(); p++){
+            out << "," << res.lines[p];
+        }
+        for (size_t p = 0; p < res.predicted.size(); p++){
+            out << "," << res.predicted[p];
+        }
+        out << "," << res.cars.size() << ",";
+        for (size_t c = 0; c < res.cars.size(); c++){
+            out << (c > 0 ? " " : "") << res.cars[c].x << ":" << res.cars[c].y << ":" << res.cars[c].width << ":" << res.cars[c].height;
+        }
+        out << endl;
+    }
+
+    return 0;
+}
@@ -16,10 +16,25 @@
 
 #include "laneTracker.hpp"
 
+#include "roadGenerator.hpp"
+
+#include "profiler.hpp"
+#include "tracer.hpp"
+
+#include "config.hpp"
+#include "frameSource.hpp"
+#include "videoSink.hpp"
+#include "deadlineScheduler.hpp"
+
+#include <memory>
+
 using namespace cv;
 using namespace std;
 
-int main() {
+// Frames generated by the synthetic road run when there is no window to stop it with a key
+static const int SYNTHETIC_FRAMES = 300;
+
+int main(int argc, char **argv) {
 
     // Create lane detector controller
     LaneDetectorController lController;
@@ -42,6 +57,7 @@ int main() {
     cout << "4: to run lane detection" << endl;
     cout << "5: to vehicle detection" << endl;
     cout << "6: to lane and vehicle detection" << endl;
+    cout << "7: to run lane detection on a synthetic road" << endl;
     cout << "q: to quit" << endl;
     
     // Initialise user input
@@ -53,10 +69,131 @@ int main() {
     // Set default haar cascade name
     string car_cascade_name = "/Users/Home/Google Drive/Tech/Programming/C++/Projects/vehicle_detection/vehicle_detection/cars.xml";
     
+    // Buffer for the per-frame timeline (written to trace.json after each run)
+    TRACE_ENABLE(1 << 18);
+    
     // Initialise IPM points
     std::vector<cv::Point2f> orgPts;
     std::vector<cv::Point2f> dstPts;
     
+    // Optional configuration file, watched for changes while the detectors run
+    ConfigWatcher watcher(argc > 1 ? argv[1] : "");
+    std::shared_ptr<const Config> config;
+    long configVersion = -1;
+    
+    // Frames decoded ahead of the pipeline
+    int prefetchDepth = 4;
+    
+    // Annotated video output (none by default), whether the result is shown and drawn into the decoded frame
+    string output_name;
+    size_t outputQueue = 8;
+    bool outputDrop = true;
+    bool display = true;
+    bool drawInPlace = false;
+    
+    // Per-frame processing budget before detector work is shed (0 -> never)
+    double frameBudget = 0;
+    if (argc > 1){
+        watcher.start();
+    }
+    
+    // Apply a new configuration snapshot (only the first frame after a change does any work)
+    auto updateConfig = [&](){
+        if (argc > 1 && watcher.poll(config, configVersion)){
+            lController.applyConfig(*config);
+            vController.applyConfig(*config);
+            if (!config->orgPts.empty()){
+                orgPts = config->orgPts;
+            }
+            if (!config->videoName.empty()){
+                video_name = config->videoName;
+            }
+            if (!config->cascadeName.empty() && config->cascadeName != car_cascade_name){
+                car_cascade_name = config->cascadeName;
+                vController.setCascade(car_cascade_name);
+            }
+            prefetchDepth = config->prefetchDepth;
+            frameBudget = config->frameBudget;
+            output_name = config->outputName;
+            outputQueue = config->outputQueue;
+            outputDrop = config->outputDrop;
+            display = config->display;
+            drawInPlace = config->drawInPlace;
+        }
+    };
+    updateConfig();
+    
+    // Print how often the pipeline waited for the decoder and the decoder for a free buffer
+    auto reportSource = [](const FrameSource &source){
+        FrameSourceStats stats = source.getStats();
+        cout << "Decoded frames: " << stats.decoded << ", waits for a frame: " << stats.consumerStalls << " (" << stats.consumerWaitMs
+             << " ms), waits for a buffer: " << stats.decoderStalls << " (" << stats.decoderWaitMs << " ms)" << endl;
+    };
+    
+    // Start encoding the annotated frames if an output video is configured
+    auto openSink = [&](VideoSink &sink, double fps){
+        sink.setQueue(outputQueue, outputDrop);
+        if (!output_name.empty() && !sink.open(output_name, fps, Size(), VideoWriter::fourcc('M','J','P','G'))){
+            cout << "Error creating " << output_name << endl;
+        }
+    };
+    
+    // Print how many annotated frames were encoded, dropped or held back by the encoder
+    auto reportSink = [](VideoSink &sink){
+        if (sink.isOpened()){
+            sink.close();
+            cout << "Encoded frames: " << sink.getWritten() << ", dropped: " << sink.getDropped()
+                 << ", waits for the encoder: " << sink.getBlockedMs() << " ms" << endl;
+        }
+    };
+    
+    // Print how many frames reused the last results because nothing had changed (counted since the start)
+    auto reportStatic = [&](){
+        if (lController.getStaticFrames() > 0 || vController.getStaticFrames() > 0){
+            cout << "Static frames reused, lanes: " << lController.getStaticFrames() << ", vehicles: " << vController.getStaticFrames() << endl;
+        }
+    };
+    
+    // Run the lane detector, or follow the Kalman prediction, as planned by the scheduler
+    auto runLanes = [&](const FramePlan &plan){
+        lController.setSkipHoughP(!plan.houghP);
+        if (plan.detectLanes){
+            lController.process();
+        } else {
+            lController.predict();
+        }
+    };
+    
+    // Run the vehicle detector, or keep the last vehicles, as planned by the scheduler
+    auto runVehicles = [&](const FramePlan &plan){
+        vController.setScaleReduction(plan.vehicleScale);
+        if (plan.detectVehicles){
+            vController.process();
+        }
+    };
+    
+    // Draw the overlay, straight into the frame if drawing in place (saves a copy, the frame is not used afterwards)
+    auto drawResult = [&](Mat &frame, const vector<float> &points, const vector<Rect> &cars){
+        if (drawInPlace){
+            controller.drawResultInPlace(frame, points, cars);
+        } else {
+            controller.drawResult(frame, points, cars);
+        }
+    };
+    
+    // Send the last result to the output video and the window
+    // Output -> false if a key was pressed
+    auto showResult = [&](const string &window, VideoSink &sink, int delay){
+        if (sink.isOpened()){
+            sink.write(controller.getLastResult());
+        }
+        if (display){
+            imshow(window, controller.getLastResult());
+            return waitKey(delay) < 0;
+        }
+        return true;
+    };
+    
     while( (key=getchar()) != 'q' ){
         
         switch (key) {
@@ -131,14 +268,26 @@ int main() {
                 
             case '4':
             {
-                // Read video
-                VideoCapture cap(video_name);
+                // trace.json and the latency report only hold this run
+                TRACE_RESET();
+                PROFILE_RESET();
+                
+                // Decode the video ahead of the pipeline
+                FrameSource source(prefetchDepth);
                 
                 // Check video was successfully opened
-                if (!cap.isOpened()){
+                if (!source.open(video_name)){
                     cout << "Error opening video file!" << endl;
                 }
                 
+                // Encode the annotated frames behind the pipeline
+                VideoSink sink;
+                openSink(sink, source.getFps());
+                
+                // Shed detector work when frames take longer than the budget
+                DeadlineScheduler scheduler(frameBudget);
+                scheduler.setStages({ STAGE_SKIP_HOUGHP, STAGE_PREDICT_LANES }); // lane stages only
+                
                 
                 // Initialise the Kalman filter
                 LaneTracker lTracker, rTracker;
@@ -152,8 +301,19 @@ int main() {
                 // Loop through video frames
                 int counter = 0;
                 for(;;) {
-                    Mat frame;
-                    cap >> frame;
+                    TRACE_SCOPE("frame", counter);
+                    updateConfig();
+                    shared_ptr<const SourceFrame> slot;
+                    {
+                        TRACE_SCOPE("decode", counter);
+                        slot = source.next();
+                    }
+                    if (!slot){
+                        break;
+                    }
+                    Mat frame = slot->mutableImage();
+                    scheduler.setBudget(frameBudget);
+                    FramePlan plan = scheduler.beginFrame(counter);
                     
                     // Set the image frame
                     lController.setVideoFrame(frame);
@@ -162,61 +322,121 @@ int main() {
                     lController.initIPM(orgPts);
                     
                     // Perform lane detection algorithm
-                    lController.process();
+                    runLanes(plan);
+                    scheduler.endFrame();
                     
-                    controller.drawResult(frame, lController.getPoints());
-
-                    // Display result
-                    imshow("Lane Detector", controller.getLastResult());
-                    if(waitKey(30) >= 0) break;
+                    // The overlay is only drawn if something shows or records it
+                    if (display || sink.isOpened()){
+                        TRACE_SCOPE("draw", counter);
+                        drawResult(frame, lController.getPoints(), vector<Rect>());
+                        if (!showResult("Lane Detector", sink, 30)) break;
+                    }
                     counter++;
                 }
+                
+                // Print the decoder stalls, the encoder counters, the degradation, the reused frames, the per-stage latencies and write the timeline
+                reportSource(source);
+                reportSink(sink);
+                if (scheduler.getBudget() > 0){
+                    scheduler.report(cout);
+                }
+                reportStatic();
+                PROFILE_REPORT(cout);
+                TRACE_WRITE("trace.json");
                 break;
             }
                 
             case '5':
             {
-                // Read video
-                VideoCapture cap(video_name);
+                // trace.json and the latency report only hold this run
+                TRACE_RESET();
+                PROFILE_RESET();
+                
+                // Decode the video ahead of the pipeline
+                FrameSource source(prefetchDepth);
                 
                 // Check video was successfully opened
-                if (!cap.isOpened()){
+                if (!source.open(video_name)){
                     cout << "Error opening video file!" << endl;
                 }
                 
+                // Encode the annotated frames behind the pipeline
+                VideoSink sink;
+                openSink(sink, source.getFps());
+                
+                // Shed detector work when frames take longer than the budget
+                DeadlineScheduler scheduler(frameBudget);
+                scheduler.setStages({ STAGE_VEHICLE_SCALE, STAGE_VEHICLE_KEYFRAMES }); // vehicle stages only
+                
                 // Set the car cascade
                 vController.setCascade(car_cascade_name);
                 
                 // Loop through video frames
+                int counter = 0;
                 for(;;) {
-                    Mat frame;
-                    cap >> frame;
+                    TRACE_SCOPE("frame", counter);
+                    updateConfig();
+                    shared_ptr<const SourceFrame> slot;
+                    {
+                        TRACE_SCOPE("decode", counter);
+                        slot = source.next();
+                    }
+                    if (!slot){
+                        break;
+                    }
+                    Mat frame = slot->mutableImage();
+                    scheduler.setBudget(frameBudget);
+                    FramePlan plan = scheduler.beginFrame(counter);
                     
                     // Set the image frame
                     vController.setVideoFrame(frame);
                     
                     // Perform vehicle detection algorithm
-                    vController.process();
-                    
-                    controller.drawResult(frame, vController.getCars());
+                    runVehicles(plan);
+                    scheduler.endFrame();
                     
-                    // Display result
-                    imshow("Vehicle Detector", controller.getLastResult());
-                    if(waitKey(30) >= 0) break;
+                    // The overlay is only drawn if something shows or records it
+                    if (display || sink.isOpened()){
+                        TRACE_SCOPE("draw", counter);
+                        drawResult(frame, vector<float>(), vController.getCars());
+                        if (!showResult("Vehicle Detector", sink, 30)) break;
+                    }
+                    counter++;
                 }
+                
+                // Print the decoder stalls, the encoder counters, the degradation, the reused frames, the per-stage latencies and write the timeline
+                reportSource(source);
+                reportSink(sink);
+                if (scheduler.getBudget() > 0){
+                    scheduler.report(cout);
+                }
+                reportStatic();
+                PROFILE_REPORT(cout);
+                TRACE_WRITE("trace.json");
                 break;
             }
                 
             case '6':
             {
-                // Read video
-                VideoCapture cap(video_name);
+                // trace.json and the latency report only hold this run
+                TRACE_RESET();
+                PROFILE_RESET();
+                
+                // Decode the video ahead of the pipeline
+                FrameSource source(prefetchDepth);
                 
                 // Check video was successfully opened
-                if (!cap.isOpened()){
+                if (!source.open(video_name)){
                     cout << "Error opening video file!" << endl;
                 }
                 
+                // Encode the annotated frames behind the pipeline
+                VideoSink sink;
+                openSink(sink, source.getFps());
+                
+                // Shed detector work when frames take longer than the budget
+                DeadlineScheduler scheduler(frameBudget);
+                
                 // Initialise the Kalman filter
                 LaneTracker lTracker, rTracker;
                 lTracker.initKalman(0, 0);
@@ -231,8 +451,19 @@ int main() {
                 // Loop through video frames
                 int counter = 0;
                 for(;;) {
-                    Mat frame;
-                    cap >> frame;
+                    TRACE_SCOPE("frame", counter);
+                    updateConfig();
+                    shared_ptr<const SourceFrame> slot;
+                    {
+                        TRACE_SCOPE("decode", counter);
+                        slot = source.next();
+                    }
+                    if (!slot){
+                        break;
+                    }
+                    Mat frame = slot->mutableImage();
+                    scheduler.setBudget(frameBudget);
+                    FramePlan plan = scheduler.beginFrame(counter);
                     
                     // Set the image frame
                     lController.setVideoFrame(frame);
@@ -242,18 +473,103 @@ int main() {
                     lController.initIPM(orgPts);
                     
                     // Perform lane detection algorithm
-                    lController.process();
+                    runLanes(plan);
                     
                     // Perform vehicle detection algorithm
-                    vController.process();
+                    runVehicles(plan);
+                    scheduler.endFrame();
                     
-                    controller.drawResult(frame, lController.getPoints(), vController.getCars());
+                    // The overlay is only drawn if something shows or records it
+                    if (display || sink.isOpened()){
+                        TRACE_SCOPE("draw", counter);
+                        drawResult(frame, lController.getPoints(), vController.getCars());
+                        if (!showResult("Lane and Vehicle Detector", sink, 30)) break;
+                    }
+                    counter++;
+                }
+                
+                // Print the decoder stalls, the encoder counters, the degradation, the reused frames, the per-stage latencies and write the timeline
+                reportSource(source);
+                reportSink(sink);
+                if (scheduler.getBudget() > 0){
+                    scheduler.report(cout);
+                }
+                reportStatic();
+                PROFILE_REPORT(cout);
+                TRACE_WRITE("trace.json");
+                break;
+            }
+                
+            case '7':
+            {
+                // trace.json and the latency report only hold this run
+                TRACE_RESET();
+                PROFILE_RESET();
+                
+                // Generate a dashed, curved road with lighting changes, noise and occluders
+                RoadGenerator road(Size(1920, 1080), 0);
+                road.setDashed(true);
+                road.setCurvature(2e-4);
+                road.setLighting(0.2, 8);
+                road.setOccluders(2);
+                
+                // Encode the annotated frames behind the pipeline
+                VideoSink sink;
+                openSink(sink, 30);
+                
+                // Initialise the Kalman filter
+                LaneTracker lTracker, rTracker;
+                lTracker.initKalman(0, 0);
+                rTracker.initKalman(0, 0);
+                
+                // Set the kalman filter
+                lController.initKalman(lTracker, rTracker);
+                
+                // Loop through generated frames
+                int counter = 0;
+                double errTotal = 0;
+                int nErr = 0;
+                double start = (double)getTickCount();
+                for(;;) {
+                    TRACE_SCOPE("frame", counter);
+                    updateConfig();
+                    Mat frame = road.nextFrame();
+                    
+                    // Set the image frame
+                    lController.setVideoFrame(frame);
                     
-                    // Display result
-                    imshow("Lane and Vehicle Detector", controller.getLastResult());
-                    if(waitKey(30) >= 0) break;
+                    // Initialise the IPM points
+                    lController.initIPM(orgPts);
+                    
+                    // Perform lane detection algorithm
+                    lController.process();
+                    
+                    // Compare with the ground truth
+                    float err = road.lateralError(lController.getPoints());
+                    if (err >= 0){
+                        errTotal += err;
+                        nErr++;
+                    }
+                    
+                    // The overlay is only drawn if something shows or records it
                     counter++;
+                    // The generated frame belongs to this loop and is not used after drawing, so it is always drawn into
+                    if (display || sink.isOpened()){
+                        controller.drawResultInPlace(frame, lController.getPoints(), vector<Rect>());
+                        if (!showResult("Lane Detector", sink, 1)) break;
+                    }
+                    
+                    // The road never ends, without a window no key can stop it
+                    if (!display && counter >= SYNTHETIC_FRAMES) break;
                 }
+                
+                double seconds = ((double)getTickCount() - start) / getTickFrequency();
+                cout << "Frames: " << counter << ", fps: " << counter / seconds << ", mean lateral error (pixels): " << (nErr > 0 ? errTotal / nErr : -1) << endl;
+                
+                // Print the encoder counters, the per-stage latencies and write the timeline
+                reportSink(sink);
+                PROFILE_REPORT(cout);
+                TRACE_WRITE("trace.json");
                 break;
             }
                 
@@ -0,0 +1,152 @@
+//
+//  multiStream.cpp
+//  cv_autonomous_vehicle
+//
+//  Lane and vehicle detection on several cameras at once
+//
+
+#include <opencv2/core.hpp>
+
+#include "streamEngine.hpp"
+#include "config.hpp"
+#include "resultPublisher.hpp"
+#include "resultLog.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+int main(int argc, char **argv) {
+
+    // Options
+    int nThreads = 0;
+    bool pin = false;
+    long nFrames = 0;
+    double interval = 1.0;
+    string car_cascade_name;
+    string publishPrefix, logPrefix, outPrefix;
+    size_t outQueue = 8;
+    bool outDrop = true;
+    vector<string> sources;
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue){
+            nThreads = atoi(argv[++i]);
+        } else if (arg == "--pin"){
+            pin = true;
+        } else if (arg == "--frames" && hasValue){
+            nFrames = atol(argv[++i]);
+        } else if (arg == "--interval" && hasValue){
+            interval = atof(argv[++i]);
+        } else if (arg == "--cascade" && hasValue){
+            car_cascade_name = argv[++i];
+        } else if (arg == "--publish" && hasValue){
+            publishPrefix = argv[++i];
+        } else if (arg == "--log" && hasValue){
+            logPrefix = argv[++i];
+        } else if (arg == "--out" && hasValue){
+            outPrefix = argv[++i];
+        } else if (arg == "--out-queue" && hasValue){
+            outQueue = atoi(argv[++i]);
+        } else if (arg == "--out-block"){
+            outDrop = false;
+        } else {
+            sources.push_back(arg);
+        }
+    }
+    if (sources.empty()){
+        cout << "Usage: " << argv[0] << " [--threads n] [--pin] [--frames n] [--interval s] [--cascade file] [--publish /prefix] [--log prefix] [--out prefix] [--out-queue n] [--out-block] source[,config.yml]..." << endl;
+        cout << "A source is a video file, a camera index, synthetic:<seed> or shm:<name> (see shmProducer)" << endl;
+        return -1;
+    }
+
+    // The pool provides the parallelism, so OpenCV runs each call on the calling thread
+    setNumThreads(1);
+
+    StreamEngine engine(nThreads, pin);
+    vector<bool> vehicles;
+    for (size_t i = 0; i < sources.size(); i++){
+
+        // Each camera has its own IPM points and parameters
+        string source = sources[i];
+        Config config;
+        size_t comma = source.find(',');
+        if (comma != string::npos){
+            if (!loadConfig(source.substr(comma + 1), config)){
+                cout << "Error reading configuration " << source.substr(comma + 1) << endl;
+                return -1;
+            }
+            source = source.substr(0, comma);
+        }
+
+        if (engine.addStream(source, config, car_cascade_name) < 0){
+            cout << "Error opening " << source << endl;
+            return -1;
+        }
+        vehicles.push_back(!car_cascade_name.empty() || !config.cascadeName.empty());
+    }
+
+    // Publish the results of stream i to the shared memory ring <prefix><i>
+    vector<unique_ptr<ResultPublisher> > publishers;
+    if (!publishPrefix.empty()){
+        for (size_t i = 0; i < sources.size(); i++){
+            publishers.push_back(unique_ptr<ResultPublisher>(new ResultPublisher()));
+            if (!publishers[i]->create(publishPrefix + to_string(i))){
+                cout << "Error creating shared memory " << publishPrefix << i << endl;
+                return -1;
+            }
+        }
+
+    }
+
+    // Log the results of stream i to <prefix><i>.ldlog
+    vector<unique_ptr<ResultLogWriter> > logs;
+    if (!logPrefix.empty()){
+        for (size_t i = 0; i < sources.size(); i++){
+            logs.push_back(unique_ptr<ResultLogWriter>(new ResultLogWriter()));
+            if (!logs[i]->open(logPrefix + to_string(i) + ".ldlog")){
+                cout << "Error creating " << logPrefix << i << ".ldlog" << endl;
+                return -1;
+            }
+        }
+    }
+
+    // Encode the annotated frames of stream i to <prefix><i>.avi
+    if (!outPrefix.empty()){
+        for (size_t i = 0; i < sources.size(); i++){
+            if (!engine.setOutput((int)i, outPrefix + to_string(i) + ".avi", outQueue, outDrop)){
+                cout << "Error creating " << outPrefix << i << ".avi" << endl;
+                return -1;
+            }
+        }
+    }
+
+    // A stream has one frame in flight, so each ring and log has a single writer at a time
+    if (!publishers.empty() || !logs.empty()){
+        engine.setResultCallback([&publishers, &logs, &vehicles](int stream, const FrameResult &res){
+            if (!publishers.empty()){
+                PublishedResult record;
+                toPublishedResult(res, vehicles[stream], record);
+                publishers[stream]->publish(record);
+            }
+            if (!logs.empty()){
+                logs[stream]->append(res);
+            }
+        });
+    }
+
+    engine.run(nFrames, interval);
+
+    for (size_t i = 0; i < logs.size(); i++){
+        if (!logs[i]->close()){
+            cout << "Error writing " << logPrefix << i << ".ldlog" << endl;
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+//
+//  offline.cpp
+//  cv_autonomous_vehicle
+//
+//  Offline lane and vehicle detection of a long recorded video
+//
+
+#include <opencv2/core.hpp>
+
+#include "offlineProcessor.hpp"
+#include "config.hpp"
+#include "frameResult.hpp"
+#include "resultLog.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+int main(int argc, char **argv) {
+
+    string video_name = argc > 1 ? argv[1] : "";
+
+    // Options
+    int nChunks = 0, overlap = 30, nThreads = 0;
+    string car_cascade_name, config_name, out_name, log_name;
+    bool compare = false;
+    for (int i = 2; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--chunks" && hasValue){
+            nChunks = atoi(argv[++i]);
+        } else if (arg == "--overlap" && hasValue){
+            overlap = atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue){
+            nThreads = atoi(argv[++i]);
+        } else if (arg == "--cascade" && hasValue){
+            car_cascade_name = argv[++i];
+        } else if (arg == "--config" && hasValue){
+            config_name = argv[++i];
+        } else if (arg == "--out" && hasValue){
+            out_name = argv[++i];
+        } else if (arg == "--log" && hasValue){
+            log_name = argv[++i];
+        } else if (arg == "--compare"){
+            compare = true;
+        }
+    }
+    if (video_name.empty()){
+        cout << "Usage: " << argv[0] << " <video> [--chunks n] [--overlap frames] [--threads n] [--cascade file] [--config file] [--out results.bin] [--log results.ldlog] [--compare]" << endl;
+        return -1;
+    }
+
+    Config config;
+    if (!config_name.empty() && !loadConfig(config_name, config)){
+        cout << "Error reading configuration " << config_name << endl;
+        return -1;
+    }
+
+    // The chunks provide the parallelism, so OpenCV runs each call on the calling thread
+    setNumThreads(1);
+
+    OfflineProcessor processor(video_name, config, car_cascade_name);
+    processor.setChunks(nChunks);
+    processor.setOverlap(overlap);
+    processor.setThreads(nThreads);
+
+    vector<FrameResult> results;
+    double start = (double)getTickCount();
+    if (!processor.process(results)){
+        cout << "Error opening " << video_name << endl;
+        return -1;
+    }
+    double seconds = ((double)getTickCount() - start) / getTickFrequency();
+    cout << "Chunked: " << results.size() << " frames in " << seconds << " s (" << results.size() / seconds << " fps)" << endl;
+
+    // One FrameResult record per frame, in order
+    if (!out_name.empty()){
+        ofstream out(out_name.c_str(), ios::binary);
+        for (size_t i = 0; i < results.size(); i++){
+            writeFrameResult(out, results[i]);
+        }
+        if (!out.good()){
+            cout << "Error writing " << out_name << endl;
+            return -1;
+        }
+    }
+
+    // Indexed result log with the line parameters and Kalman predictions (see logExport)
+    if (!log_name.empty()){
+        ResultLogWriter log;
+        bool ok = log.open(log_name);
+        for (size_t i = 0; ok && i < results.size(); i++){
+            log.append(results[i]);
+        }
+        if (!ok || !log.close()){
+            cout << "Error writing " << log_name << endl;
+            return -1;
+        }
+    }
+
+    // Compare with a sequential run (one chunk)
+    if (compare){
+        OfflineProcessor sequential(video_name, config, car_cascade_name);
+        sequential.setChunks(1);
+        vector<FrameResult> reference;
+        start = (double)getTickCount();
+        sequential.process(reference);
+        double seqSeconds = ((double)getTickCount() - start) / getTickFrequency();
+
+        int differ = 0;
+        double maxDrift = 0;
+        for (size_t i = 0; i < reference.size() && i < results.size(); i++){
+            double drift = reference[i].points.size() == results[i].points.size() ? 0 : HUGE_VAL;
+            for (size_t p = 0; p < reference[i].points.size() && p < results[i].points.size(); p++){
+                drift = max(drift, (double)fabs(reference[i].points[p] - results[i].points[p]));
+            }
+            differ += drift > 0 || reference[i].cars != results[i].cars;
+            maxDrift = max(maxDrift, drift);
+        }
+        cout << "Sequential: " << reference.size() << " frames in " << seqSeconds << " s, speedup " << seqSeconds / seconds << endl;
+        cout << "Frames that differ: " << differ + (int)max(reference.size(), results.size()) - (int)min(reference.size(), results.size())
+             << ", largest point drift " << maxDrift << " px" << endl;
+    }
+
+    return 0;
+}
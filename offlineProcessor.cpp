@@ -0,0 +1,204 @@
+//
+//  offlineProcessor.cpp
+//  cv_autonomous_vehicle
+//
+//  Chunk-parallel lane and vehicle detection of a recorded video
+//
+
+#include "offlineProcessor.hpp"
+
+#include "laneDetectorController.hpp"
+#include "vehicleDetectorController.hpp"
+#include "laneTracker.hpp"
+#include "threadPool.hpp"
+#include "tracer.hpp"
+
+#include <atomic>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+/********************************************************************************************
+ * OFFLINE PROCESSOR
+ ********************************************************************************************
+ * This function sets the input and the default chunking (one chunk per core, 30 frame overlap)
+ * Output -> no output
+ * \param video_name - input video file path and name
+ * \param config_ - parameters and IPM points
+ * \param car_cascade_name - haar cascade (empty for lane detection only)
+ */
+OfflineProcessor::OfflineProcessor(const string &video_name, const Config &config_, const string &car_cascade_name) : videoName(video_name), cascadeName(car_cascade_name), config(config_), nChunks(0), overlap(30), nThreads(0) {
+    if (!config.cascadeName.empty()){
+        cascadeName = config.cascadeName;
+    }
+}
+
+/********************************************************************************************
+ * PROCESS
+ ********************************************************************************************
+ * This function processes every frame of the video
+ * Output -> false if the video or cascade could not be opened
+ * \param results - the result of every frame, in order
+ */
+bool OfflineProcessor::process(vector<FrameResult> &results) const {
+
+    results.clear();
+
+    VideoCapture cap(videoName);
+    if (!cap.isOpened()){
+        return false;
+    }
+    long nFrames = (long)cap.get(CV_CAP_PROP_FRAME_COUNT);
+    cap.release();
+
+    ThreadPool pool(nThreads);
+    int chunks = nChunks > 0 ? nChunks : (int)pool.size();
+
+    // Without a frame count the video can only be processed in one pass
+    if (nFrames <= 0){
+        chunks = 1;
+    }
+    chunks = (int)max(1L, min((long)chunks, nFrames));
+    long chunkLen = (nFrames + chunks - 1) / chunks;
+
+    // The last chunk runs to the end of the video in case the frame count is an estimate
+    vector<vector<FrameResult> > chunkResults(chunks);
+    std::atomic<bool> ok(true);
+    for (int c = 0; c < chunks; c++){
+        long begin = c * chunkLen, end = c + 1 < chunks ? (c + 1) * chunkLen : -1;
+        vector<FrameResult> *res = &chunkResults[c];
+        pool.submit([this, begin, end, res, &ok](){
+            if (!processChunk(begin, end, *res)){
+                ok = false;
+            }
+        });
+    }
+    pool.waitIdle();
+    if (!ok){
+        return false;
+    }
+
+    // Stitch the chunks into one ordered output
+    for (int c = 0; c < chunks; c++){
+        results.insert(results.end(), chunkResults[c].begin(), chunkResults[c].end());
+    }
+    return true;
+}
+
+/********************************************************************************************
+ * PROCESS CHUNK
+ ********************************************************************************************
+ * This function processes one chunk with its own decoder and pipelines
+ * The decoder seeks to the start of the warm up window. POS_FRAMES read back after set() only
+ * echoes the request, so the seek is checked with the timestamp of the first frame decoded. If
+ * it is not the expected frame the video is reopened and the frames before the window are
+ * skipped with grab (no decoding).
+ * Output -> false if the video or cascade could not be opened
+ * \param begin - first frame of the chunk
+ * \param end - frame after the last frame of the chunk (< 0 -> until the video ends)
+ * \param results - the result of each frame of the chunk
+ */
+bool OfflineProcessor::processChunk(long begin, long end, vector<FrameResult> &results) const {
+
+    long warmStart = max(0L, begin - overlap);
+
+    VideoCapture cap(videoName);
+    if (!cap.isOpened()){
+        return false;
+    }
+    Mat frame;
+    bool decoded = false; // frame already holds the first frame of the warm up window
+    if (warmStart > 0){
+        // The first frame must be within half a frame of where frame warmStart is
+        double fps = cap.get(CV_CAP_PROP_FPS);
+        decoded = fps > 0 && cap.set(CV_CAP_PROP_POS_FRAMES, warmStart) && cap.read(frame)
+                  && fabs(cap.get(CV_CAP_PROP_POS_MSEC) - warmStart * 1000.0 / fps) < 500.0 / fps;
+        if (!decoded){
+            cap.open(videoName);
+            for (long f = 0; f < warmStart; f++){
+                if (!cap.grab()){
+                    return true;
+                }
+            }
+        }
+    }
+
+    // Same set up as a sequential run
+    LaneDetectorController lController;
+    LaneTracker lTracker, rTracker;
+    lTracker.initKalman(0, 0);
+    rTracker.initKalman(0, 0);
+    lController.initKalman(lTracker, rTracker);
+    lController.applyConfig(config);
+
+    VehicleDetectorController vController;
+    bool vehicles = !cascadeName.empty();
+    if (vehicles){
+        if (!vController.setCascade(cascadeName)){
+            return false;
+        }
+        vController.applyConfig(config);
+    }
+
+    results.clear();
+    for (long f = warmStart; end < 0 || f < end; f++){
+
+        // The position is the timestamp of the frame just read
+        if (!decoded){
+            cap >> frame;
+        }
+        decoded = false;
+        if (frame.empty()){
+            break;
+        }
+        double timestamp = cap.get(CV_CAP_PROP_POS_MSEC);
+
+        TRACE_SCOPE(f < begin ? "warm up frame" : "chunk frame", f);
+        lController.setVideoFrame(frame);
+        lController.initIPM(config.orgPts);
+        lController.process();
+
+        // Vehicle detection only carries state between frames with the smoothed equalization
+        if (vehicles && (f >= begin || config.smoothLUT)){
+            vController.setVideoFrame(frame);
+            vController.process();
+        }
+        if (f < begin){
+            continue;
+        }
+
+        FrameResult res;
+        res.frameId = f;
+        res.timestamp = timestamp;
+        res.points = lController.getPoints();
+        res.lines = lController.getLines();
+        res.predicted = lController.getPredicted();
+        res.state = lController.getTrackerState();
+        if (vehicles){
+            res.cars = vController.getCars();
+        }
+        results.push_back(res);
+    }
+
+    return true;
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the number of chunks (0 -> one per worker thread)
+void OfflineProcessor::setChunks(int chunks){
+    nChunks = max(0, chunks);
+}
+
+// Set the number of frames each chunk warms up on
+void OfflineProcessor::setOverlap(int frames){
+    overlap = max(0, frames);
+}
+
+// Set the number of worker threads (0 -> one per core)
+void OfflineProcessor::setThreads(int threads){
+    nThreads = max(0, threads);
+}
@@ -0,0 +1,92 @@
+//
+//  offlineProcessor.hpp
+//  cv_autonomous_vehicle
+//
+//  Chunk-parallel lane and vehicle detection of a recorded video
+//
+
+#ifndef offlineProcessor_hpp
+#define offlineProcessor_hpp
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+#include "config.hpp"
+#include "frameResult.hpp"
+
+#include <string>
+#include <vector>
+
+/*
+ * Offline Processor -> Splits a video into time chunks and processes them in parallel
+ * Each chunk has its own decoder and pipelines. Before its first frame a chunk runs the
+ * pipeline over a short overlap window of the preceding frames (results discarded) so its
+ * LaneTracker Kalman state has converged as it would have in a sequential run. The results
+ * of the chunks are stitched into one ordered vector with a result per frame, the same as a
+ * sequential run (one chunk).
+ */
+class OfflineProcessor {
+
+    private:
+
+        // Input video and haar cascade (empty for lane detection only)
+        std::string videoName;
+        std::string cascadeName;
+
+        // Parameters and IPM points
+        Config config;
+
+        // Number of chunks, frames in the warm up window, worker threads (0 -> one per core)
+        int nChunks;
+        int overlap;
+        int nThreads;
+
+    public:
+
+        /********************************************************************************************
+         * OFFLINE PROCESSOR
+         ********************************************************************************************
+         * This function sets the input and the default chunking (one chunk per core, 30 frame overlap)
+         * Output -> no output
+         * \param video_name - input video file path and name
+         * \param config_ - parameters and IPM points
+         * \param car_cascade_name - haar cascade (empty for lane detection only)
+         */
+        OfflineProcessor(const std::string &video_name, const Config &config_ = Config(), const std::string &car_cascade_name = "");
+
+        /********************************************************************************************
+         * PROCESS
+         ********************************************************************************************
+         * This function processes every frame of the video
+         * Output -> false if the video or cascade could not be opened
+         * \param results - the result of every frame, in order
+         */
+        bool process(std::vector<FrameResult> &results) const;
+
+        /********************************************************************************************
+         * PROCESS CHUNK
+         ********************************************************************************************
+         * This function processes frames [begin, end) with its own decoder and pipelines, after
+         * warming up on the overlap window before begin
+         * Output -> false if the video or cascade could not be opened
+         * \param begin - first frame of the chunk
+         * \param end - frame after the last frame of the chunk (< 0 -> until the video ends)
+         * \param results - the result of each frame of the chunk
+         */
+        bool processChunk(long begin, long end, std::vector<FrameResult> &results) const;
+
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+
+        // Set the number of chunks (0 -> one per worker thread)
+        void setChunks(int chunks);
+
+        // Set the number of frames each chunk warms up on
+        void setOverlap(int frames);
+
+        // Set the number of worker threads (0 -> one per core)
+        void setThreads(int threads);
+};
+
+#endif /* offlineProcessor_hpp */
@@ -0,0 +1,176 @@
+//
+//  profiler.cpp
+//  cv_autonomous_vehicle
+//
+//  Per-stage latency instrumentation for the lane and vehicle pipelines
+//
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+
+using namespace std;
+
+// Number of samples kept per thread (oldest samples are overwritten)
+static const size_t RING_SIZE = 1 << 16;
+
+/*
+ * Ring buffer of samples written by a single thread
+ */
+struct ProfileSample {
+    std::atomic<int> stage; // atomics (relaxed, plain moves) so summary() can read while the owner writes
+    std::atomic<long long> ns;
+};
+
+struct ProfileRing {
+    ProfileSample samples[RING_SIZE];
+    std::atomic<size_t> count; // total number of samples written (only by the owner)
+    std::atomic<size_t> start; // samples before this one were discarded by reset()
+    ProfileRing() : count(0), start(0) {}
+};
+
+// Rings of every thread that has recorded a sample (never freed, threads may outlive main)
+static std::mutex registryMutex;
+static std::vector<ProfileRing*> registry;
+
+// Ring of the calling thread
+static thread_local ProfileRing *localRing = 0;
+
+static const char* stageNames[PROFILE_STAGE_COUNT] = {
+    "lane total", "lane gray", "lane ipm", "lane threshold", "lane hough", "lane houghP",
+    "lane and", "lane rethreshold", "lane hough2", "lane sample", "lane fit", "lane line params",
+    "lane kalman predict", "lane kalman correct", "lane backproject",
+    "vehicle total", "vehicle gray", "vehicle resize", "vehicle equalize", "vehicle detect"
+};
+
+/********************************************************************************************
+ * RECORD
+ ********************************************************************************************
+ * This function stores the duration of a stage in the calling thread's ring buffer
+ * Output -> no output
+ * \param stage - the pipeline stage
+ * \param ns - the duration in nanoseconds
+ */
+void Profiler::record(int stage, long long ns){
+
+    // Register the ring the first time this thread records
+    if (!localRing){
+        localRing = new ProfileRing();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(localRing);
+    }
+
+    size_t n = localRing->count.load(std::memory_order_relaxed);
+    ProfileSample &s = localRing->samples[n % RING_SIZE];
+    s.stage.store(stage, std::memory_order_relaxed);
+    s.ns.store(ns, std::memory_order_relaxed);
+    localRing->count.store(n + 1, std::memory_order_release);
+}
+
+// Value at the given percentile of sorted samples
+static double percentile(const vector<long long> &sorted, double p){
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i] / 1000.0;
+}
+
+/********************************************************************************************
+ * SUMMARY
+ ********************************************************************************************
+ * This function collects the samples from every thread
+ * The rings are copied while their threads may still record, then the samples whose slot may
+ * have been reused during the copy are dropped (the same check as a sequence lock)
+ * Output -> statistics for each stage with at least one sample
+ */
+vector<StageStats> Profiler::summary(){
+
+    // Gather the durations of each stage
+    vector<vector<long long> > durations(PROFILE_STAGE_COUNT);
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (size_t r = 0; r < registry.size(); r++){
+            ProfileRing &ring = *registry[r];
+            size_t end = ring.count.load(std::memory_order_acquire);
+            size_t first = max(ring.start.load(std::memory_order_acquire), end > RING_SIZE ? end - RING_SIZE : (size_t)0);
+
+            // Snapshot of the samples [first, end)
+            vector<int> stages(end > first ? end - first : 0);
+            vector<long long> ns(stages.size());
+            for (size_t i = first; i < end; i++){
+                const ProfileSample &s = ring.samples[i % RING_SIZE];
+                stages[i - first] = s.stage.load(std::memory_order_relaxed);
+                ns[i - first] = s.ns.load(std::memory_order_relaxed);
+            }
+
+            // The owner may be writing sample after (count), which reuses the slot of (count - RING_SIZE)
+            std::atomic_thread_fence(std::memory_order_acquire);
+            size_t after = ring.count.load(std::memory_order_relaxed);
+            size_t valid = after + 1 > RING_SIZE ? after + 1 - RING_SIZE : 0;
+            for (size_t i = max(first, valid); i < end; i++){
+                int stage = stages[i - first];
+                if (stage >= 0 && stage < PROFILE_STAGE_COUNT){
+                    durations[stage].push_back(ns[i - first]);
+                }
+            }
+        }
+    }
+
+    vector<StageStats> stats;
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++){
+        vector<long long> &d = durations[stage];
+        if (d.empty()){
+            continue;
+        }
+        sort(d.begin(), d.end());
+
+        StageStats st;
+        st.name = stageNames[stage];
+        st.count = d.size();
+        long long total = 0;
+        for (size_t i = 0; i < d.size(); i++){
+            total += d[i];
+        }
+        st.mean = total / 1000.0 / d.size();
+        st.p50 = percentile(d, 0.50);
+        st.p95 = percentile(d, 0.95);
+        st.p99 = percentile(d, 0.99);
+        st.max = d.back() / 1000.0;
+        stats.push_back(st);
+    }
+    return stats;
+}
+
+/********************************************************************************************
+ * REPORT
+ ********************************************************************************************
+ * This function prints the p50/p95/p99 latency of each stage
+ * Output -> no output
+ * \param os - the output stream
+ */
+void Profiler::report(ostream &os){
+
+    vector<StageStats> stats = summary();
+
+    os << left << setw(20) << "stage (us)" << right << setw(10) << "count" << setw(12) << "mean" << setw(12) << "p50" << setw(12) << "p95" << setw(12) << "p99" << setw(12) << "max" << endl;
+    os << fixed << setprecision(1);
+    for (size_t i = 0; i < stats.size(); i++){
+        const StageStats &st = stats[i];
+        os << left << setw(20) << st.name << right << setw(10) << st.count << setw(12) << st.mean << setw(12) << st.p50 << setw(12) << st.p95 << setw(12) << st.p99 << setw(12) << st.max << endl;
+    }
+    os.unsetf(ios::floatfield);
+}
+
+// Discard all of the recorded samples (only the owner writes the count, so the start is moved instead)
+void Profiler::reset(){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (size_t r = 0; r < registry.size(); r++){
+        registry[r]->start.store(registry[r]->count.load(std::memory_order_acquire), std::memory_order_release);
+    }
+}
+
+// Get the name of a stage
+const char* Profiler::stageName(int stage){
+    return (stage >= 0 && stage < PROFILE_STAGE_COUNT) ? stageNames[stage] : "unknown";
+}
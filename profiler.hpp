@@ -0,0 +1,146 @@
+//
+//  profiler.hpp
+//  cv_autonomous_vehicle
+//
+//  Per-stage latency instrumentation for the lane and vehicle pipelines
+//
+
+#ifndef profiler_hpp
+#define profiler_hpp
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tracer.hpp"
+
+/*
+ * Stages of the lane and vehicle detection pipelines
+ */
+enum ProfileStage {
+    LANE_TOTAL,         // LaneDetector::process
+    LANE_GRAY,          // gray scale conversion
+    LANE_IPM,           // inverse perspective mapping
+    LANE_THRESHOLD,     // adaptive threshold
+    LANE_HOUGH,         // hough transform
+    LANE_HOUGHP,        // probabilistic hough transform
+    LANE_AND,           // bitwise and of the hough images
+    LANE_RETHRESHOLD,   // threshold and adaptive threshold of the combined image
+    LANE_HOUGH2,        // second hough transform
+    LANE_SAMPLE,        // sampling along the image height
+    LANE_FIT,           // least squares fit
+    LANE_LINE_PARAMS,   // rho, theta of the best fit line
+    LANE_KALMAN_PREDICT,    // Kalman predict
+    LANE_KALMAN_CORRECT,    // Kalman correct
+    LANE_BACKPROJECT,   // projection of the lines onto the original image
+    VEHICLE_TOTAL,      // VehicleDetector::process
+    VEHICLE_GRAY,       // gray scale conversion
+    VEHICLE_RESIZE,     // downscale for detection
+    VEHICLE_EQUALIZE,   // histogram equalization
+    VEHICLE_DETECT,     // detectMultiScale
+    PROFILE_STAGE_COUNT
+};
+
+/*
+ * Stage Statistics -> Summary of the recorded durations for one stage (in microseconds)
+ */
+struct StageStats {
+    std::string name;
+    size_t count;
+    double mean, p50, p95, p99, max;
+};
+
+/*
+ * Profiler -> Records stage durations into per-thread ring buffers
+ * Each thread writes only to its own ring so recording takes no locks. A lock is only taken
+ * the first time a thread records (to register its ring) and when the results are collected.
+ * summary() copies each ring while it may still be written and keeps only the samples that
+ * cannot have been overwritten during the copy. reset() moves the start of each ring instead
+ * of clearing its count, so it never races with the thread writing it.
+ */
+class Profiler {
+
+    public:
+
+        /********************************************************************************************
+         * RECORD
+         ********************************************************************************************
+         * This function stores the duration of a stage in the calling thread's ring buffer
+         * Output -> no output
+         * \param stage - the pipeline stage
+         * \param ns - the duration in nanoseconds
+         */
+        static void record(int stage, long long ns);
+
+        /********************************************************************************************
+         * SUMMARY
+         ********************************************************************************************
+         * This function collects the samples from every thread
+         * Output -> statistics for each stage with at least one sample
+         */
+        static std::vector<StageStats> summary();
+
+        /********************************************************************************************
+         * REPORT
+         ********************************************************************************************
+         * This function prints the p50/p95/p99 latency of each stage
+         * Output -> no output
+         * \param os - the output stream
+         */
+        static void report(std::ostream &os);
+
+        // Discard all of the recorded samples
+        static void reset();
+
+        // Get the name of a stage
+        static const char* stageName(int stage);
+};
+
+/*
+ * Scoped Timer -> Records the time between construction and destruction (or stop) for a stage
+ */
+class ScopedTimer {
+
+    private:
+
+        int stage;
+        bool running;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+
+        ScopedTimer(int stage_) : stage(stage_), running(true), start(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer(){
+            stop();
+        }
+
+        // Record the stage now rather than at the end of the scope
+        void stop(){
+            if (running){
+                running = false;
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                Profiler::record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+#ifdef ENABLE_TRACING
+                // Stages also appear on the timeline under the current frame
+                Tracer::record(Profiler::stageName(stage), Tracer::getCurrentFrame(), start, end);
+#endif
+            }
+        }
+};
+
+// Instrumentation compiles out to nothing unless built with -DENABLE_PROFILING
+#ifdef ENABLE_PROFILING
+#define PROFILE_SCOPE(stage) ScopedTimer profileTimer_##stage(stage)
+#define PROFILE_STOP(stage) profileTimer_##stage.stop()
+#define PROFILE_REPORT(os) Profiler::report(os)
+#define PROFILE_RESET() Profiler::reset()
+#else
+#define PROFILE_SCOPE(stage)
+#define PROFILE_STOP(stage)
+#define PROFILE_REPORT(os)
+#define PROFILE_RESET()
+#endif
+
+#endif /* profiler_hpp */
@@ -0,0 +1,444 @@
+//
+//  regression.cpp
+//  cv_autonomous_vehicle
+//
+//  Golden-output regression harness for the lane and vehicle detection pipelines
+//
+
+#include <opencv2/core.hpp>
+#include "opencv2/videoio.hpp"
+
+#include "laneDetectorController.hpp"
+#include "vehicleDetectorController.hpp"
+
+#include "laneTracker.hpp"
+#include "roadGenerator.hpp"
+#include "frameResult.hpp"
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+// Golden file identifier and format version
+static const char GOLDEN_MAGIC[8] = { 'L', 'D', 'G', 'O', 'L', 'D', 'E', 'N' };
+static const uint32_t GOLDEN_VERSION = 1;
+
+// Number of frames generated for a synthetic clip when no frame limit is given
+static const int SYNTHETIC_FRAMES = 300;
+
+/*
+ * Clip Result -> Per-frame output and processing time for one clip
+ */
+struct ClipResult {
+    string name;
+    vector<FrameResult> frames;
+    vector<float> ms;
+};
+
+/********************************************************************************************
+ * RUN CLIP
+ ********************************************************************************************
+ * This function runs the lane (and vehicle) detection pipeline over a clip
+ * A clip is a video file or "synthetic:<seed>" for a generated road
+ * Output -> false if the clip could not be opened
+ * \param clip - the clip name
+ * \param car_cascade_name - haar cascade file path and name (empty for lane detection only)
+ * \param maxFrames - maximum number of frames to process (0 for the whole clip)
+ * \param res - the per-frame results
+ */
+static bool runClip(const string &clip, const string &car_cascade_name, int maxFrames, ClipResult &res){
+
+    res.name = clip;
+    res.frames.clear();
+    res.ms.clear();
+
+    // Open the clip
+    bool synthetic = clip.compare(0, 10, "synthetic:") == 0;
+    RoadGenerator road(Size(1920, 1080), synthetic ? atoi(clip.c_str() + 10) : 0);
+    road.setDashed(true);
+    road.setCurvature(2e-4);
+    road.setLighting(0.2, 8);
+    road.setOccluders(2);
+    VideoCapture cap;
+    if (synthetic){
+        if (maxFrames <= 0){
+            maxFrames = SYNTHETIC_FRAMES;
+        }
+    } else if (!cap.open(clip)){
+        cout << "Error opening video file " << clip << endl;
+        return false;
+    }
+
+    // Same set up as the lane and vehicle detection in main.cpp
+    LaneDetectorController lController;
+    LaneTracker lTracker, rTracker;
+    lTracker.initKalman(0, 0);
+    rTracker.initKalman(0, 0);
+    lController.initKalman(lTracker, rTracker);
+    vector<Point2f> orgPts;
+
+    VehicleDetectorController vController;
+    bool vehicles = !car_cascade_name.empty();
+    if (vehicles && !vController.setCascade(car_cascade_name)){
+        cout << "Error loading haar cascade!" << endl;
+        return false;
+    }
+
+    Mat frame;
+    for (int i = 0; maxFrames <= 0 || i < maxFrames; i++){
+
+        FrameResult fr;
+        fr.frameId = i;
+        if (synthetic){
+            road.nextFrame(frame);
+            fr.timestamp = i * 1000.0 / 30;
+        } else {
+            cap >> frame;
+            if (frame.empty()){
+                break;
+            }
+            fr.timestamp = cap.get(CV_CAP_PROP_POS_MSEC);
+        }
+
+        // Only the pipeline is timed (not decoding or generating the frame)
+        double start = (double)getTickCount();
+        lController.setVideoFrame(frame);
+        lController.initIPM(orgPts);
+        lController.process();
+        if (vehicles){
+            vController.setVideoFrame(frame);
+            vController.process();
+        }
+        res.ms.push_back((float)(((double)getTickCount() - start) * 1000 / getTickFrequency()));
+
+        fr.points = lController.getPoints();
+        if (vehicles){
+            fr.cars = vController.getCars();
+        }
+        res.frames.push_back(fr);
+    }
+
+    return true;
+}
+
+/********************************************************************************************
+ * WRITE GOLDEN
+ ********************************************************************************************
+ * This function writes the clip results to a golden file
+ * Layout -> magic, uint32 version, uint32 number of clips, then per clip uint32 name length,
+ * name, uint32 number of frames and per frame a FrameResult followed by float32 time (ms)
+ * Output -> false if the file could not be written
+ * \param fileName - golden file path and name
+ * \param clips - the clip results
+ */
+static bool writeGolden(const string &fileName, const vector<ClipResult> &clips){
+
+    ofstream out(fileName.c_str(), ios::binary);
+    if (!out.is_open()){
+        return false;
+    }
+
+    uint32_t version = GOLDEN_VERSION, nClips = (uint32_t)clips.size();
+    out.write(GOLDEN_MAGIC, sizeof(GOLDEN_MAGIC));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&nClips), sizeof(nClips));
+
+    for (size_t c = 0; c < clips.size(); c++){
+        uint32_t nameLen = (uint32_t)clips[c].name.size(), nFrames = (uint32_t)clips[c].frames.size();
+        out.write(reinterpret_cast<const char*>(&nameLen), sizeof(nameLen));
+        out.write(clips[c].name.data(), nameLen);
+        out.write(reinterpret_cast<const char*>(&nFrames), sizeof(nFrames));
+        for (size_t i = 0; i < nFrames; i++){
+            writeFrameResult(out, clips[c].frames[i]);
+            out.write(reinterpret_cast<const char*>(&clips[c].ms[i]), sizeof(float));
+        }
+    }
+
+    return out.good();
+}
+
+/********************************************************************************************
+ * READ GOLDEN
+ ********************************************************************************************
+ * This function reads a golden file written by writeGolden
+ * Output -> false if the file could not be read or is not a golden file
+ * \param fileName - golden file path and name
+ * \param clips - the clip results
+ */
+static bool readGolden(const string &fileName, vector<ClipResult> &clips){
+
+    ifstream in(fileName.c_str(), ios::binary);
+    char magic[sizeof(GOLDEN_MAGIC)];
+    uint32_t version, nClips;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, GOLDEN_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != GOLDEN_VERSION ||
+        !in.read(reinterpret_cast<char*>(&nClips), sizeof(nClips))){
+        return false;
+    }
+
+    clips.assign(nClips, ClipResult());
+    for (size_t c = 0; c < nClips; c++){
+        uint32_t nameLen, nFrames;
+        if (!in.read(reinterpret_cast<char*>(&nameLen), sizeof(nameLen))){
+            return false;
+        }
+        clips[c].name.resize(nameLen);
+        if ((nameLen > 0 && !in.read(&clips[c].name[0], nameLen)) || !in.read(reinterpret_cast<char*>(&nFrames), sizeof(nFrames))){
+            return false;
+        }
+        clips[c].frames.resize(nFrames);
+        clips[c].ms.resize(nFrames);
+        for (size_t i = 0; i < nFrames; i++){
+            if (!readFrameResult(in, clips[c].frames[i]) || !in.read(reinterpret_cast<char*>(&clips[c].ms[i]), sizeof(float))){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/********************************************************************************************
+ * POINT DRIFT
+ ********************************************************************************************
+ * This function compares the lane marker points of two frames
+ * Output -> largest absolute difference of any coordinate (pixels), infinity if the number of points differs
+ * \param golden - the golden points
+ * \param points - the new points
+ */
+static double pointDrift(const vector<float> &golden, const vector<float> &points){
+
+    if (golden.size() != points.size()){
+        return HUGE_VAL;
+    }
+    double drift = 0;
+    for (size_t i = 0; i < golden.size(); i++){
+        drift = max(drift, (double)fabs(golden[i] - points[i]));
+    }
+    return drift;
+}
+
+/********************************************************************************************
+ * CARS MATCH
+ ********************************************************************************************
+ * This function compares the detected vehicles of two frames
+ * Output -> true if the number of cars is the same and each golden car overlaps a new car
+ * \param golden - the golden cars
+ * \param cars - the new cars
+ * \param iouTol - minimum intersection over union of matching cars
+ */
+static bool carsMatch(const vector<Rect> &golden, const vector<Rect> &cars, double iouTol){
+
+    if (golden.size() != cars.size()){
+        return false;
+    }
+    for (size_t g = 0; g < golden.size(); g++){
+        double best = 0;
+        for (size_t n = 0; n < cars.size(); n++){
+            best = max(best, intersectionOverUnion(golden[g], cars[n]));
+        }
+        if (best < iouTol){
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************************
+ * COMPARE
+ ********************************************************************************************
+ * This function reruns each clip in the golden file and reports the drift and speedup
+ * Output -> number of frames outside the tolerances (-1 if a clip could not be run)
+ * \param golden - the golden clip results
+ * \param car_cascade_name - haar cascade file path and name (empty for lane detection only)
+ * \param pointTol - largest lane marker point drift allowed (pixels)
+ * \param iouTol - minimum intersection over union of matching cars
+ */
+static int compare(const vector<ClipResult> &golden, const string &car_cascade_name, double pointTol, double iouTol){
+
+    int totalFailures = 0;
+    const int maxListed = 10;
+    vector<string> listed;
+
+    cout << "clip,frames,mean_drift_px,max_drift_px,lane_failures,car_failures,golden_ms,new_ms,speedup" << endl;
+    for (size_t c = 0; c < golden.size(); c++){
+
+        const ClipResult &g = golden[c];
+        ClipResult res;
+        if (!runClip(g.name, car_cascade_name, (int)g.frames.size(), res)){
+            return -1;
+        }
+
+        size_t n = min(g.frames.size(), res.frames.size());
+        int laneFailures = (int)(g.frames.size() - n), carFailures = 0;
+        int frameFailures = laneFailures; // frames missing or with the lanes or the cars out of tolerance
+        double driftTotal = 0, driftMax = 0, goldenMs = 0, newMs = 0;
+        int nDrift = 0;
+        for (size_t i = 0; i < n; i++){
+            double drift = pointDrift(g.frames[i].points, res.frames[i].points);
+            bool carsOk = car_cascade_name.empty() || carsMatch(g.frames[i].cars, res.frames[i].cars, iouTol);
+            if (drift <= pointTol){
+                driftTotal += drift;
+                nDrift++;
+            }
+            driftMax = max(driftMax, drift);
+            bool failed = drift > pointTol || !carsOk;
+            laneFailures += drift > pointTol;
+            carFailures += !carsOk;
+            frameFailures += failed;
+            goldenMs += g.ms[i];
+            newMs += res.ms[i];
+
+            if (failed && (int)listed.size() < maxListed){
+                ostringstream line;
+                line << g.name << " frame " << i << ": drift " << drift << " px, cars " << g.frames[i].cars.size() << " -> " << res.frames[i].cars.size();
+                listed.push_back(line.str());
+            }
+        }
+
+        cout << g.name << "," << g.frames.size() << "," << (nDrift > 0 ? driftTotal / nDrift : 0) << "," << driftMax << ","
+             << laneFailures << "," << carFailures << "," << goldenMs / max(n, (size_t)1) << "," << newMs / max(n, (size_t)1) << ","
+             << (newMs > 0 ? goldenMs / newMs : 0) << endl;
+        totalFailures += frameFailures;
+    }
+
+    for (size_t i = 0; i < listed.size(); i++){
+        cout << listed[i] << endl;
+    }
+
+    return totalFailures;
+}
+
+/********************************************************************************************
+ * CHECK ROI
+ ********************************************************************************************
+ * This function runs the vehicle detector with detection regions partly and fully outside
+ * a generated frame, which must not throw and must fall back to the frame
+ * Output -> number of failed checks (-1 if the cascade could not be loaded)
+ * \param car_cascade_name - haar cascade file path and name
+ */
+static int checkROI(const string &car_cascade_name){
+
+    CascadeClassifier car_cascade;
+    if (!car_cascade.load(car_cascade_name)){
+        cout << "Error loading haar cascade!" << endl;
+        return -1;
+    }
+    RoadGenerator road(Size(1920, 1080), 1);
+    road.setOccluders(2);
+    Mat frame;
+    road.nextFrame(frame);
+    Rect frameRect( 0, 0, frame.cols, frame.rows );
+
+    VehicleDetector vdetect;
+    vector<Rect> full = vdetect.process(frame, car_cascade);
+
+    const Rect rois[] = { Rect(frame.cols + 100, frame.rows + 100, 400, 300), Rect(-500, -500, 200, 200), Rect(frame.cols - 200, frame.rows - 200, 400, 400) };
+    const bool outside[] = { true, true, false };
+    int failures = 0;
+    for (int r = 0; r < 3; r++){
+        vdetect.setDetectROI(rois[r]);
+        vector<Rect> cars;
+        bool ok = true;
+        try {
+            cars = vdetect.process(frame, car_cascade);
+        } catch (const cv::Exception &e){
+            cout << "ROI " << rois[r] << ": " << e.what() << endl;
+            ok = false;
+        }
+        for (size_t n = 0; n < cars.size(); n++){
+            ok = ok && (cars[n] & frameRect) == cars[n];
+        }
+        if (outside[r]){
+            ok = ok && cars == full;
+        }
+        cout << "ROI " << rois[r] << ": " << cars.size() << " cars" << (ok ? " (PASS)" : " (FAIL)") << endl;
+        failures += !ok;
+    }
+    return failures;
+}
+
+int main(int argc, char **argv) {
+
+    string mode = argc > 1 ? argv[1] : "";
+    string golden_name = argc > 2 ? argv[2] : "";
+
+    // Options
+    vector<string> clips;
+    string car_cascade_name;
+    int maxFrames = 0, maxFailures = 0;
+    double pointTol = 2, iouTol = 0.9;
+    for (int i = mode == "check" ? 2 : 3; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--cascade" && hasValue){
+            car_cascade_name = argv[++i];
+        } else if (arg == "--frames" && hasValue){
+            maxFrames = atoi(argv[++i]);
+        } else if (arg == "--point-tol" && hasValue){
+            pointTol = atof(argv[++i]);
+        } else if (arg == "--iou-tol" && hasValue){
+            iouTol = atof(argv[++i]);
+        } else if (arg == "--max-failures" && hasValue){
+            maxFailures = atoi(argv[++i]);
+        } else {
+            clips.push_back(arg);
+        }
+    }
+
+    if (mode == "record" && !golden_name.empty() && !clips.empty()){
+
+        // Same output on every run (noise, occluders)
+        setRNGSeed(42);
+
+        vector<ClipResult> results(clips.size());
+        for (size_t c = 0; c < clips.size(); c++){
+            if (!runClip(clips[c], car_cascade_name, maxFrames, results[c])){
+                return -1;
+            }
+            cout << clips[c] << ": " << results[c].frames.size() << " frames" << endl;
+        }
+        if (!writeGolden(golden_name, results)){
+            cout << "Error writing golden file " << golden_name << endl;
+            return -1;
+        }
+        return 0;
+    }
+    if (mode == "compare" && !golden_name.empty()){
+
+        setRNGSeed(42);
+
+        vector<ClipResult> golden;
+        if (!readGolden(golden_name, golden)){
+            cout << "Error reading golden file " << golden_name << endl;
+            return -1;
+        }
+        int failures = compare(golden, car_cascade_name, pointTol, iouTol);
+        if (failures < 0){
+            return -1;
+        }
+        cout << "Frames outside tolerance: " << failures << (failures > maxFailures ? " (FAIL)" : " (PASS)") << endl;
+        return failures > maxFailures ? 1 : 0;
+    }
+
+    if (mode == "check" && !car_cascade_name.empty()){
+
+        int failures = checkROI(car_cascade_name);
+        return failures != 0 ? 1 : 0;
+    }
+
+    cout << "Usage: " << argv[0] << " record <golden file> <clip>... [--cascade file] [--frames n]" << endl;
+    cout << "       " << argv[0] << " compare <golden file> [--cascade file] [--point-tol px] [--iou-tol iou] [--max-failures n]" << endl;
+    cout << "       " << argv[0] << " check --cascade file" << endl;
+    cout << "A clip is a video file or synthetic:<seed>" << endl;
+    return -1;
+}
@@ -0,0 +1,137 @@
+//
+//  replay.cpp
+//  cv_autonomous_vehicle
+//
+//  Re-draws the lane and vehicle overlays of a video from a result log without running the detectors
+//
+
+#include <opencv2/core.hpp>
+#include "opencv2/highgui.hpp"
+#include "opencv2/videoio.hpp"
+
+#include "controller.hpp"
+#include "frameSource.hpp"
+#include "resultLog.hpp"
+#include "videoSink.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+int main(int argc, char **argv) {
+
+    string video_name = argc > 2 ? argv[1] : "";
+    string log_name = argc > 2 ? argv[2] : "";
+
+    // Options
+    string out_name, codec = "MJPG";
+    bool view = true;
+    int depth = 8;
+    for (int i = 3; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue){
+            out_name = argv[++i];
+        } else if (arg == "--codec" && hasValue){
+            codec = argv[++i];
+        } else if (arg == "--prefetch" && hasValue){
+            depth = atoi(argv[++i]);
+        } else if (arg == "--no-view"){
+            view = false;
+        }
+    }
+    if (video_name.empty() || codec.size() != 4){
+        cout << "Usage: " << argv[0] << " <video> <log> [--out annotated.avi] [--codec MJPG] [--prefetch frames] [--no-view]" << endl;
+        return -1;
+    }
+
+    ResultLogReader log;
+    if (!log.open(log_name)){
+        cout << "Error reading " << log_name << endl;
+        return -1;
+    }
+
+    // Frame size and rate of the output
+    VideoCapture probe(video_name);
+    if (!probe.isOpened()){
+        cout << "Error opening video file!" << endl;
+        return -1;
+    }
+    Size size((int)probe.get(CV_CAP_PROP_FRAME_WIDTH), (int)probe.get(CV_CAP_PROP_FRAME_HEIGHT));
+    double fps = probe.get(CV_CAP_PROP_FPS);
+    probe.release();
+
+    // Decode ahead and encode behind the drawing
+    FrameSource source(depth);
+    source.open(video_name);
+    // Every frame is kept, the drawing waits for the encoder when it falls behind
+    VideoSink sink(16, false);
+    if (!out_name.empty() && !sink.open(out_name, fps > 0 ? fps : 30, size, VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]))){
+        cout << "Error creating " << out_name << endl;
+        return -1;
+    }
+    if (view){
+        namedWindow("Replay", CV_WINDOW_AUTOSIZE);
+    }
+
+    // Frames are matched to records by frame id, frames without a record are shown unannotated
+    // Only this loop holds the decoded frames and it does not use them after drawing, so the overlay goes
+    // straight into them
+    Controller controller;
+    FrameResult res;
+    size_t next = 0;
+    long frames = 0, annotated = 0;
+    double start = (double)getTickCount();
+    for (;;){
+        shared_ptr<const SourceFrame> slot = source.next();
+        if (!slot){
+            break;
+        }
+
+        // Records are in frame order, so the index is only searched after a gap
+        bool found = next < log.size() && log.read(next, res) && res.frameId == slot->index;
+        if (!found){
+            next = log.findFrame(slot->index);
+            found = next < log.size() && log.read(next, res) && res.frameId == slot->index;
+        }
+        if (found){
+            annotated++;
+            next++;
+        }
+        frames++;
+
+        // Nothing to draw if the result is neither shown nor recorded
+        if (!view && !sink.isOpened()){
+            continue;
+        }
+        Mat frame = slot->mutableImage();
+        if (found){
+            controller.drawResultInPlace(frame, res.points, res.cars);
+        } else {
+            controller.drawResultInPlace(frame, vector<float>(), vector<Rect>());
+        }
+
+        if (sink.isOpened()){
+            sink.write(controller.getLastResult());
+        }
+        if (view){
+            imshow("Replay", controller.getLastResult());
+            if (waitKey(1) >= 0) break;
+        }
+    }
+    sink.close();
+
+    double seconds = ((double)getTickCount() - start) / getTickFrequency();
+    FrameSourceStats stats = source.getStats();
+    cout << "Frames: " << frames << " (" << annotated << " annotated), fps: " << frames / seconds
+         << ", waits for a frame: " << stats.consumerStalls << endl;
+    if (!out_name.empty()){
+        cout << "Wrote " << sink.getWritten() << " frames to " << out_name << " (most frames queued: " << sink.getMaxQueued()
+             << ", waits for the encoder: " << sink.getBlockedMs() << " ms)" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,370 @@
+//
+//  resultLog.cpp
+//  cv_autonomous_vehicle
+//
+//  Append-only binary log of the per-frame results with an index for random access
+//
+
+#include "resultLog.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+static const char LOG_MAGIC[8] = { 'L', 'D', 'R', 'E', 'S', 'L', 'O', 'G' };
+static const char INDEX_MAGIC[8] = { 'L', 'D', 'I', 'N', 'D', 'E', 'X', '\0' };
+
+// Header, trailer and fixed part of a record (bytes)
+static const size_t HEADER_SIZE = 16;
+static const size_t TRAILER_SIZE = 24;
+static const size_t RECORD_FIXED = 8 + 8 + 8 * 4 + 4 * 4 + 4 * 4 + 2;
+
+// Write a plain value in host byte order
+template<typename T>
+static void putValue(ostream &out, const T &value){
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Copy n floats from a result vector (zeros if it is shorter)
+static void putFloats(ostream &out, const vector<float> &values, size_t n){
+    for (size_t i = 0; i < n; i++){
+        putValue(out, i < values.size() ? values[i] : 0.f);
+    }
+}
+
+// Read a plain value from the mapping (records are not aligned)
+template<typename T>
+static T getValue(const uint8_t *p){
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+//********************************************************************************************
+//* WRITER
+//********************************************************************************************
+
+/********************************************************************************************
+ * OPEN
+ ********************************************************************************************
+ * This function creates the log and starts the writer thread
+ * Output -> false if the file could not be created
+ * \param fileName_ - log file path and name
+ */
+bool ResultLogWriter::open(const string &fileName_){
+
+    close();
+    fileName = fileName_;
+    out.open(fileName.c_str(), ios::binary | ios::trunc);
+    if (!out.is_open()){
+        return false;
+    }
+
+    out.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    putValue(out, RESULT_LOG_VERSION);
+    putValue(out, (uint32_t)0);
+    if (!out.good()){
+        // No writer thread to join, the file is left without a valid header
+        out.close();
+        return false;
+    }
+    offset = HEADER_SIZE;
+    index.clear();
+    queue.clear();
+    maxQueued = 0;
+    closing = false;
+
+    writer = thread(&ResultLogWriter::write, this);
+    return true;
+}
+
+/********************************************************************************************
+ * APPEND
+ ********************************************************************************************
+ * This function queues the result of a frame
+ * Output -> no output
+ * \param res - the frame result
+ */
+void ResultLogWriter::append(const FrameResult &res){
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        queue.push_back(res);
+        maxQueued = max(maxQueued, queue.size());
+    }
+    ready.notify_one();
+}
+
+/********************************************************************************************
+ * WRITE
+ ********************************************************************************************
+ * This function encodes and writes the queued results until the log is closed
+ * Output -> no output
+ */
+void ResultLogWriter::write(){
+
+    vector<FrameResult> batch;
+    ostringstream record;
+    for (;;){
+        {
+            unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this](){ return !queue.empty() || closing; });
+            if (queue.empty()){
+                break;
+            }
+            batch.swap(queue);
+        }
+
+        for (size_t i = 0; i < batch.size(); i++){
+            const FrameResult &res = batch[i];
+            record.str("");
+            putValue(record, (int64_t)res.frameId);
+            putValue(record, res.timestamp);
+            putFloats(record, res.points, 8);
+            putFloats(record, res.lines, 4);
+            putFloats(record, res.predicted, 4);
+            uint16_t nCars = (uint16_t)min(res.cars.size(), (size_t)65535);
+            putValue(record, nCars);
+            for (size_t c = 0; c < nCars; c++){
+                int32_t rect[4] = { res.cars[c].x, res.cars[c].y, res.cars[c].width, res.cars[c].height };
+                record.write(reinterpret_cast<const char*>(rect), sizeof(rect));
+            }
+
+            string bytes = record.str();
+            putValue(out, (uint32_t)bytes.size());
+            out.write(bytes.data(), bytes.size());
+
+            ResultLogIndex entry = { (int64_t)res.frameId, res.timestamp, offset };
+            index.push_back(entry);
+            offset += sizeof(uint32_t) + bytes.size();
+        }
+        batch.clear();
+
+        // Written records survive a crash of the pipeline (the index is rebuilt by the reader)
+        out.flush();
+    }
+}
+
+/********************************************************************************************
+ * CLOSE
+ ********************************************************************************************
+ * This function writes the queued results and the index and closes the log
+ * Output -> false if a write failed
+ */
+bool ResultLogWriter::close(){
+
+    if (!writer.joinable()){
+        return true;
+    }
+    {
+        lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    ready.notify_one();
+    writer.join();
+
+    // Index aligned to 8 bytes so readers can use it in place
+    uint64_t padding = (8 - offset % 8) % 8;
+    for (uint64_t i = 0; i < padding; i++){
+        out.put('\0');
+    }
+    uint64_t indexOffset = offset + padding;
+    if (!index.empty()){
+        out.write(reinterpret_cast<const char*>(&index[0]), index.size() * sizeof(ResultLogIndex));
+    }
+    putValue(out, (uint64_t)index.size());
+    putValue(out, indexOffset);
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+
+    bool ok = out.good();
+    out.close();
+    return ok;
+}
+
+// Get the most results that were waiting for the writer thread at once
+size_t ResultLogWriter::getMaxQueued(){
+    lock_guard<std::mutex> lock(mutex);
+    return maxQueued;
+}
+
+//********************************************************************************************
+//* READER
+//********************************************************************************************
+
+/********************************************************************************************
+ * OPEN
+ ********************************************************************************************
+ * This function maps a log and finds its index
+ * Output -> false if the file could not be mapped or is not a result log
+ * \param fileName - log file path and name
+ */
+bool ResultLogReader::open(const string &fileName){
+
+    close();
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0){
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE){
+        ::close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED){
+        return false;
+    }
+    base = static_cast<const uint8_t*>(mem);
+    mappedSize = st.st_size;
+
+    if (memcmp(base, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || getValue<uint32_t>(base + 8) != RESULT_LOG_VERSION){
+        close();
+        return false;
+    }
+
+    // Use the index written when the log was closed
+    if (mappedSize >= HEADER_SIZE + TRAILER_SIZE && memcmp(base + mappedSize - 8, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0){
+        uint64_t n = getValue<uint64_t>(base + mappedSize - TRAILER_SIZE);
+        uint64_t indexOffset = getValue<uint64_t>(base + mappedSize - TRAILER_SIZE + 8);
+        if (indexOffset % 8 == 0 && indexOffset + n * sizeof(ResultLogIndex) + TRAILER_SIZE == mappedSize){
+            index = reinterpret_cast<const ResultLogIndex*>(base + indexOffset);
+            nRecords = n;
+            return true;
+        }
+    }
+
+    // The writer stopped before writing the index
+    scan();
+    return true;
+}
+
+/********************************************************************************************
+ * SCAN
+ ********************************************************************************************
+ * This function rebuilds the index from the records (up to the first incomplete record)
+ * Output -> false if the log ends with an incomplete record
+ */
+bool ResultLogReader::scan(){
+
+    scanned.clear();
+    size_t pos = HEADER_SIZE;
+    while (pos + sizeof(uint32_t) + RECORD_FIXED <= mappedSize){
+        uint32_t length = getValue<uint32_t>(base + pos);
+        if (length < RECORD_FIXED || pos + sizeof(uint32_t) + length > mappedSize){
+            break;
+        }
+        ResultLogIndex entry;
+        entry.frameId = getValue<int64_t>(base + pos + 4);
+        entry.timestamp = getValue<double>(base + pos + 12);
+        entry.offset = pos;
+        scanned.push_back(entry);
+        pos += sizeof(uint32_t) + length;
+    }
+    index = scanned.empty() ? NULL : &scanned[0];
+    nRecords = scanned.size();
+    return pos == mappedSize;
+}
+
+// Unmap the log
+void ResultLogReader::close(){
+
+    if (base){
+        munmap(const_cast<uint8_t*>(base), mappedSize);
+    }
+    base = NULL;
+    index = NULL;
+    scanned.clear();
+    nRecords = 0;
+}
+
+// Get the number of records
+size_t ResultLogReader::size() const {
+    return nRecords;
+}
+
+/********************************************************************************************
+ * READ
+ ********************************************************************************************
+ * This function decodes a record
+ * Output -> false if i is out of range or the record is malformed (e.g. a damaged index or
+ *           length), nothing is read outside the mapping
+ * \param i - number of the record
+ * \param res - the frame result (points, lines, predicted and cars)
+ */
+bool ResultLogReader::read(size_t i, FrameResult &res) const {
+
+    // The record (length prefix, fixed fields and cars) must lie within the mapping
+    if (i >= nRecords || index[i].offset > mappedSize || mappedSize - index[i].offset < sizeof(uint32_t) + RECORD_FIXED){
+        return false;
+    }
+    const uint8_t *p = base + index[i].offset;
+    uint32_t length = getValue<uint32_t>(p);
+    uint16_t nCars = getValue<uint16_t>(p + sizeof(uint32_t) + RECORD_FIXED - sizeof(uint16_t));
+    if (length > mappedSize - index[i].offset - sizeof(uint32_t) || length != RECORD_FIXED + nCars * 4 * sizeof(int32_t)){
+        return false;
+    }
+    p += sizeof(uint32_t);
+
+    res.frameId = getValue<int64_t>(p);
+    res.timestamp = getValue<double>(p + 8);
+    p += 16;
+    res.points.resize(8);
+    memcpy(&res.points[0], p, 8 * sizeof(float));
+    p += 8 * sizeof(float);
+    res.lines.resize(4);
+    memcpy(&res.lines[0], p, 4 * sizeof(float));
+    p += 4 * sizeof(float);
+    res.predicted.resize(4);
+    memcpy(&res.predicted[0], p, 4 * sizeof(float));
+    p += 4 * sizeof(float);
+    p += sizeof(uint16_t);
+
+    res.cars.resize(nCars);
+    for (size_t c = 0; c < nCars; c++){
+        int32_t rect[4];
+        memcpy(rect, p + c * sizeof(rect), sizeof(rect));
+        res.cars[c] = Rect(rect[0], rect[1], rect[2], rect[3]);
+    }
+    res.state.clear();
+    return true;
+}
+
+/********************************************************************************************
+ * FIND FRAME
+ ********************************************************************************************
+ * This function finds the record of a frame (binary search, the frame ids increase)
+ * Output -> number of the first record with a frame id >= frameId (size() if there is none)
+ * \param frameId - id of the frame
+ */
+size_t ResultLogReader::findFrame(long long frameId) const {
+
+    const ResultLogIndex *end = index + nRecords;
+    return lower_bound(index, end, frameId, [](const ResultLogIndex &e, long long id){ return e.frameId < id; }) - index;
+}
+
+/********************************************************************************************
+ * FIND TIME
+ ********************************************************************************************
+ * This function finds the record at a time (binary search, the timestamps increase)
+ * Output -> number of the first record with a timestamp >= timestamp (size() if there is none)
+ * \param timestamp - time (ms)
+ */
+size_t ResultLogReader::findTime(double timestamp) const {
+
+    const ResultLogIndex *end = index + nRecords;
+    return lower_bound(index, end, timestamp, [](const ResultLogIndex &e, double t){ return e.timestamp < t; }) - index;
+}
+
+// True if the index was rebuilt because the log was not closed
+bool ResultLogReader::wasRecovered() const {
+    return index != NULL && index == (scanned.empty() ? NULL : &scanned[0]);
+}
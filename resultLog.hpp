@@ -0,0 +1,184 @@
+//
+//  resultLog.hpp
+//  cv_autonomous_vehicle
+//
+//  Append-only binary log of the per-frame results with an index for random access
+//
+
+#ifndef resultLog_hpp
+#define resultLog_hpp
+
+#include "frameResult.hpp"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Log layout (host byte order)
+ *
+ *   header   char[8] "LDRESLOG", uint32 version, uint32 reserved
+ *   records  one per frame -> uint32 length of the rest of the record, int64 frame id,
+ *            float64 timestamp (ms), float32 points[8], float32 lines[4] (rho, theta found),
+ *            float32 predicted[4] (Kalman rho, theta), uint16 number of vehicles,
+ *            int32 x,y,width,height per vehicle
+ *   index    zero padding to a multiple of 8 bytes, then one ResultLogIndex per record in order
+ *   trailer  uint64 number of records, uint64 offset of the index, char[8] "LDINDEX\0"
+ *
+ * The index and trailer are written when the log is closed. A log without them (the writer
+ * stopped early) is still readable, the reader rebuilds the index by scanning the records.
+ */
+struct ResultLogIndex {
+    int64_t frameId;
+    double timestamp;
+    uint64_t offset;    // offset of the record from the start of the file
+};
+
+static const uint32_t RESULT_LOG_VERSION = 1;
+
+/*
+ * Result Log Writer -> Appends frame results to a log on a background thread
+ * append() only moves the result into a queue, the writer thread encodes and writes the
+ * queued results in batches so the pipeline never waits for the disk.
+ */
+class ResultLogWriter {
+
+    private:
+
+        std::ofstream out;
+        std::string fileName;
+
+        // Results waiting for the writer thread
+        std::vector<FrameResult> queue;
+        size_t maxQueued; // most results waiting at once
+        bool closing;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::thread writer;
+
+        // Index of the written records and the current end of the file
+        std::vector<ResultLogIndex> index;
+        uint64_t offset;
+
+        // Writer thread function
+        void write();
+
+    public:
+
+        ResultLogWriter() : maxQueued(0), closing(false), offset(0) {}
+
+        // Writes the index and closes the log
+        ~ResultLogWriter(){
+            close();
+        }
+
+        /********************************************************************************************
+         * OPEN
+         ********************************************************************************************
+         * This function creates the log and starts the writer thread
+         * Output -> false if the file could not be created
+         * \param fileName_ - log file path and name
+         */
+        bool open(const std::string &fileName_);
+
+        /********************************************************************************************
+         * APPEND
+         ********************************************************************************************
+         * This function queues the result of a frame
+         * Output -> no output
+         * \param res - the frame result
+         */
+        void append(const FrameResult &res);
+
+        /********************************************************************************************
+         * CLOSE
+         ********************************************************************************************
+         * This function writes the queued results and the index and closes the log
+         * Output -> false if a write failed
+         */
+        bool close();
+
+        // Get the most results that were waiting for the writer thread at once
+        size_t getMaxQueued();
+};
+
+/*
+ * Result Log Reader -> Memory maps a log for random access by record, frame id or timestamp
+ */
+class ResultLogReader {
+
+    private:
+
+        // The mapping
+        const uint8_t *base;
+        size_t mappedSize;
+
+        // Index in the file, or rebuilt by scanning the records if the log was not closed
+        const ResultLogIndex *index;
+        std::vector<ResultLogIndex> scanned;
+        size_t nRecords;
+
+        // Rebuild the index from the records, false if the log is corrupt before its end
+        bool scan();
+
+    public:
+
+        ResultLogReader() : base(NULL), mappedSize(0), index(NULL), nRecords(0) {}
+
+        // Unmaps the log
+        ~ResultLogReader(){
+            close();
+        }
+
+        /********************************************************************************************
+         * OPEN
+         ********************************************************************************************
+         * This function maps a log and finds its index
+         * Output -> false if the file could not be mapped or is not a result log
+         * \param fileName - log file path and name
+         */
+        bool open(const std::string &fileName);
+
+        // Unmap the log
+        void close();
+
+        // Get the number of records
+        size_t size() const;
+
+        /********************************************************************************************
+         * READ
+         ********************************************************************************************
+         * This function decodes a record
+         * Output -> false if i is out of range or the record is malformed
+         * \param i - number of the record
+         * \param res - the frame result (points, lines, predicted and cars)
+         */
+        bool read(size_t i, FrameResult &res) const;
+
+        /********************************************************************************************
+         * FIND FRAME
+         ********************************************************************************************
+         * This function finds the record of a frame (binary search, the frame ids increase)
+         * Output -> number of the first record with a frame id >= frameId (size() if there is none)
+         * \param frameId - id of the frame
+         */
+        size_t findFrame(long long frameId) const;
+
+        /********************************************************************************************
+         * FIND TIME
+         ********************************************************************************************
+         * This function finds the record at a time (binary search, the timestamps increase)
+         * Output -> number of the first record with a timestamp >= timestamp (size() if there is none)
+         * \param timestamp - time (ms)
+         */
+        size_t findTime(double timestamp) const;
+
+        // True if the index was rebuilt because the log was not closed
+        bool wasRecovered() const;
+};
+
+#endif /* resultLog_hpp */
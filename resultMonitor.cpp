@@ -0,0 +1,69 @@
+//
+//  resultMonitor.cpp
+//  cv_autonomous_vehicle
+//
+//  Example consumer of the results published to shared memory
+//
+
+#include "resultPublisher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+
+    string name = argc > 1 ? argv[1] : "";
+
+    // Options
+    bool quiet = false;
+    int timeoutMs = 5000;
+    for (int i = 2; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--quiet"){
+            quiet = true;
+        } else if (arg == "--timeout" && hasValue){
+            timeoutMs = atoi(argv[++i]);
+        }
+    }
+    if (name.empty()){
+        cout << "Usage: " << argv[0] << " <name e.g. /lanes0> [--quiet] [--timeout ms]" << endl;
+        return -1;
+    }
+
+    ResultSubscriber subscriber;
+    if (!subscriber.open(name, timeoutMs)){
+        cout << "Error opening shared memory " << name << endl;
+        return -1;
+    }
+
+    // Print each record and the time from publishing to reading it
+    PublishedResult record;
+    vector<double> latencyUs;
+    while (subscriber.next(record, timeoutMs)){
+        long long now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+        latencyUs.push_back((now - record.publishNs) / 1e3);
+
+        if (!quiet){
+            cout << record.frameId << "," << record.timestamp;
+            for (int i = 0; i < 8; i++){
+                cout << "," << record.points[i];
+            }
+            cout << "," << ((record.flags & RESULT_LEFT_FOUND) ? 1 : 0) << "," << ((record.flags & RESULT_RIGHT_FOUND) ? 1 : 0)
+                 << "," << record.nCars << endl;
+        }
+    }
+
+    if (!latencyUs.empty()){
+        sort(latencyUs.begin(), latencyUs.end());
+        cout << "records: " << latencyUs.size() << ", dropped: " << subscriber.getDropped() << ", latency p50: "
+             << latencyUs[latencyUs.size() / 2] << " us, p99: " << latencyUs[latencyUs.size() * 99 / 100] << " us" << endl;
+    }
+    return 0;
+}
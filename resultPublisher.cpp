@@ -0,0 +1,349 @@
+//
+//  resultPublisher.cpp
+//  cv_autonomous_vehicle
+//
+//  Per-frame results published to other processes through a POSIX shared memory ring
+//
+
+#include "resultPublisher.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+// The layout is shared between processes, so it must not depend on the compiler
+static_assert(sizeof(PublishedResult) == 640, "PublishedResult must be 640 bytes");
+static_assert(sizeof(SharedResultHeader) == 64, "SharedResultHeader must be 64 bytes");
+static_assert(sizeof(SharedResultSlot) == 704, "SharedResultSlot must be 704 bytes");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64 bit atomics must be lock free to be shared between processes");
+
+// next() polls without sleeping for a short while, then sleeps for doubling intervals up to a cap,
+// so a reader that keeps up sees a record within microseconds and an idle one wakes ~10000 times a
+// second at most (a record that arrives while it sleeps is seen within ~100us plus the wake up time)
+static const int SPIN_POLLS = 200;
+static const int MIN_SLEEP_US = 5;
+static const int MAX_SLEEP_US = 100;
+
+// Slot n of a mapped ring
+static inline SharedResultSlot* slotAt(uint8_t *base, uint64_t n, uint32_t nSlots){
+    return reinterpret_cast<SharedResultSlot*>(base + sizeof(SharedResultHeader) + (n % nSlots) * sizeof(SharedResultSlot));
+}
+
+/********************************************************************************************
+ * TO PUBLISHED RESULT
+ ********************************************************************************************
+ * This function fills a fixed layout record from a frame result
+ * Output -> no output
+ * \param res - the frame result
+ * \param vehicles - vehicle detection ran on the frame
+ * \param record - the record (publishNs is set by ResultPublisher::publish)
+ */
+void toPublishedResult(const FrameResult &res, bool vehicles, PublishedResult &record){
+
+    memset(&record, 0, sizeof(record));
+    record.frameId = res.frameId;
+    record.timestamp = res.timestamp;
+
+    if (res.points.size() >= 8){
+        copy(res.points.begin(), res.points.begin() + 8, record.points);
+        record.flags |= RESULT_LANES;
+    }
+    if (res.lines.size() >= 4){
+        copy(res.lines.begin(), res.lines.begin() + 4, record.lines);
+        if (record.lines[0] != 0 && record.lines[1] != 0){
+            record.flags |= RESULT_LEFT_FOUND;
+        }
+        if (record.lines[2] != 0 && record.lines[3] != 0){
+            record.flags |= RESULT_RIGHT_FOUND;
+        }
+    }
+    if (res.state.size() >= 8){
+        copy(res.state.begin(), res.state.begin() + 8, record.state);
+    }
+
+    if (vehicles){
+        record.flags |= RESULT_CARS;
+    }
+    record.nCars = (uint32_t)min(res.cars.size(), (size_t)PUBLISHED_MAX_CARS);
+    for (uint32_t i = 0; i < record.nCars; i++){
+        record.cars[i][0] = res.cars[i].x;
+        record.cars[i][1] = res.cars[i].y;
+        record.cars[i][2] = res.cars[i].width;
+        record.cars[i][3] = res.cars[i].height;
+    }
+}
+
+//********************************************************************************************
+//* PUBLISHER
+//********************************************************************************************
+
+/********************************************************************************************
+ * CREATE
+ ********************************************************************************************
+ * This function creates the shared memory ring (replacing a stale one of the same name)
+ * Output -> false if the shared memory could not be created or mapped
+ * \param name_ - name of the shared memory object (e.g. "/lanes0")
+ * \param nSlots - number of records kept
+ */
+bool ResultPublisher::create(const string &name_, int nSlots){
+
+    close();
+    name = name_;
+    nSlots = max(nSlots, 2);
+    mappedSize = sizeof(SharedResultHeader) + nSlots * sizeof(SharedResultSlot);
+
+    // A ring left by a publisher that crashed is replaced
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0){
+        return false;
+    }
+    if (ftruncate(fd, mappedSize) != 0){
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *mem = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED){
+        shm_unlink(name.c_str());
+        return false;
+    }
+    base = static_cast<uint8_t*>(mem);
+
+    // The new object is zero filled, construct the atomics in place
+    header = new (base) SharedResultHeader();
+    header->version = SHARED_RESULTS_VERSION;
+    header->recordSize = sizeof(PublishedResult);
+    header->nSlots = nSlots;
+    header->closed.store(0);
+    header->written.store(0);
+    for (int i = 0; i < nSlots; i++){
+        new (slotAt(base, i, nSlots)) SharedResultSlot();
+    }
+
+    // Readers wait for the magic number, so it is published last
+    atomic_thread_fence(memory_order_release);
+    header->magic = SHARED_RESULTS_MAGIC;
+    return true;
+}
+
+/********************************************************************************************
+ * PUBLISH
+ ********************************************************************************************
+ * This function publishes a record (it never waits for the readers)
+ * Output -> false if the ring is not open
+ * \param record - the record (publishNs is set to the current time)
+ */
+bool ResultPublisher::publish(const PublishedResult &record){
+
+    if (!header){
+        return false;
+    }
+
+    uint64_t n = header->written.load(memory_order_relaxed);
+    SharedResultSlot *slot = slotAt(base, n, header->nSlots);
+
+    // Odd sequence number -> readers discard what they copy from the slot
+    slot->seq.store(2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(&slot->record, &record, sizeof(record));
+    slot->record.publishNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+
+    slot->seq.store(2 * n + 2, memory_order_release);
+    header->written.store(n + 1, memory_order_release);
+    return true;
+}
+
+// Mark the ring closed, unmap and remove it
+void ResultPublisher::close(){
+
+    if (!base){
+        return;
+    }
+    header->closed.store(1, memory_order_release);
+    munmap(base, mappedSize);
+    shm_unlink(name.c_str());
+    base = NULL;
+    header = NULL;
+}
+
+//********************************************************************************************
+//* SUBSCRIBER
+//********************************************************************************************
+
+/********************************************************************************************
+ * OPEN
+ ********************************************************************************************
+ * This function maps a ring, waiting for the publisher to create it
+ * Output -> false if the ring did not appear within the timeout or has the wrong layout
+ * \param name_ - name of the shared memory object (e.g. "/lanes0")
+ * \param timeoutMs - time to wait for the publisher (ms)
+ */
+bool ResultSubscriber::open(const string &name_, int timeoutMs){
+
+    close();
+    name = name_;
+
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    for (;;){
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(SharedResultHeader)){
+            void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mem != MAP_FAILED){
+                const SharedResultHeader *h = static_cast<const SharedResultHeader*>(mem);
+                if (h->magic == SHARED_RESULTS_MAGIC){
+                    atomic_thread_fence(memory_order_acquire);
+                    base = static_cast<const uint8_t*>(mem);
+                    mappedSize = st.st_size;
+                    header = h;
+                } else {
+                    munmap(mem, st.st_size);
+                }
+            }
+        }
+        if (fd >= 0){
+            ::close(fd);
+        }
+        if (header || chrono::steady_clock::now() > deadline){
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    if (!header){
+        return false;
+    }
+
+    if (header->version != SHARED_RESULTS_VERSION || header->recordSize != sizeof(PublishedResult) ||
+        sizeof(SharedResultHeader) + header->nSlots * sizeof(SharedResultSlot) > mappedSize){
+        close();
+        return false;
+    }
+
+    // Start from the oldest record still in the ring
+    uint64_t written = header->written.load(memory_order_acquire);
+    nextRecord = written > header->nSlots ? written - header->nSlots : 0;
+    dropped = 0;
+    return true;
+}
+
+// Unmap the ring
+void ResultSubscriber::close(){
+
+    if (base){
+        munmap(const_cast<uint8_t*>(base), mappedSize);
+    }
+    base = NULL;
+    header = NULL;
+}
+
+/********************************************************************************************
+ * READ
+ ********************************************************************************************
+ * This function copies a record if the writer does not touch it during the copy
+ * Output -> false if record n was overwritten (or is being written)
+ * \param n - number of the record
+ * \param record - the record
+ */
+bool ResultSubscriber::read(uint64_t n, PublishedResult &record) const {
+
+    const SharedResultSlot *slot = slotAt(const_cast<uint8_t*>(base), n, header->nSlots);
+    if (slot->seq.load(memory_order_acquire) != 2 * n + 2){
+        return false;
+    }
+    memcpy(&record, &slot->record, sizeof(record));
+    atomic_thread_fence(memory_order_acquire);
+    return slot->seq.load(memory_order_relaxed) == 2 * n + 2;
+}
+
+/********************************************************************************************
+ * NEXT
+ ********************************************************************************************
+ * This function waits for the next record in order (skipping records that were overwritten)
+ * It spins briefly, then backs off from 5us to 100us between polls
+ * Output -> false if the publisher closed the ring or no record arrived within the timeout
+ * \param record - the record
+ * \param timeoutMs - time to wait for a record (ms)
+ */
+bool ResultSubscriber::next(PublishedResult &record, int timeoutMs){
+
+    if (!header){
+        return false;
+    }
+
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    int polls = 0, sleepUs = MIN_SLEEP_US;
+    for (;;){
+        uint64_t written = header->written.load(memory_order_acquire);
+        if (written > nextRecord){
+
+            // Skip the records the publisher has already overwritten
+            if (written - nextRecord > header->nSlots){
+                dropped += written - header->nSlots - nextRecord;
+                nextRecord = written - header->nSlots;
+            }
+            if (read(nextRecord, record)){
+                nextRecord++;
+                return true;
+            }
+
+            // Overwritten during the copy
+            dropped++;
+            nextRecord++;
+            continue;
+        }
+
+        if (header->closed.load(memory_order_acquire) || chrono::steady_clock::now() > deadline){
+            return false;
+        }
+        if (polls < SPIN_POLLS){
+            polls++;
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(sleepUs));
+            sleepUs = min(2 * sleepUs, MAX_SLEEP_US);
+        }
+    }
+}
+
+/********************************************************************************************
+ * LATEST
+ ********************************************************************************************
+ * This function copies the newest record without waiting (for consumers that only need the current state)
+ * Output -> false if nothing has been published
+ * \param record - the record
+ */
+bool ResultSubscriber::latest(PublishedResult &record) const {
+
+    if (!header){
+        return false;
+    }
+
+    // Retry if the publisher laps the slot during the copy
+    for (;;){
+        uint64_t written = header->written.load(memory_order_acquire);
+        if (written == 0){
+            return false;
+        }
+        if (read(written - 1, record)){
+            return true;
+        }
+    }
+}
+
+// Get the number of records overwritten before next() read them
+long long ResultSubscriber::getDropped() const {
+    return dropped;
+}
@@ -0,0 +1,206 @@
+//
+//  resultPublisher.hpp
+//  cv_autonomous_vehicle
+//
+//  Per-frame results published to other processes through a POSIX shared memory ring
+//
+
+#ifndef resultPublisher_hpp
+#define resultPublisher_hpp
+
+#include "frameResult.hpp"
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+// Vehicles kept per record (the record has a fixed size)
+static const int PUBLISHED_MAX_CARS = 32;
+
+/*
+ * Published Result -> Fixed layout record of one frame (host byte order, 640 bytes)
+ */
+struct PublishedResult {
+    int64_t frameId;                        // id of the frame in its stream
+    double timestamp;                       // position of the frame in the video or its capture time (ms)
+    int64_t publishNs;                      // steady clock when published (CLOCK_MONOTONIC on Linux, ns)
+    uint32_t flags;                         // RESULT_* flags
+    uint32_t nCars;                         // vehicles in cars (at most PUBLISHED_MAX_CARS)
+    float points[8];                        // x1,y1,x2,y2 of the left lane then the right lane (image pixels)
+    float lines[4];                         // rho, theta found for the left then right lane (0,0 -> not found)
+    float state[8];                         // Kalman state (rho, theta, rho rate, theta rate) of the left then right lane
+    int32_t cars[PUBLISHED_MAX_CARS][4];    // x, y, width, height of each vehicle
+    uint8_t reserved[16];
+};
+
+// PublishedResult::flags
+enum {
+    RESULT_LANES = 1,       // points is set
+    RESULT_LEFT_FOUND = 2,  // the left lane was found (otherwise points comes from the prediction)
+    RESULT_RIGHT_FOUND = 4, // the right lane was found
+    RESULT_CARS = 8         // vehicle detection ran on the frame
+};
+
+/*
+ * Shared memory layout (host byte order)
+ *
+ *   0                          SharedResultHeader (64 bytes)
+ *   64 + i * 704               slot i -> uint64 sequence number, 56 bytes padding, PublishedResult
+ *
+ * Record n (counting from 0) is written to slot n % nSlots by a single writer. The slot
+ * sequence number is 2n+1 while the record is written and 2n+2 once it is complete, then
+ * written is set to n+1. A reader copies the record and keeps the copy only if the sequence
+ * number was 2n+2 both before and after the copy (a seqlock), so readers never block the
+ * writer or each other.
+ */
+struct SharedResultHeader {
+    uint32_t magic;                     // SHARED_RESULTS_MAGIC, set last when the ring is ready
+    uint32_t version;                   // SHARED_RESULTS_VERSION
+    uint32_t recordSize;                // sizeof(PublishedResult)
+    uint32_t nSlots;                    // number of slots
+    std::atomic<uint32_t> closed;       // 1 once the writer has stopped
+    uint32_t padding;
+    std::atomic<uint64_t> written;      // number of records published
+    uint8_t reserved[32];
+};
+
+/*
+ * Shared Result Slot -> Sequence number and record, on its own cache lines
+ */
+struct SharedResultSlot {
+    std::atomic<uint64_t> seq;
+    uint8_t padding[56];
+    PublishedResult record;
+};
+
+static const uint32_t SHARED_RESULTS_MAGIC = 0x5352444c; // "LDRS"
+static const uint32_t SHARED_RESULTS_VERSION = 1;
+
+/********************************************************************************************
+ * TO PUBLISHED RESULT
+ ********************************************************************************************
+ * This function fills a fixed layout record from a frame result
+ * Output -> no output
+ * \param res - the frame result
+ * \param vehicles - vehicle detection ran on the frame
+ * \param record - the record (publishNs is set by ResultPublisher::publish)
+ */
+void toPublishedResult(const FrameResult &res, bool vehicles, PublishedResult &record);
+
+/*
+ * Result Publisher -> Creates a result ring and publishes records into it (one writer thread at a time)
+ */
+class ResultPublisher {
+
+    private:
+
+        // Name of the shared memory object and the mapping
+        std::string name;
+        uint8_t *base;
+        size_t mappedSize;
+
+        SharedResultHeader *header;
+
+    public:
+
+        ResultPublisher() : base(NULL), mappedSize(0), header(NULL) {}
+
+        // Marks the ring closed and removes it
+        ~ResultPublisher(){
+            close();
+        }
+
+        /********************************************************************************************
+         * CREATE
+         ********************************************************************************************
+         * This function creates the shared memory ring (replacing a stale one of the same name)
+         * Output -> false if the shared memory could not be created or mapped
+         * \param name_ - name of the shared memory object (e.g. "/lanes0")
+         * \param nSlots - number of records kept
+         */
+        bool create(const std::string &name_, int nSlots = 64);
+
+        /********************************************************************************************
+         * PUBLISH
+         ********************************************************************************************
+         * This function publishes a record (it never waits for the readers)
+         * Output -> false if the ring is not open
+         * \param record - the record (publishNs is set to the current time)
+         */
+        bool publish(const PublishedResult &record);
+
+        // Mark the ring closed, unmap and remove it
+        void close();
+};
+
+/*
+ * Result Subscriber -> Maps a result ring read-only and copies records out of it
+ */
+class ResultSubscriber {
+
+    private:
+
+        // Name of the shared memory object and the mapping
+        std::string name;
+        const uint8_t *base;
+        size_t mappedSize;
+
+        const SharedResultHeader *header;
+
+        // Next record to read
+        uint64_t nextRecord;
+
+        // Records overwritten before they were read
+        long long dropped;
+
+        // Copy record n, false if it was overwritten
+        bool read(uint64_t n, PublishedResult &record) const;
+
+    public:
+
+        ResultSubscriber() : base(NULL), mappedSize(0), header(NULL), nextRecord(0), dropped(0) {}
+
+        // Unmaps the ring
+        ~ResultSubscriber(){
+            close();
+        }
+
+        /********************************************************************************************
+         * OPEN
+         ********************************************************************************************
+         * This function maps a ring, waiting for the publisher to create it
+         * Output -> false if the ring did not appear within the timeout or has the wrong layout
+         * \param name_ - name of the shared memory object (e.g. "/lanes0")
+         * \param timeoutMs - time to wait for the publisher (ms)
+         */
+        bool open(const std::string &name_, int timeoutMs = 5000);
+
+        // Unmap the ring
+        void close();
+
+        /********************************************************************************************
+         * NEXT
+         ********************************************************************************************
+         * This function waits for the next record in order (skipping records that were overwritten)
+         * It spins briefly, then backs off from 5us to 100us between polls, so a record is seen
+         * within ~100us plus the wake up time of the thread
+         * Output -> false if the publisher closed the ring or no record arrived within the timeout
+         * \param record - the record
+         * \param timeoutMs - time to wait for a record (ms)
+         */
+        bool next(PublishedResult &record, int timeoutMs = 1000);
+
+        /********************************************************************************************
+         * LATEST
+         ********************************************************************************************
+         * This function copies the newest record without waiting (for consumers that only need the current state)
+         * Output -> false if nothing has been published
+         * \param record - the record
+         */
+        bool latest(PublishedResult &record) const;
+
+        // Get the number of records overwritten before next() read them
+        long long getDropped() const;
+};
+
+#endif /* resultPublisher_hpp */
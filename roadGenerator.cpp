@@ -0,0 +1,220 @@
+//
+//  roadGenerator.cpp
+//  cv_autonomous_vehicle
+//
+//  Synthetic road video with known lane markers
+//
+
+#include "roadGenerator.hpp"
+
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+// Furthest distance (m) that is drawn and labelled
+static const double MAX_DISTANCE = 60;
+
+/********************************************************************************************
+ * ROAD GENERATOR
+ ********************************************************************************************
+ * This function sets the default scene parameters
+ * Output -> no output
+ * \param size - frame size
+ * \param seed - random seed (the same seed gives the same video)
+ */
+RoadGenerator::RoadGenerator(Size size, int seed_) : frameSize(size), cameraHeight(1.5), laneWidth(3.7), curvature(0), offset(0), markerWidth(0.15), dashed(false), dashLength(3), gapLength(9), speed(0.5), lightingAmp(0), noiseSigma(0), nOccluders(0), seed(seed_) {
+
+    // Same field of view and horizon for every frame size
+    focal = 0.52 * size.width;
+    horizon = cvRound(0.6 * size.height);
+    sampleStep = max(1, size.height * 10 / 720);
+
+    // Sample rows from the bottom of the image up to the furthest labelled distance
+    int topRow = horizon + (int)ceil(focal * cameraHeight / MAX_DISTANCE);
+    for (int v = size.height - 1; v >= topRow; v -= sampleStep){
+        sampleRows.push_back(v);
+    }
+    laneX.assign(2, vector<float>(sampleRows.size(), -2));
+
+    reset();
+}
+
+/********************************************************************************************
+ * RESET
+ ********************************************************************************************
+ * This function restarts the video from the first frame
+ * Output -> no output
+ */
+void RoadGenerator::reset(){
+    frameIdx = 0;
+    rng = RNG(seed);
+    occluders.clear();
+}
+
+// Lateral position (m) of lane marker side (0 left, 1 right) at distance z
+double RoadGenerator::laneLateral(int side, double z) const {
+    return (side == 0 ? -0.5 : 0.5) * laneWidth + 0.5 * curvature * z * z - offset;
+}
+
+/********************************************************************************************
+ * NEXT FRAME
+ ********************************************************************************************
+ * This function renders the next frame and updates the ground truth
+ * Output -> BGR frame
+ */
+Mat RoadGenerator::nextFrame(){
+    Mat frame;
+    nextFrame(frame);
+    return frame;
+}
+
+/********************************************************************************************
+ * RENDER FRAME
+ ********************************************************************************************
+ * This function renders the next frame into a caller owned image
+ * Output -> no output
+ * \param frame - BGR frame (reallocated if the size or type differs)
+ */
+void RoadGenerator::nextFrame(Mat &frame){
+
+    frame.create(frameSize, CV_8UC3);
+
+    // Slowly varying brightness (e.g. passing under trees or bridges)
+    double gain = 1 + lightingAmp * sin(frameIdx * 0.05);
+    double cx = frameSize.width / 2.0;
+    double travelled = frameIdx * speed;
+
+    // Sky and road surface
+    frame(Rect(0, 0, frameSize.width, horizon)).setTo(Scalar(200, 170, 140) * gain);
+    frame(Rect(0, horizon, frameSize.width, frameSize.height - horizon)).setTo(Scalar(90, 90, 90) * gain);
+
+    // Lane markers, one row at a time
+    uchar white = saturate_cast<uchar>(235 * gain);
+    for (int v = horizon + 1; v < frameSize.height; v++){
+        double z = focal * cameraHeight / (v - horizon);
+        if (z > MAX_DISTANCE){
+            continue;
+        }
+
+        // Dashes are fixed to the road so they move towards the camera
+        if (dashed && fmod(z + travelled, dashLength + gapLength) >= dashLength){
+            continue;
+        }
+
+        Vec3b *row = frame.ptr<Vec3b>(v);
+        double w = max(1.0, focal * markerWidth / z);
+        for (int side = 0; side < 2; side++){
+            double u = cx + focal * laneLateral(side, z) / z;
+            int u0 = max(0, cvRound(u - w/2)), u1 = min(frameSize.width - 1, cvRound(u + w/2));
+            for (int i = u0; i <= u1; i++){
+                row[i] = Vec3b(white, white, white);
+            }
+        }
+    }
+
+    // Vehicle-like occluders ahead in the ego or neighbouring lanes
+    while ((int)occluders.size() < nOccluders){
+        occluders.push_back(Point2d(rng.uniform(12.0, 40.0), rng.uniform(-1, 2)));
+    }
+    for (size_t i = 0; i < occluders.size(); i++){
+        double z = occluders[i].x + 4 * sin(frameIdx * 0.03 + i);
+        double x = occluders[i].y * laneWidth + 0.5 * curvature * z * z - offset;
+        int bottom = cvRound(horizon + focal * cameraHeight / z);
+        int width = cvRound(focal * 1.8 / z), height = cvRound(focal * 1.5 / z);
+        int left = cvRound(cx + focal * (x - 0.9) / z);
+        rectangle(frame, Rect(left, bottom - height, width, height), Scalar(40, 35, 35) * gain, -1);
+    }
+
+    // Sensor noise
+    if (noiseSigma > 0){
+        Mat noise(frameSize, CV_16SC3);
+        rng.fill(noise, RNG::NORMAL, Scalar::all(0), Scalar::all(noiseSigma));
+        add(frame, noise, frame, noArray(), CV_8UC3);
+    }
+
+    // Ground truth (lane markers are labelled through dashes and occluders)
+    for (size_t r = 0; r < sampleRows.size(); r++){
+        double z = focal * cameraHeight / (sampleRows[r] - horizon);
+        for (int side = 0; side < 2; side++){
+            double u = cx + focal * laneLateral(side, z) / z;
+            laneX[side][r] = (u >= 0 && u < frameSize.width) ? (float)u : -2;
+        }
+    }
+
+    frameIdx++;
+}
+
+/********************************************************************************************
+ * LATERAL ERROR
+ ********************************************************************************************
+ * This function compares lane marker points from LaneDetectorController with the ground truth
+ * Output -> mean absolute difference in x (pixels) over the visible sampled rows, -1 if none
+ * \param points - x1,y1,x2,y2 of the left line followed by the right line
+ */
+float RoadGenerator::lateralError(const vector<float> &points) const {
+
+    double total = 0;
+    int n = 0;
+    for (int side = 0; side < 2 && (int)points.size() >= 4*(side+1); side++){
+        const float *p = &points[4*side];
+        if (p[3] == p[1]){
+            continue;
+        }
+        for (size_t r = 0; r < sampleRows.size(); r++){
+            if (laneX[side][r] < 0){
+                continue;
+            }
+            double x = p[0] + (sampleRows[r] - p[1]) * (p[2] - p[0]) / (p[3] - p[1]);
+            total += fabs(x - laneX[side][r]);
+            n++;
+        }
+    }
+    return n > 0 ? (float)(total / n) : -1;
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the road curvature (1/m)
+void RoadGenerator::setCurvature(double curvature_){
+    curvature = curvature_;
+}
+
+// Set solid or dashed lane markers
+void RoadGenerator::setDashed(bool dashed_){
+    dashed = dashed_;
+}
+
+// Set the lighting change amplitude and noise standard deviation
+void RoadGenerator::setLighting(double amplitude, double sigma){
+    lightingAmp = amplitude;
+    noiseSigma = sigma;
+}
+
+// Set the number of vehicle-like occluders
+void RoadGenerator::setOccluders(int n){
+    nOccluders = n;
+    occluders.clear();
+}
+
+// Set the distance travelled per frame (m)
+void RoadGenerator::setSpeed(double speed_){
+    speed = speed_;
+}
+
+// Get the frame size
+Size RoadGenerator::getSize() const {
+    return frameSize;
+}
+
+// Get the rows the ground truth is sampled at
+const vector<int>& RoadGenerator::getSampleRows() const {
+    return sampleRows;
+}
+
+// Get the x position of a lane marker at each sampled row
+const vector<float>& RoadGenerator::getLaneX(int side) const {
+    return laneX[side];
+}
@@ -0,0 +1,148 @@
+//
+//  roadGenerator.hpp
+//  cv_autonomous_vehicle
+//
+//  Synthetic road video with known lane markers
+//
+
+#ifndef roadGenerator_hpp
+#define roadGenerator_hpp
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include <vector>
+
+/*
+ * Road Generator -> Renders procedurally parameterised road scenes with known lane markers
+ * A pinhole camera (no pitch) looks along a flat road. The ego lane markers follow
+ * x = +-laneWidth/2 + curvature*z^2/2 and are drawn solid or dashed, with lighting changes,
+ * sensor noise and vehicle-like occluders. The ground truth x position of each lane marker
+ * is available for every sampled row, in the same style as the TuSimple lane annotations.
+ */
+class RoadGenerator {
+
+    private:
+
+        // Output frame size
+        cv::Size frameSize;
+
+        // Camera -> focal length (pixels), height above the road (m), horizon row
+        double focal;
+        double cameraHeight;
+        int horizon;
+
+        // Road -> lane width (m), curvature (1/m), lateral offset of the vehicle in the lane (m)
+        double laneWidth;
+        double curvature;
+        double offset;
+
+        // Lane markers -> width (m), dashed, dash and gap length (m)
+        double markerWidth;
+        bool dashed;
+        double dashLength, gapLength;
+
+        // Distance travelled per frame (m)
+        double speed;
+
+        // Lighting -> amplitude of the brightness change and standard deviation of the noise
+        double lightingAmp;
+        double noiseSigma;
+
+        // Number of vehicle-like occluders
+        int nOccluders;
+
+        // Rows the ground truth is sampled at
+        int sampleStep;
+
+        // Frame counter and random number generator
+        int frameIdx;
+        int seed;
+        cv::RNG rng;
+
+        // Occluders -> distance ahead (m) and lateral position (m)
+        std::vector<cv::Point2d> occluders;
+
+        // Ground truth for the last frame, x position of each lane marker per sampled row (-2 if not visible)
+        std::vector<int> sampleRows;
+        std::vector<std::vector<float> > laneX;
+
+        // Lateral position (m) of lane marker side (0 left, 1 right) at distance z
+        double laneLateral(int side, double z) const;
+
+    public:
+
+        /********************************************************************************************
+         * ROAD GENERATOR
+         ********************************************************************************************
+         * This function sets the default scene parameters
+         * Output -> no output
+         * \param size - frame size
+         * \param seed - random seed (the same seed gives the same video)
+         */
+        RoadGenerator(cv::Size size = cv::Size(1920, 1080), int seed = 0);
+
+        /********************************************************************************************
+         * NEXT FRAME
+         ********************************************************************************************
+         * This function renders the next frame and updates the ground truth
+         * Output -> BGR frame
+         */
+        cv::Mat nextFrame();
+
+        /********************************************************************************************
+         * RENDER FRAME
+         ********************************************************************************************
+         * This function renders the next frame into a caller owned image
+         * Output -> no output
+         * \param frame - BGR frame (reallocated if the size or type differs)
+         */
+        void nextFrame(cv::Mat &frame);
+
+        /********************************************************************************************
+         * LATERAL ERROR
+         ********************************************************************************************
+         * This function compares lane marker points from LaneDetectorController with the ground truth
+         * Output -> mean absolute difference in x (pixels) over the visible sampled rows
+         * \param points - x1,y1,x2,y2 of the left line followed by the right line
+         */
+        float lateralError(const std::vector<float> &points) const;
+
+        /********************************************************************************************
+         * RESET
+         ********************************************************************************************
+         * This function restarts the video from the first frame
+         * Output -> no output
+         */
+        void reset();
+
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+
+        // Set the road curvature (1/m)
+        void setCurvature(double curvature_);
+
+        // Set solid or dashed lane markers
+        void setDashed(bool dashed_);
+
+        // Set the lighting change amplitude and noise standard deviation
+        void setLighting(double amplitude, double sigma);
+
+        // Set the number of vehicle-like occluders
+        void setOccluders(int n);
+
+        // Set the distance travelled per frame (m)
+        void setSpeed(double speed_);
+
+        // Get the frame size
+        cv::Size getSize() const;
+
+        // Get the rows the ground truth is sampled at
+        const std::vector<int>& getSampleRows() const;
+
+        // Get the x position of a lane marker (0 left, 1 right) at each sampled row (-2 if not visible)
+        const std::vector<float>& getLaneX(int side) const;
+};
+
+#endif /* roadGenerator_hpp */
@@ -0,0 +1,294 @@
+//
+//  sharedFrames.cpp
+//  cv_autonomous_vehicle
+//
+//  Raw frames passed from a capture process through a POSIX shared memory ring
+//
+
+#include "sharedFrames.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+// The layout is shared between processes, so it must not depend on the compiler
+static_assert(sizeof(SharedFrameHeader) == 64, "SharedFrameHeader must be 64 bytes");
+static_assert(sizeof(SharedSlotHeader) == 64, "SharedSlotHeader must be 64 bytes");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64 bit atomics must be lock free to be shared between processes");
+
+// Round up to a multiple of 64 bytes
+static size_t align64(size_t n){
+    return (n + 63) & ~(size_t)63;
+}
+
+//********************************************************************************************
+//* WRITER
+//********************************************************************************************
+
+/********************************************************************************************
+ * CREATE
+ ********************************************************************************************
+ * This function creates the shared memory ring (replacing a stale one of the same name)
+ * Output -> false if the shared memory could not be created or mapped
+ * \param name_ - name of the shared memory object (e.g. "/cam0")
+ * \param size - frame size
+ * \param nSlots - number of frames in the ring
+ */
+bool SharedFrameWriter::create(const string &name_, Size size, int nSlots){
+
+    close();
+    name = name_;
+    nSlots = max(nSlots, 2);
+
+    size_t step = (size_t)size.width * 3;
+    size_t slotSize = align64(sizeof(SharedSlotHeader) + step * size.height);
+    size_t dataOffset = align64(sizeof(SharedFrameHeader));
+    mappedSize = dataOffset + slotSize * nSlots;
+
+    // A ring left by a writer that crashed is replaced
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0){
+        return false;
+    }
+    if (ftruncate(fd, mappedSize) != 0){
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *mem = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED){
+        shm_unlink(name.c_str());
+        return false;
+    }
+    base = static_cast<uint8_t*>(mem);
+
+    // The new object is zero filled, construct the atomics in place
+    header = new (base) SharedFrameHeader();
+    header->version = SHARED_FRAMES_VERSION;
+    header->width = size.width;
+    header->height = size.height;
+    header->type = CV_8UC3;
+    header->step = (uint32_t)step;
+    header->nSlots = nSlots;
+    header->closed.store(0);
+    header->slotSize = slotSize;
+    header->dataOffset = dataOffset;
+    header->written.store(0);
+    for (int i = 0; i < nSlots; i++){
+        new (base + dataOffset + i * slotSize) SharedSlotHeader();
+    }
+
+    // Readers wait for the magic number, so it is published last
+    atomic_thread_fence(memory_order_release);
+    header->magic = SHARED_FRAMES_MAGIC;
+    return true;
+}
+
+/********************************************************************************************
+ * WRITE
+ ********************************************************************************************
+ * This function publishes a frame
+ * Output -> false if the ring is not open or the frame is not an 8 bit BGR image of the ring's size
+ * \param frame - the frame
+ * \param frameIndex - frame number
+ * \param timestamp - capture time (ms)
+ */
+bool SharedFrameWriter::write(const Mat &frame, uint64_t frameIndex, double timestamp){
+
+    if (!header || frame.type() != CV_8UC3 || frame.cols != (int)header->width || frame.rows != (int)header->height){
+        return false;
+    }
+
+    uint64_t n = header->written.load(memory_order_relaxed);
+    uint8_t *slotBase = base + header->dataOffset + (n % header->nSlots) * header->slotSize;
+    SharedSlotHeader *slot = reinterpret_cast<SharedSlotHeader*>(slotBase);
+
+    // Odd sequence number -> readers know the slot is being overwritten
+    slot->seq.store(2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->frameIndex = frameIndex;
+    slot->timestamp = timestamp;
+    uint8_t *image = slotBase + sizeof(SharedSlotHeader);
+    for (int y = 0; y < frame.rows; y++){
+        memcpy(image + y * header->step, frame.ptr(y), header->step);
+    }
+
+    slot->seq.store(2 * n + 2, memory_order_release);
+    header->written.store(n + 1, memory_order_release);
+    return true;
+}
+
+// Mark the ring closed, unmap and remove it
+void SharedFrameWriter::close(){
+
+    if (!base){
+        return;
+    }
+    header->closed.store(1, memory_order_release);
+    munmap(base, mappedSize);
+    shm_unlink(name.c_str());
+    base = NULL;
+    header = NULL;
+}
+
+//********************************************************************************************
+//* READER
+//********************************************************************************************
+
+/********************************************************************************************
+ * OPEN
+ ********************************************************************************************
+ * This function maps a ring, waiting for the writer to create it
+ * Output -> false if the ring did not appear within the timeout or has the wrong layout
+ * \param name_ - name of the shared memory object (e.g. "/cam0")
+ * \param timeoutMs - time to wait for the writer (ms)
+ */
+bool SharedFrameReader::open(const string &name_, int timeoutMs){
+
+    close();
+    name = name_;
+
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    for (;;){
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(SharedFrameHeader)){
+            void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mem != MAP_FAILED){
+                const SharedFrameHeader *h = static_cast<const SharedFrameHeader*>(mem);
+                if (h->magic == SHARED_FRAMES_MAGIC){
+                    atomic_thread_fence(memory_order_acquire);
+                    base = static_cast<const uint8_t*>(mem);
+                    mappedSize = st.st_size;
+                    header = h;
+                } else {
+                    munmap(mem, st.st_size);
+                }
+            }
+        }
+        if (fd >= 0){
+            ::close(fd);
+        }
+        if (header || chrono::steady_clock::now() > deadline){
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    if (!header){
+        return false;
+    }
+
+    if (header->version != SHARED_FRAMES_VERSION || header->type != CV_8UC3 ||
+        header->dataOffset + header->slotSize * header->nSlots > mappedSize){
+        close();
+        return false;
+    }
+
+    // Start from the newest frame, older ones are stale for a live camera
+    uint64_t written = header->written.load(memory_order_acquire);
+    nextFrame = written > 0 ? written - 1 : 0;
+    slot = NULL;
+    dropped = 0;
+    return true;
+}
+
+// Unmap the ring
+void SharedFrameReader::close(){
+
+    if (base){
+        munmap(const_cast<uint8_t*>(base), mappedSize);
+    }
+    base = NULL;
+    header = NULL;
+    slot = NULL;
+}
+
+/********************************************************************************************
+ * NEXT
+ ********************************************************************************************
+ * This function waits for the next frame and wraps it without copying
+ * Output -> false if the writer closed the ring or no frame arrived within the timeout
+ * \param frame - header pointing at the image in shared memory
+ * \param frameIndex - frame number given by the writer
+ * \param timestamp - capture time (ms)
+ * \param timeoutMs - time to wait for a frame (ms, 0 -> return straight away if there is none)
+ */
+bool SharedFrameReader::next(Mat &frame, uint64_t &frameIndex, double &timestamp, int timeoutMs){
+
+    if (!header){
+        return false;
+    }
+
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    for (;;){
+        uint64_t written = header->written.load(memory_order_acquire);
+        if (written > nextFrame){
+
+            // Skip the frames the writer has already overwritten (or is about to)
+            if (written - nextFrame > header->nSlots - 1){
+                dropped += written - 1 - nextFrame;
+                nextFrame = written - 1;
+            }
+
+            const uint8_t *slotBase = base + header->dataOffset + (nextFrame % header->nSlots) * header->slotSize;
+            const SharedSlotHeader *s = reinterpret_cast<const SharedSlotHeader*>(slotBase);
+            uint64_t seq = s->seq.load(memory_order_acquire);
+            if (seq == 2 * nextFrame + 2){
+                frameIndex = s->frameIndex;
+                timestamp = s->timestamp;
+                frame = Mat(header->height, header->width, header->type, const_cast<uint8_t*>(slotBase + sizeof(SharedSlotHeader)), header->step);
+                slot = s;
+                slotSeq = seq;
+                nextFrame++;
+                return true;
+            }
+
+            // Overwritten between the two loads, try the newest frame
+            dropped++;
+            nextFrame++;
+            continue;
+        }
+
+        if (header->closed.load(memory_order_acquire) || timeoutMs <= 0 || chrono::steady_clock::now() > deadline){
+            return false;
+        }
+        this_thread::sleep_for(chrono::microseconds(200));
+    }
+}
+
+// True if the writer has not started overwriting the last frame returned by next()
+bool SharedFrameReader::intact() const {
+
+    if (!slot){
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return slot->seq.load(memory_order_relaxed) == slotSeq;
+}
+
+// True if next() would return without waiting
+bool SharedFrameReader::ready() const {
+    return header && (header->written.load(memory_order_acquire) > nextFrame || isClosed());
+}
+
+// True once the writer has closed the ring
+bool SharedFrameReader::isClosed() const {
+    return header && header->closed.load(memory_order_acquire);
+}
+
+// Get the number of frames overwritten before they were read
+long long SharedFrameReader::getDropped() const {
+    return dropped;
+}
@@ -0,0 +1,180 @@
+//
+//  sharedFrames.hpp
+//  cv_autonomous_vehicle
+//
+//  Raw frames passed from a capture process through a POSIX shared memory ring
+//
+
+#ifndef sharedFrames_hpp
+#define sharedFrames_hpp
+
+#include "opencv2/core.hpp"
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+/*
+ * Shared memory layout (host byte order, every offset a multiple of 64 bytes)
+ *
+ *   0                          SharedFrameHeader (64 bytes)
+ *   dataOffset + i * slotSize  slot i -> SharedSlotHeader (64 bytes) followed by the image
+ *                              (height rows of step bytes), for i = 0 .. nSlots - 1
+ *
+ * Frame n (counting from 0) is written to slot n % nSlots. The writer sets the slot sequence
+ * number to 2n+1, copies the image, sets it to 2n+2 and then sets written to n+1. A reader
+ * takes frame n only while the slot sequence number is 2n+2, and the frame was not overwritten
+ * while it was in use if the sequence number is still 2n+2 afterwards. The writer never waits
+ * for the readers (a camera cannot be paused), so a reader that falls more than nSlots - 1
+ * frames behind skips to the newest frame.
+ */
+struct SharedFrameHeader {
+    uint32_t magic;                     // SHARED_FRAMES_MAGIC, set last when the ring is ready
+    uint32_t version;                   // SHARED_FRAMES_VERSION
+    uint32_t width;                     // image width (pixels)
+    uint32_t height;                    // image height (pixels)
+    uint32_t type;                      // OpenCV type of the image (CV_8UC3 -> BGR)
+    uint32_t step;                      // bytes per image row
+    uint32_t nSlots;                    // number of slots
+    std::atomic<uint32_t> closed;       // 1 once the writer has stopped
+    uint64_t slotSize;                  // bytes from one slot to the next
+    uint64_t dataOffset;                // offset of slot 0 from the start of the mapping
+    std::atomic<uint64_t> written;      // number of frames published
+    uint8_t reserved[8];
+};
+
+/*
+ * Shared Slot Header -> The 64 bytes in front of each image
+ */
+struct SharedSlotHeader {
+    std::atomic<uint64_t> seq;          // 2n+1 while frame n is written, 2n+2 once it is complete
+    uint64_t frameIndex;                // frame number given by the writer
+    double timestamp;                   // capture time (ms)
+    uint8_t reserved[40];
+};
+
+static const uint32_t SHARED_FRAMES_MAGIC = 0x5246444c; // "LDFR"
+static const uint32_t SHARED_FRAMES_VERSION = 1;
+
+/*
+ * Shared Frame Writer -> Creates the ring and publishes frames into it (the capture process)
+ */
+class SharedFrameWriter {
+
+    private:
+
+        // Name of the shared memory object and the mapping
+        std::string name;
+        uint8_t *base;
+        size_t mappedSize;
+
+        SharedFrameHeader *header;
+
+    public:
+
+        SharedFrameWriter() : base(NULL), mappedSize(0), header(NULL) {}
+
+        // Marks the ring closed and removes it
+        ~SharedFrameWriter(){
+            close();
+        }
+
+        /********************************************************************************************
+         * CREATE
+         ********************************************************************************************
+         * This function creates the shared memory ring (replacing a stale one of the same name)
+         * Output -> false if the shared memory could not be created or mapped
+         * \param name_ - name of the shared memory object (e.g. "/cam0")
+         * \param size - frame size
+         * \param nSlots - number of frames in the ring
+         */
+        bool create(const std::string &name_, cv::Size size, int nSlots = 8);
+
+        /********************************************************************************************
+         * WRITE
+         ********************************************************************************************
+         * This function publishes a frame
+         * Output -> false if the ring is not open or the frame is not an 8 bit BGR image of the ring's size
+         * \param frame - the frame
+         * \param frameIndex - frame number
+         * \param timestamp - capture time (ms)
+         */
+        bool write(const cv::Mat &frame, uint64_t frameIndex, double timestamp);
+
+        // Mark the ring closed, unmap and remove it
+        void close();
+};
+
+/*
+ * Shared Frame Reader -> Maps a ring read-only and wraps its slots as cv::Mat without copying
+ * The cv::Mat returned by next() points into the shared memory. It stays valid until the
+ * writer laps the ring, which intact() checks, so the ring should have enough slots to
+ * cover the time a frame is processed.
+ */
+class SharedFrameReader {
+
+    private:
+
+        // Name of the shared memory object and the mapping
+        std::string name;
+        const uint8_t *base;
+        size_t mappedSize;
+
+        const SharedFrameHeader *header;
+
+        // Next frame to read, the last frame read and its sequence number
+        uint64_t nextFrame;
+        const SharedSlotHeader *slot;
+        uint64_t slotSeq;
+
+        // Frames overwritten before they were read
+        long long dropped;
+
+    public:
+
+        SharedFrameReader() : base(NULL), mappedSize(0), header(NULL), nextFrame(0), slot(NULL), slotSeq(0), dropped(0) {}
+
+        // Unmaps the ring
+        ~SharedFrameReader(){
+            close();
+        }
+
+        /********************************************************************************************
+         * OPEN
+         ********************************************************************************************
+         * This function maps a ring, waiting for the writer to create it
+         * Output -> false if the ring did not appear within the timeout or has the wrong layout
+         * \param name_ - name of the shared memory object (e.g. "/cam0")
+         * \param timeoutMs - time to wait for the writer (ms)
+         */
+        bool open(const std::string &name_, int timeoutMs = 5000);
+
+        // Unmap the ring
+        void close();
+
+        /********************************************************************************************
+         * NEXT
+         ********************************************************************************************
+         * This function waits for the next frame and wraps it without copying
+         * Output -> false if the writer closed the ring or no frame arrived within the timeout
+         * \param frame - header pointing at the image in shared memory
+         * \param frameIndex - frame number given by the writer
+         * \param timestamp - capture time (ms)
+         * \param timeoutMs - time to wait for a frame (ms, 0 -> return straight away if there is none)
+         */
+        bool next(cv::Mat &frame, uint64_t &frameIndex, double &timestamp, int timeoutMs = 1000);
+
+        // True if the writer has not started overwriting the last frame returned by next()
+        bool intact() const;
+
+        // True if next() would return without waiting (a frame is waiting or the ring is closed)
+        bool ready() const;
+
+        // True once the writer has closed the ring
+        bool isClosed() const;
+
+        // Get the number of frames overwritten before they were read
+        long long getDropped() const;
+};
+
+#endif /* sharedFrames_hpp */
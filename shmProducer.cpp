@@ -0,0 +1,124 @@
+//
+//  shmProducer.cpp
+//  cv_autonomous_vehicle
+//
+//  Stands in for a capture process, writing frames to a shared memory ring
+//
+
+#include <opencv2/core.hpp>
+#include "opencv2/videoio.hpp"
+
+#include "sharedFrames.hpp"
+#include "roadGenerator.hpp"
+
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+// Set by Ctrl-C so the ring is closed and removed
+static atomic<bool> stopRequested(false);
+
+static void onSignal(int){
+    stopRequested = true;
+}
+
+int main(int argc, char **argv) {
+
+    string name = argc > 1 ? argv[1] : "";
+
+    // Options
+    string source = "synthetic:0";
+    int nSlots = 8;
+    double fps = 30;
+    long nFrames = 0;
+    bool loop = false;
+    for (int i = 2; i < argc; i++){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--slots" && hasValue){
+            nSlots = atoi(argv[++i]);
+        } else if (arg == "--fps" && hasValue){
+            fps = atof(argv[++i]);
+        } else if (arg == "--frames" && hasValue){
+            nFrames = atol(argv[++i]);
+        } else if (arg == "--loop"){
+            loop = true;
+        } else {
+            source = arg;
+        }
+    }
+    if (name.empty()){
+        cout << "Usage: " << argv[0] << " <name e.g. /cam0> [video file | synthetic:<seed>] [--slots 8] [--fps 30] [--frames n] [--loop]" << endl;
+        return -1;
+    }
+
+    // Open the source
+    bool synthetic = source.compare(0, 10, "synthetic:") == 0;
+    RoadGenerator road(Size(1920, 1080), synthetic ? atoi(source.c_str() + 10) : 0);
+    road.setDashed(true);
+    road.setCurvature(2e-4);
+    road.setLighting(0.2, 8);
+    road.setOccluders(2);
+    VideoCapture cap;
+    Size size = road.getSize();
+    if (!synthetic){
+        if (!cap.open(source)){
+            cout << "Error opening " << source << endl;
+            return -1;
+        }
+        size = Size((int)cap.get(CV_CAP_PROP_FRAME_WIDTH), (int)cap.get(CV_CAP_PROP_FRAME_HEIGHT));
+    }
+
+    SharedFrameWriter writer;
+    if (!writer.create(name, size, nSlots)){
+        cout << "Error creating shared memory " << name << endl;
+        return -1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    cout << "Writing " << size.width << "x" << size.height << " frames to " << name << " (" << nSlots << " slots) at " << fps << " fps" << endl;
+
+    // Publish frames at the camera rate
+    Mat frame;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point due = start;
+    long n = 0;
+    while (!stopRequested && (nFrames <= 0 || n < nFrames)){
+        if (synthetic){
+            road.nextFrame(frame);
+        } else {
+            cap >> frame;
+            if (frame.empty() && loop){
+                cap.set(CV_CAP_PROP_POS_FRAMES, 0);
+                cap >> frame;
+            }
+            if (frame.empty()){
+                break;
+            }
+        }
+
+        double timestamp = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!writer.write(frame, n, timestamp)){
+            cout << "Frame " << n << " is not an 8 bit BGR image of the ring size" << endl;
+            break;
+        }
+        n++;
+
+        if (fps > 0){
+            due += chrono::microseconds((long long)(1e6 / fps));
+            this_thread::sleep_until(due);
+        }
+    }
+
+    writer.close();
+    cout << "Wrote " << n << " frames" << endl;
+    return 0;
+}
@@ -0,0 +1,385 @@
+//
+//  streamEngine.cpp
+//  cv_autonomous_vehicle
+//
+//  Independent lane and vehicle pipelines for several cameras on a shared thread pool
+//
+
+#include "streamEngine.hpp"
+
+#include "laneTracker.hpp"
+#include "tracer.hpp"
+
+#include <cstdlib>
+
+using namespace cv;
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+/********************************************************************************************
+ * STREAM ENGINE
+ ********************************************************************************************
+ * This function starts the thread pool
+ * Output -> no output
+ * \param nThreads - number of workers (0 -> one per core)
+ * \param pinThreads - pin each worker to a core
+ */
+StreamEngine::StreamEngine(int nThreads, bool pinThreads) : pool(nThreads, pinThreads), maxFrames(0), nFinished(0), nParked(0) {}
+
+/********************************************************************************************
+ * ADD STREAM
+ ********************************************************************************************
+ * This function opens an input and sets up its pipelines
+ * Output -> index of the stream, -1 if the input or cascade could not be opened
+ * \param source - video file path and name, camera index, "synthetic:<seed>" or "shm:<name>"
+ * \param config - parameters and IPM points of the camera
+ * \param car_cascade_name - haar cascade (empty for lane detection only), config.cascadeName takes precedence
+ */
+int StreamEngine::addStream(const string &source, const Config &config, const string &car_cascade_name){
+
+    unique_ptr<Stream> s(new Stream());
+    s->index = (int)streams.size();
+    s->name = source;
+
+    // Open the input
+    if (source.compare(0, 10, "synthetic:") == 0){
+        s->synthetic = true;
+        s->road = RoadGenerator(Size(1920, 1080), atoi(source.c_str() + 10));
+        s->road.setDashed(true);
+        s->road.setCurvature(2e-4);
+        s->road.setLighting(0.2, 8);
+        s->road.setOccluders(2);
+    } else if (source.compare(0, 4, "shm:") == 0){
+        s->shared = true;
+        if (!s->shm.open(source.substr(4))){
+            return -1;
+        }
+    } else {
+        bool camera = !source.empty() && source.find_first_not_of("0123456789") == string::npos;
+        if (camera ? !s->cap.open(atoi(source.c_str())) : !s->cap.open(source)){
+            return -1;
+        }
+    }
+
+    // Each stream tracks its own lanes
+    LaneTracker lTracker, rTracker;
+    lTracker.initKalman(0, 0);
+    rTracker.initKalman(0, 0);
+    s->lController.initKalman(lTracker, rTracker);
+    s->lController.applyConfig(config);
+    s->orgPts = config.orgPts;
+
+    string cascade = config.cascadeName.empty() ? car_cascade_name : config.cascadeName;
+    if (!cascade.empty()){
+        if (!s->vController.setCascade(cascade)){
+            return -1;
+        }
+        s->vController.applyConfig(config);
+        s->vehicles = true;
+    }
+
+    streams.push_back(std::move(s));
+    return (int)streams.size() - 1;
+}
+
+/********************************************************************************************
+ * STEP
+ ********************************************************************************************
+ * This function processes the next frame of a stream and queues the one after it
+ * Output -> no output
+ * \param s - the stream
+ */
+void StreamEngine::step(Stream *s){
+
+    long frameId = s->frames.load();
+    Mat frame;
+    double timestamp = 0;
+    if (maxFrames > 0 && frameId >= maxFrames){
+        finish(s);
+        return;
+    }
+
+    // Never wait for the encoder on a worker either: with back-pressure the stream is parked while the
+    // output queue is full, so only its own frames slow down (only this step writes to the sink)
+    if (s->sink && s->sink->wouldBlock()){
+        park(s);
+        return;
+    }
+    if (s->synthetic){
+        s->road.nextFrame(frame);
+        timestamp = frameId * 1000.0 / 30;
+    } else if (s->shared){
+        // Never wait on a worker: with no frame published yet the stream is parked and run() resumes it
+        uint64_t index;
+        Mat slot;
+        if (!s->shm.next(slot, index, timestamp, 0)){
+            if (s->shm.isClosed()){
+                finish(s);
+            } else {
+                park(s);
+            }
+            return;
+        }
+
+        // The slot goes straight into the detectors, which make their own buffers (gray, IPM) from it.
+        // If the capture process overwrites it meanwhile the frame is dropped below
+        frame = slot;
+    } else {
+        s->cap >> frame;
+        timestamp = s->cap.get(CV_CAP_PROP_POS_MSEC);
+    }
+    if (frame.empty()){
+        finish(s);
+        return;
+    }
+
+    {
+        TRACE_SCOPE("stream frame", frameId);
+        Clock::time_point t0 = Clock::now();
+
+        // A torn shared memory frame is only known once it has been read, so the trackers can be rolled back
+        if (s->shared){
+            s->lController.saveState();
+            s->vController.saveState();
+        }
+        s->lController.setVideoFrame(frame);
+        s->lController.initIPM(s->orgPts);
+        s->lController.process();
+        if (s->vehicles){
+            s->vController.setVideoFrame(frame);
+            s->vController.process();
+        }
+
+        s->busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    }
+
+    // The overlay is only drawn for streams that record it. Video and synthetic frames belong to the
+    // engine and are not used after drawing, so it goes straight into them. Shared memory frames
+    // belong to the capture process, the overlay is drawn into a copy (which is the last read of the slot)
+    if (s->sink){
+        TRACE_SCOPE("stream draw", frameId);
+        vector<Rect> cars = s->vehicles ? s->vController.getCars() : vector<Rect>();
+        if (s->shared){
+            s->overlay.drawResult(frame, s->lController.getPoints(), cars);
+        } else {
+            s->overlay.drawResultInPlace(frame, s->lController.getPoints(), cars);
+        }
+    }
+
+    // The capture process does not wait, so frames may have been skipped. If it started overwriting
+    // the slot while the frame was read, the frame is dropped: its results are discarded, the trackers
+    // go back to the previous frame and the next frame is read
+    if (s->shared){
+        if (!s->shm.intact()){
+            s->torn++;
+            s->lController.restoreState();
+            s->vController.restoreState();
+            s->dropped = (long)s->shm.getDropped() + s->torn;
+            pool.submit([this, s](){ step(s); });
+            return;
+        }
+        s->dropped = (long)s->shm.getDropped() + s->torn;
+    }
+
+    if (onResult){
+        FrameResult res;
+        res.frameId = frameId;
+        res.timestamp = timestamp;
+        res.points = s->lController.getPoints();
+        res.lines = s->lController.getLines();
+        res.predicted = s->lController.getPredicted();
+        res.state = s->lController.getTrackerState();
+        if (s->vehicles){
+            res.cars = s->vController.getCars();
+        }
+        onResult(s->index, res);
+    }
+
+    if (s->sink){
+        s->sink->write(s->overlay.getLastResult());
+    }
+    s->frames++;
+
+    // Queue the next frame behind the other streams
+    pool.submit([this, s](){ step(s); });
+}
+
+/********************************************************************************************
+ * RESUME PARKED
+ ********************************************************************************************
+ * This function queues the next frame of the parked streams whose capture process has published
+ * one (or closed the ring) and whose output has room for a frame
+ * Output -> no output
+ */
+void StreamEngine::resumeParked(){
+
+    for (size_t i = 0; i < streams.size(); i++){
+        Stream *s = streams[i].get();
+        if (!s->parked.load() || (s->shared && !s->shm.ready()) || (s->sink && s->sink->wouldBlock())){
+            continue;
+        }
+        {
+            lock_guard<std::mutex> lock(mutex);
+            s->parked = false;
+            nParked--;
+        }
+        pool.submit([this, s](){ step(s); });
+    }
+}
+
+// Leave a stream out of the pool until run() resumes it
+void StreamEngine::park(Stream *s){
+
+    lock_guard<std::mutex> lock(mutex);
+    s->parked = true;
+    nParked++;
+    done.notify_all();
+}
+
+// Mark a stream as finished
+void StreamEngine::finish(Stream *s){
+
+    s->wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    s->finished = true;
+
+    lock_guard<std::mutex> lock(mutex);
+    nFinished++;
+    done.notify_all();
+}
+
+/********************************************************************************************
+ * RUN
+ ********************************************************************************************
+ * This function processes every stream until they end and reports the throughput periodically
+ * Output -> no output
+ * \param maxFrames_ - frames per stream (0 -> until the input ends)
+ * \param reportInterval - time between reports (s)
+ * \param os - output stream for the reports (NULL for none)
+ */
+void StreamEngine::run(long maxFrames_, double reportInterval, ostream *os){
+
+    maxFrames = maxFrames_;
+    nFinished = 0;
+    nParked = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < streams.size(); i++){
+        Stream *s = streams[i].get();
+        s->frames = 0;
+        s->busyNs = 0;
+        s->finished = false;
+        pool.submit([this, s](){ step(s); });
+    }
+
+    // Parked streams are polled every millisecond until their capture process publishes a frame or their encoder catches up
+    Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(reportInterval));
+    Clock::time_point nextReport = start + interval;
+    unique_lock<std::mutex> lock(mutex);
+    while (nFinished < streams.size()){
+        Clock::time_point wake = nParked > 0 ? min(nextReport, Clock::now() + std::chrono::milliseconds(1)) : nextReport;
+        done.wait_until(lock, wake);
+        bool running = nFinished < streams.size();
+        lock.unlock();
+        resumeParked();
+        if (Clock::now() >= nextReport){
+            nextReport += interval;
+            if (os && running){
+                report(*os);
+            }
+        }
+        lock.lock();
+    }
+    lock.unlock();
+    pool.waitIdle();
+
+    // Encode the frames still queued
+    for (size_t i = 0; i < streams.size(); i++){
+        if (streams[i]->sink){
+            streams[i]->sink->close();
+        }
+    }
+
+    if (os){
+        report(*os);
+    }
+}
+
+/********************************************************************************************
+ * SET OUTPUT
+ ********************************************************************************************
+ * This function encodes the annotated frames of a stream to a video on a background thread
+ * Output -> false if the stream does not exist or the video could not be created
+ * \param stream - index of the stream
+ * \param fileName - output video file path and name
+ * \param maxQueue - most frames waiting for the encoder
+ * \param dropWhenFull - drop frames (true) or slow the stream down (false) when the encoder falls behind
+ */
+bool StreamEngine::setOutput(int stream, const string &fileName, size_t maxQueue, bool dropWhenFull){
+
+    if (stream < 0 || stream >= (int)streams.size()){
+        return false;
+    }
+    Stream &s = *streams[stream];
+    double fps = (s.synthetic || s.shared) ? 30 : s.cap.get(CV_CAP_PROP_FPS);
+
+    // The size is taken from the first frame (the inputs do not all report it)
+    unique_ptr<VideoSink> sink(new VideoSink(maxQueue, dropWhenFull));
+    if (!sink->open(fileName, fps, Size(), VideoWriter::fourcc('M','J','P','G'))){
+        return false;
+    }
+    s.sink = std::move(sink);
+    return true;
+}
+
+// Set the callback called with the result of every frame
+void StreamEngine::setResultCallback(const ResultCallback &callback){
+    onResult = callback;
+}
+
+/********************************************************************************************
+ * GET STATS
+ ********************************************************************************************
+ * This function calculates the throughput of each stream so far
+ * Output -> the statistics of each stream
+ */
+vector<StreamStats> StreamEngine::getStats() const {
+
+    long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    vector<StreamStats> stats(streams.size());
+    for (size_t i = 0; i < streams.size(); i++){
+        const Stream &s = *streams[i];
+        StreamStats &st = stats[i];
+        st.name = s.name;
+        st.frames = s.frames.load();
+        st.finished = s.finished.load();
+        long long wall = st.finished ? s.wallNs.load() : now;
+        st.fps = wall > 0 ? st.frames * 1e9 / wall : 0;
+        st.meanMs = st.frames > 0 ? s.busyNs.load() / 1e6 / st.frames : 0;
+        st.dropped = s.dropped.load();
+    }
+    return stats;
+}
+
+/********************************************************************************************
+ * REPORT
+ ********************************************************************************************
+ * This function prints the per-stream and aggregate frames per second
+ * Output -> no output
+ * \param os - the output stream
+ */
+void StreamEngine::report(ostream &os) const {
+
+    vector<StreamStats> stats = getStats();
+    long total = 0;
+    for (size_t i = 0; i < stats.size(); i++){
+        os << "stream " << i << " (" << stats[i].name << "): " << stats[i].frames << " frames, " << stats[i].fps << " fps, "
+           << stats[i].meanMs << " ms per frame";
+        if (stats[i].dropped > 0){
+            os << ", " << stats[i].dropped << " dropped";
+        }
+        os << (stats[i].finished ? " (finished)" : "") << endl;
+        total += stats[i].frames;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    os << "aggregate: " << total << " frames, " << (seconds > 0 ? total / seconds : 0) << " fps on " << pool.size() << " threads" << endl;
+}
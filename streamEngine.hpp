@@ -0,0 +1,180 @@
+//
+//  streamEngine.hpp
+//  cv_autonomous_vehicle
+//
+//  Independent lane and vehicle pipelines for several cameras on a shared thread pool
+//
+
+#ifndef streamEngine_hpp
+#define streamEngine_hpp
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+#include "laneDetectorController.hpp"
+#include "vehicleDetectorController.hpp"
+
+#include "controller.hpp"
+#include "config.hpp"
+#include "frameResult.hpp"
+#include "roadGenerator.hpp"
+#include "sharedFrames.hpp"
+#include "threadPool.hpp"
+#include "videoSink.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Stream Statistics -> Throughput of one stream
+ */
+struct StreamStats {
+    std::string name;
+    long frames;
+    double fps;         // frames per second of wall clock time
+    double meanMs;      // mean processing time per frame (excluding decoding)
+    long dropped;       // shared memory frames overwritten before or while they were processed
+    bool finished;
+};
+
+/*
+ * Stream Engine -> Runs N independent lane/vehicle pipelines on a shared thread pool
+ * Each stream has its own controllers (so its own LaneTracker state), IPM points and
+ * parameters. A stream has at most one frame in flight: when a frame is done the stream
+ * queues its next frame behind the other streams, which keeps its frames in order and
+ * shares the workers fairly between the streams.
+ */
+class StreamEngine {
+
+    public:
+
+        // Called from a worker thread with the result of every frame
+        typedef std::function<void(int stream, const FrameResult &result)> ResultCallback;
+
+    private:
+
+        /*
+         * Stream -> Input and pipeline state of one camera
+         */
+        struct Stream {
+            int index;
+            std::string name;
+
+            // Input -> a video (or camera), a generated road ("synthetic:<seed>") or a capture
+            // process writing to shared memory ("shm:<name>")
+            cv::VideoCapture cap;
+            bool synthetic;
+            RoadGenerator road;
+            bool shared;
+            SharedFrameReader shm;
+            long torn; // shared memory frames overwritten while they were read
+            std::atomic<bool> parked; // waiting for the capture process or the encoder, resumed by run()
+
+            // Pipelines
+            LaneDetectorController lController;
+            VehicleDetectorController vController;
+            bool vehicles;
+            std::vector<cv::Point2f> orgPts;
+
+            // Annotated video output (NULL -> the overlay is not drawn)
+            std::unique_ptr<VideoSink> sink;
+            Controller overlay;
+
+            // Statistics (written by the worker running the stream, read by report)
+            std::atomic<long> frames;
+            std::atomic<long long> busyNs;
+            std::atomic<long long> wallNs; // wall clock time from the start until the stream finished
+            std::atomic<bool> finished;
+            std::atomic<long> dropped; // shared memory frames skipped or torn
+
+            Stream() : synthetic(false), shared(false), torn(0), parked(false), vehicles(false), frames(0), busyNs(0), wallNs(0), finished(false), dropped(0) {}
+        };
+
+        std::vector<std::unique_ptr<Stream> > streams;
+        ThreadPool pool;
+        ResultCallback onResult;
+
+        // Run state
+        long maxFrames;
+        std::chrono::steady_clock::time_point start;
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t nFinished;
+        size_t nParked; // streams waiting for their capture process or encoder
+
+        // Process the next frame of a stream and queue the one after it
+        void step(Stream *s);
+
+        // Leave a stream out of the pool until run() resumes it
+        void park(Stream *s);
+
+        // Mark a stream as finished
+        void finish(Stream *s);
+
+        // Queue the next frame of the parked streams whose capture process has published one and whose output has room
+        void resumeParked();
+
+    public:
+
+        /********************************************************************************************
+         * STREAM ENGINE
+         ********************************************************************************************
+         * This function starts the thread pool
+         * Output -> no output
+         * \param nThreads - number of workers (0 -> one per core)
+         * \param pinThreads - pin each worker to a core
+         */
+        StreamEngine(int nThreads = 0, bool pinThreads = false);
+
+        /********************************************************************************************
+         * ADD STREAM
+         ********************************************************************************************
+         * This function opens an input and sets up its pipelines
+         * Output -> index of the stream, -1 if the input or cascade could not be opened
+         * \param source - video file path and name, camera index, "synthetic:<seed>" or "shm:<name>"
+         * \param config - parameters and IPM points of the camera
+         * \param car_cascade_name - haar cascade (empty for lane detection only), config.cascadeName takes precedence
+         */
+        int addStream(const std::string &source, const Config &config = Config(), const std::string &car_cascade_name = "");
+
+        /********************************************************************************************
+         * RUN
+         ********************************************************************************************
+         * This function processes every stream until they end and reports the throughput periodically
+         * Output -> no output
+         * \param maxFrames_ - frames per stream (0 -> until the input ends)
+         * \param reportInterval - time between reports (s)
+         * \param os - output stream for the reports (NULL for none)
+         */
+        void run(long maxFrames_ = 0, double reportInterval = 1.0, std::ostream *os = &std::cout);
+
+        /********************************************************************************************
+         * SET OUTPUT
+         ********************************************************************************************
+         * This function encodes the annotated frames of a stream to a video on a background thread
+         * Output -> false if the stream does not exist or the video could not be created
+         * \param stream - index of the stream
+         * \param fileName - output video file path and name
+         * \param maxQueue - most frames waiting for the encoder
+         * \param dropWhenFull - drop frames (true) or slow the stream down (false) when the encoder falls behind
+         */
+        bool setOutput(int stream, const std::string &fileName, size_t maxQueue = 8, bool dropWhenFull = true);
+
+        // Set the callback called with the result of every frame
+        void setResultCallback(const ResultCallback &callback);
+
+        // Get the throughput of each stream
+        std::vector<StreamStats> getStats() const;
+
+        // Print the per-stream and aggregate frames per second
+        void report(std::ostream &os) const;
+};
+
+#endif /* streamEngine_hpp */
@@ -0,0 +1,158 @@
+//
+//  threadPool.cpp
+//  cv_autonomous_vehicle
+//
+//  Work-stealing thread pool shared by the stream pipelines
+//
+
+#include "threadPool.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+/********************************************************************************************
+ * THREAD POOL
+ ********************************************************************************************
+ * This function starts the workers
+ * Output -> no output
+ * \param nThreads - number of workers (0 -> one per core)
+ * \param pinThreads - pin worker i to core i (modulo the number of cores)
+ */
+ThreadPool::ThreadPool(int nThreads, bool pinThreads) : pending(0), nextQueue(0), stopping(false) {
+
+    if (nThreads <= 0){
+        nThreads = max(1, (int)thread::hardware_concurrency());
+    }
+    for (int i = 0; i < nThreads; i++){
+        queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (int i = 0; i < nThreads; i++){
+        workers.push_back(thread(&ThreadPool::work, this, (size_t)i, pinThreads));
+    }
+}
+
+// Finishes the queued tasks and joins the workers
+ThreadPool::~ThreadPool(){
+
+    waitIdle();
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (size_t i = 0; i < workers.size(); i++){
+        workers[i].join();
+    }
+}
+
+/********************************************************************************************
+ * SUBMIT
+ ********************************************************************************************
+ * This function queues a task (it may be called from inside a task)
+ * Output -> no output
+ * \param task - the task
+ */
+void ThreadPool::submit(const function<void()> &task){
+
+    // Queue under the pool lock so a worker about to sleep cannot miss the task
+    {
+        lock_guard<std::mutex> lock(mutex);
+        pending++;
+        WorkQueue &q = *queues[nextQueue];
+        nextQueue = (nextQueue + 1) % queues.size();
+
+        lock_guard<std::mutex> qlock(q.mutex);
+        q.tasks.push_back(task);
+    }
+    taskReady.notify_one();
+}
+
+/********************************************************************************************
+ * TAKE TASK
+ ********************************************************************************************
+ * This function takes the oldest task of the worker's queue, or steals the newest task of
+ * another worker's queue (starting with the next worker)
+ * Output -> false if every queue is empty
+ * \param worker - index of the worker
+ * \param task - the task
+ */
+bool ThreadPool::takeTask(size_t worker, function<void()> &task){
+
+    {
+        WorkQueue &own = *queues[worker];
+        lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()){
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++){
+        WorkQueue &other = *queues[(worker + i) % queues.size()];
+        lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()){
+            task = other.tasks.back();
+            other.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Worker thread function
+void ThreadPool::work(size_t worker, bool pin){
+
+#ifdef __linux__
+    if (pin){
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker % max(1u, thread::hardware_concurrency()), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#else
+    (void)pin;
+#endif
+
+    function<void()> task;
+    for (;;){
+        if (takeTask(worker, task)){
+            task();
+            task = nullptr;
+
+            lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0){
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        // Sleep until a task is submitted (recheck the queues under the lock so no wake up is missed)
+        unique_lock<std::mutex> lock(mutex);
+        if (stopping){
+            return;
+        }
+        bool queued = false;
+        for (size_t i = 0; i < queues.size() && !queued; i++){
+            lock_guard<std::mutex> qlock(queues[i]->mutex);
+            queued = !queues[i]->tasks.empty();
+        }
+        if (!queued){
+            taskReady.wait(lock);
+        }
+    }
+}
+
+// Block until every submitted task (including tasks they submit) has finished
+void ThreadPool::waitIdle(){
+    unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this](){ return pending == 0; });
+}
+
+// Get the number of workers
+size_t ThreadPool::size() const {
+    return workers.size();
+}
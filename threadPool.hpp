@@ -0,0 +1,84 @@
+//
+//  threadPool.hpp
+//  cv_autonomous_vehicle
+//
+//  Work-stealing thread pool shared by the stream pipelines
+//
+
+#ifndef threadPool_hpp
+#define threadPool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Thread Pool -> Fixed set of workers, each with its own task queue
+ * Submitted tasks are spread over the queues round robin. A worker takes tasks from the front
+ * of its own queue (oldest first, so tasks are served in submission order) and when its queue
+ * is empty steals from the back of another worker's queue. Workers can optionally be pinned
+ * to a core each (Linux only, ignored elsewhere).
+ */
+class ThreadPool {
+
+    private:
+
+        // Task queue of one worker
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()> > tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkQueue> > queues;
+        std::vector<std::thread> workers;
+
+        // Sleeping workers wait for tasks, waitIdle waits for the pool to drain
+        std::mutex mutex;
+        std::condition_variable taskReady;
+        std::condition_variable idle;
+        size_t pending; // tasks submitted but not finished
+        size_t nextQueue; // queue the next task is submitted to
+        bool stopping;
+
+        // Take a task from the worker's own queue or steal one from another
+        bool takeTask(size_t worker, std::function<void()> &task);
+
+        // Worker thread function
+        void work(size_t worker, bool pin);
+
+    public:
+
+        /********************************************************************************************
+         * THREAD POOL
+         ********************************************************************************************
+         * This function starts the workers
+         * Output -> no output
+         * \param nThreads - number of workers (0 -> one per core)
+         * \param pinThreads - pin worker i to core i (modulo the number of cores)
+         */
+        ThreadPool(int nThreads = 0, bool pinThreads = false);
+
+        // Finishes the queued tasks and joins the workers
+        ~ThreadPool();
+
+        /********************************************************************************************
+         * SUBMIT
+         ********************************************************************************************
+         * This function queues a task (it may be called from inside a task)
+         * Output -> no output
+         * \param task - the task
+         */
+        void submit(const std::function<void()> &task);
+
+        // Block until every submitted task (including tasks they submit) has finished
+        void waitIdle();
+
+        // Get the number of workers
+        size_t size() const;
+};
+
+#endif /* threadPool_hpp */
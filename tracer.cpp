@@ -0,0 +1,141 @@
+//
+//  tracer.cpp
+//  cv_autonomous_vehicle
+//
+//  Per-frame timeline recording in Chrome trace-event format
+//
+
+#include "tracer.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Complete ("X") trace event
+ */
+struct TraceEvent {
+    const char *name;
+    long long frameId;
+    int tid;
+    long long beginUs;
+    long long durUs;
+};
+
+// Fixed size event buffer, allocated by enable()
+static vector<TraceEvent> events;
+static std::atomic<size_t> nextEvent(0);
+static std::atomic<size_t> dropped(0);
+static std::atomic<bool> enabled(false);
+
+// Time all events are relative to
+static Tracer::TimePoint epoch;
+
+// Small thread ids for the trace viewer
+static std::atomic<int> nextTid(0);
+static thread_local int localTid = -1;
+
+// Frame id of events recorded on this thread
+static thread_local long long currentFrame = -1;
+
+/********************************************************************************************
+ * ENABLE
+ ********************************************************************************************
+ * This function allocates the event buffer and starts recording
+ * Output -> no output
+ * \param capacity - maximum number of events kept
+ */
+void Tracer::enable(size_t capacity){
+    enabled = false;
+    events.assign(capacity, TraceEvent());
+    nextEvent = 0;
+    dropped = 0;
+    epoch = std::chrono::steady_clock::now();
+    enabled = capacity > 0;
+}
+
+/********************************************************************************************
+ * RECORD
+ ********************************************************************************************
+ * This function stores a complete event (does nothing if the tracer is not enabled)
+ * Output -> no output
+ * \param name - name of the stage
+ * \param frameId - frame the event belongs to
+ * \param begin - start time of the event
+ * \param end - end time of the event
+ */
+void Tracer::record(const char *name, long long frameId, TimePoint begin, TimePoint end){
+
+    if (!enabled.load(std::memory_order_relaxed)){
+        return;
+    }
+
+    // Claim a slot, drop the event if the buffer is full
+    size_t i = nextEvent.fetch_add(1, std::memory_order_relaxed);
+    if (i >= events.size()){
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (localTid < 0){
+        localTid = nextTid.fetch_add(1);
+    }
+
+    TraceEvent &e = events[i];
+    e.name = name;
+    e.frameId = frameId;
+    e.tid = localTid;
+    e.beginUs = std::chrono::duration_cast<std::chrono::microseconds>(begin - epoch).count();
+    e.durUs = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+}
+
+/********************************************************************************************
+ * WRITE
+ ********************************************************************************************
+ * This function writes the recorded events as Chrome trace-event JSON
+ * Output -> false if the file could not be written
+ * \param fileName - output file path and name
+ */
+bool Tracer::write(const string &fileName){
+
+    ofstream out(fileName.c_str());
+    if (!out.is_open()){
+        return false;
+    }
+
+    size_t n = min(nextEvent.load(), events.size());
+    out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":" << dropped.load() << "},\"traceEvents\":[\n";
+    for (size_t i = 0; i < n; i++){
+        const TraceEvent &e = events[i];
+        out << "{\"name\":\"" << e.name << "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+            << ",\"ts\":" << e.beginUs << ",\"dur\":" << e.durUs << ",\"args\":{\"frame\":" << e.frameId << "}}";
+        out << (i + 1 < n ? ",\n" : "\n");
+    }
+    out << "]}" << endl;
+
+    return out.good();
+}
+
+// Discard the recorded events and restart the timeline (the buffer is kept)
+void Tracer::reset(){
+    nextEvent = 0;
+    dropped = 0;
+    epoch = std::chrono::steady_clock::now();
+}
+
+// Set the frame id used by events recorded on the calling thread
+void Tracer::setCurrentFrame(long long frameId){
+    currentFrame = frameId;
+}
+
+// Get the frame id used by events recorded on the calling thread
+long long Tracer::getCurrentFrame(){
+    return currentFrame;
+}
+
+// Get the number of events dropped because the buffer was full
+size_t Tracer::getDropped(){
+    return dropped.load();
+}
@@ -0,0 +1,108 @@
+//
+//  tracer.hpp
+//  cv_autonomous_vehicle
+//
+//  Per-frame timeline recording in Chrome trace-event format
+//
+
+#ifndef tracer_hpp
+#define tracer_hpp
+
+#include <chrono>
+#include <string>
+
+/*
+ * Tracer -> Records begin/end events into a fixed size buffer and writes them as Chrome
+ * trace-event JSON (open the file in chrome://tracing or https://ui.perfetto.dev offline).
+ * Each event stores the frame id, the name of the stage and the thread it ran on. When the
+ * buffer is full further events are dropped (and counted) so memory use stays bounded.
+ */
+class Tracer {
+
+    public:
+
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        /********************************************************************************************
+         * ENABLE
+         ********************************************************************************************
+         * This function allocates the event buffer and starts recording
+         * Output -> no output
+         * \param capacity - maximum number of events kept
+         */
+        static void enable(size_t capacity);
+
+        /********************************************************************************************
+         * RECORD
+         ********************************************************************************************
+         * This function stores a complete event (does nothing if the tracer is not enabled)
+         * Output -> no output
+         * \param name - name of the stage (must be a string literal or otherwise outlive the tracer)
+         * \param frameId - frame the event belongs to
+         * \param begin - start time of the event
+         * \param end - end time of the event
+         */
+        static void record(const char *name, long long frameId, TimePoint begin, TimePoint end);
+
+        /********************************************************************************************
+         * WRITE
+         ********************************************************************************************
+         * This function writes the recorded events as Chrome trace-event JSON
+         * Call it once the pipeline threads are idle
+         * Output -> false if the file could not be written
+         * \param fileName - output file path and name
+         */
+        static bool write(const std::string &fileName);
+
+        // Discard the recorded events and restart the timeline (call it while the pipeline threads are idle)
+        static void reset();
+
+        // Set/get the frame id used by events recorded on the calling thread
+        static void setCurrentFrame(long long frameId);
+        static long long getCurrentFrame();
+
+        // Get the number of events dropped because the buffer was full
+        static size_t getDropped();
+};
+
+/*
+ * Scoped Trace -> Records an event from construction to destruction
+ * The frame id is also made current for the thread so nested stage events share it
+ */
+class ScopedTrace {
+
+    private:
+
+        const char *name;
+        long long frameId;
+        long long prevFrame;
+        Tracer::TimePoint start;
+
+    public:
+
+        ScopedTrace(const char *name_, long long frameId_) : name(name_), frameId(frameId_), prevFrame(Tracer::getCurrentFrame()), start(std::chrono::steady_clock::now()) {
+            Tracer::setCurrentFrame(frameId);
+        }
+
+        ~ScopedTrace(){
+            Tracer::record(name, frameId, start, std::chrono::steady_clock::now());
+            Tracer::setCurrentFrame(prevFrame);
+        }
+};
+
+// Tracing compiles out to nothing unless built with -DENABLE_TRACING
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, frameId) ScopedTrace TRACE_CONCAT(traceScope_, __LINE__)(name, frameId)
+#define TRACE_ENABLE(capacity) Tracer::enable(capacity)
+#define TRACE_WRITE(fileName) Tracer::write(fileName)
+#define TRACE_RESET() Tracer::reset()
+#else
+#define TRACE_SCOPE(name, frameId)
+#define TRACE_ENABLE(capacity)
+#define TRACE_WRITE(fileName)
+#define TRACE_RESET()
+#endif
+
+#endif /* tracer_hpp */
@@ -8,6 +8,8 @@
 
 #include "vehicleDetector.hpp"
 
+#include "profiler.hpp"
+
 using namespace cv;
 using namespace std;
 
@@ -21,13 +23,52 @@ using namespace std;
  */
 vector<Rect> VehicleDetector::process(const Mat &frame, CascadeClassifier car_cascade){
     
+    PROFILE_SCOPE(VEHICLE_TOTAL);
+    
+    cars.clear();
+    if (frame.empty()){
+        return cars;
+    }
+    
+    // Only the detection region is converted and equalized (the whole frame if it is outside the frame)
+    PROFILE_SCOPE(VEHICLE_GRAY);
+    Rect roi( 0, 0, frame.cols, frame.rows );
+    if (detectROI.area() > 0 && (detectROI & roi).area() > 0){
+        roi &= detectROI;
+    }
+    cvtColor( frame(roi), frame_gray, COLOR_BGR2GRAY );
+    PROFILE_STOP(VEHICLE_GRAY);
+    
+    // Downscale once so the cascade skips the finest pyramid levels
+    Mat detectImg = frame_gray;
+    if (detectScale < 1.0){
+        PROFILE_SCOPE(VEHICLE_RESIZE);
+        resize( frame_gray, frame_small, Size(), detectScale, detectScale, INTER_AREA );
+        detectImg = frame_small;
+    }
     
+    // Equalize the histogram of the detection region
+    PROFILE_SCOPE(VEHICLE_EQUALIZE);
+    if (smoothLUT){
+        equalizeSmoothed( detectImg, detectImg );
+    } else {
+        equalizeHist( detectImg, detectImg );
+    }
+    PROFILE_STOP(VEHICLE_EQUALIZE);
     
-    cvtColor( frame, frame_gray, COLOR_BGR2GRAY );
-    equalizeHist( frame_gray, frame_gray );
+    // Detect cars (minimum size scaled to match the detection image)
+    PROFILE_SCOPE(VEHICLE_DETECT);
+    Size detectMin( cvRound(minSize.width*detectScale), cvRound(minSize.height*detectScale) );
+    car_cascade.detectMultiScale( detectImg, cars, scaleFactor, 2, 0, detectMin );
+    PROFILE_STOP(VEHICLE_DETECT);
     
-    // Detect cars
-    car_cascade.detectMultiScale( frame_gray, cars, 1.1, 2, 0, Size(100, 100) );
+    // Map the rectangles back to the full resolution frame
+    for( size_t i = 0; i < cars.size(); i++ ){
+        if (detectScale < 1.0){
+            cars[i] = Rect( cvRound(cars[i].x/detectScale), cvRound(cars[i].y/detectScale), cvRound(cars[i].width/detectScale), cvRound(cars[i].height/detectScale) );
+        }
+        cars[i] = ( cars[i] + roi.tl() ) & roi;
+    }
     
 //            for(int i = 0; i < cars.size(); i++)
 //            {
@@ -46,3 +87,81 @@ vector<Rect> VehicleDetector::process(const Mat &frame, CascadeClassifier car_ca
     return cars;
     
 }
+
+/********************************************************************************************
+ * SMOOTHED HISTOGRAM EQUALIZATION
+ ********************************************************************************************
+ * This function equalizes the image using a histogram averaged over previous frames
+ * The LUT changes slowly between frames, giving the cascade a stabler input than equalizeHist
+ * \param src - the gray scale input image
+ * \param dst - the equalized output image
+ */
+void VehicleDetector::equalizeSmoothed(const Mat &src, Mat &dst){
+    
+    // Normalised histogram of the current frame
+    Mat hist;
+    int histSize = 256;
+    float range[] = { 0, 256 };
+    const float *histRange = range;
+    calcHist( &src, 1, 0, Mat(), hist, 1, &histSize, &histRange );
+    hist /= (double)src.total();
+    
+    // Update the running histogram (first frame initialises it)
+    if (histAvg.empty()){
+        hist.copyTo(histAvg);
+    } else {
+        histAvg = lutAlpha*hist + (1 - lutAlpha)*histAvg;
+    }
+    
+    // Build the LUT from the cumulative distribution
+    lut.create(1, 256, CV_8UC1);
+    uchar *l = lut.ptr<uchar>(0);
+    const float *h = histAvg.ptr<float>(0);
+    float cdf = 0;
+    for (int i = 0; i < 256; i++){
+        cdf += h[i];
+        l[i] = saturate_cast<uchar>(255*cdf);
+    }
+    
+    LUT( src, lut, dst );
+}
+
+//********************************************************************************************
+//* SETTERS AND GETTERS
+//********************************************************************************************
+
+// Set the scale of the detection image
+void VehicleDetector::setDetectScale(double scale){
+    if (scale > 0 && scale <= 1.0){
+        detectScale = scale;
+    }
+}
+
+// Set the minimum vehicle size at full resolution
+void VehicleDetector::setMinSize(cv::Size size){
+    minSize = size;
+}
+
+// Set the scale step between pyramid levels
+void VehicleDetector::setScaleFactor(double factor){
+    if (factor > 1.0){
+        scaleFactor = factor;
+    }
+}
+
+// Set the region searched for vehicles
+void VehicleDetector::setDetectROI(cv::Rect roi){
+    detectROI = roi;
+}
+
+// Set temporally smoothed equalization
+void VehicleDetector::setSmoothLUT(bool smooth, double alpha){
+    smoothLUT = smooth;
+    lutAlpha = alpha;
+    histAvg.release();
+}
+
+// Get the scale of the detection image
+double VehicleDetector::getDetectScale(){
+    return detectScale;
+}
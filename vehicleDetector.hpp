@@ -39,8 +39,32 @@ class VehicleDetector {
         // Image containing the gray scale image
         cv::Mat frame_gray;
     
+        // Image containing the downscaled gray scale image used for detection
+        cv::Mat frame_small;
+    
+        // Scale of the detection image relative to the input frame (1 -> full resolution)
+        double detectScale;
+    
+        // Minimum vehicle size at full resolution
+        cv::Size minSize;
+    
+        // Scale step between detectMultiScale pyramid levels
+        double scaleFactor;
+    
+        // Region of the frame searched for vehicles (empty -> whole frame)
+        cv::Rect detectROI;
+    
+        // Temporally smoothed histogram equalization
+        bool smoothLUT; // use the smoothed LUT instead of equalizeHist
+        double lutAlpha; // weight of the current frame's histogram
+        cv::Mat histAvg; // smoothed normalised histogram (256 bins)
+        cv::Mat lut; // lookup table built from the smoothed histogram
+    
     public:
     
+        // Default parameter initialization
+        VehicleDetector() : detectScale(1.0), minSize(100, 100), scaleFactor(1.1), smoothLUT(false), lutAlpha(0.1) {}
+    
         /*******************************************************************************************
          * VEHICLE DETECTOR
          *******************************************************************************************
@@ -50,6 +74,38 @@ class VehicleDetector {
          * \param car_cascade -> the car cascade for the haar detector
          */
         std::vector<cv::Rect> process(const cv::Mat &image, cv::CascadeClassifier car_cascade);
+    
+        /*******************************************************************************************
+         * SMOOTHED HISTOGRAM EQUALIZATION
+         *******************************************************************************************
+         * This function equalizes the image using a histogram averaged over previous frames
+         * Output is the equalized image (can be the same as the input image)
+         * \param src -> the gray scale input image
+         * \param dst -> the equalized output image
+         */
+        void equalizeSmoothed(const cv::Mat &src, cv::Mat &dst);
+    
+        //********************************************************************************************
+        //* SETTERS AND GETTERS
+        //********************************************************************************************
+    
+        // Set the scale of the detection image (0 < scale <= 1)
+        void setDetectScale(double scale);
+    
+        // Set the minimum vehicle size at full resolution
+        void setMinSize(cv::Size size);
+    
+        // Set the scale step between pyramid levels (> 1)
+        void setScaleFactor(double factor);
+    
+        // Set the region searched for vehicles (empty or outside the frame -> whole frame)
+        void setDetectROI(cv::Rect roi);
+    
+        // Set temporally smoothed equalization and the weight given to the current frame
+        void setSmoothLUT(bool smooth, double alpha = 0.1);
+    
+        // Get the scale of the detection image
+        double getDetectScale();
 };
 
 #endif /* vehicleDetector_hpp */
@@ -13,6 +13,10 @@
 
 #include "controller.hpp"
 
+#include "changeDetector.hpp"
+
+#include "config.hpp"
+
 class VehicleDetectorController: public Controller {
     
     private:
@@ -25,10 +29,19 @@ class VehicleDetectorController: public Controller {
     
         // Vector containing detected cars
         std::vector<cv::Rect> cars;
+        std::vector<cv::Rect> savedCars; // kept by saveState
+    
+        // Configured detection scale and the fraction of it currently used (reduced when short of time)
+        double detectScale;
+        double scaleReduction;
+    
+        // Skips frames whose detection region has not changed since the last frame processed
+        ChangeDetector change;
+        cv::Rect detectROI;
     
     public:
         
-        VehicleDetectorController (){ // private constructor
+        VehicleDetectorController () : detectScale(1.0), scaleReduction(1.0) { // private constructor
             
             // Setting up the application
             vdetect = new VehicleDetector();
@@ -47,9 +60,88 @@ class VehicleDetectorController: public Controller {
         // Perform processing
         void process() {
             
+            TRACE_SCOPE("VehicleDetectorController::process", frameId);
+            
+            // Nothing moved in the detection region since the last frame processed -> keep its vehicles
+            if (change.isStatic(image, detectROI)){
+                return;
+            }
             cars = vdetect->process(image, car_cascade);
         }
     
+        // Set the scale the detection is run at (1 -> full resolution)
+        void setDetectScale(double scale){
+            
+            detectScale = scale;
+            vdetect->setDetectScale(detectScale*scaleReduction);
+        }
+    
+        // Keep the vehicles, restoreState drops the frames processed since (e.g. a torn frame)
+        void saveState(){
+            
+            savedCars = cars;
+        }
+    
+        // Go back to the vehicles kept by saveState (the next frame is compared with nothing and processed)
+        void restoreState(){
+            
+            cars = savedCars;
+            change.reset();
+        }
+    
+        // Run the detection at a fraction of the configured scale (1 -> the configured scale)
+        void setScaleReduction(double reduction){
+            
+            if (reduction != scaleReduction){
+                scaleReduction = reduction;
+                vdetect->setDetectScale(detectScale*scaleReduction);
+            }
+        }
+    
+        // Set the scale step between pyramid levels and the minimum vehicle size
+        void setScaleFactor(double factor, cv::Size minSize){
+            
+            vdetect->setScaleFactor(factor);
+            vdetect->setMinSize(minSize);
+        }
+    
+        // Set the region of the frame searched for vehicles
+        void setDetectROI(cv::Rect roi){
+            
+            detectROI = roi;
+            vdetect->setDetectROI(roi);
+        }
+    
+        // Use a temporally smoothed histogram equalization
+        void setSmoothLUT(bool smooth){
+            
+            vdetect->setSmoothLUT(smooth);
+        }
+    
+        // Apply the vehicle detector parameters of a configuration (the cascade is loaded with setCascade)
+        void applyConfig(const Config &config){
+            
+            vdetect->setScaleFactor(config.scaleFactor);
+            vdetect->setMinSize(cv::Size(config.minSize, config.minSize));
+            setDetectScale(config.detectScale);
+            setDetectROI(config.detectROI);
+            vdetect->setSmoothLUT(config.smoothLUT);
+            change.setThreshold(config.staticThreshold, config.staticMaxSkip);
+        }
+    
+        // Reuse the vehicles of frames whose detection region changed less than threshold (mean gray levels,
+        // 0 -> never), for at most maxSkip frames in a row
+        void setStaticSkip(double threshold, int maxSkip){
+            
+            change.setThreshold(threshold, maxSkip);
+        }
+    
+        // Get the number of frames whose vehicles were reused
+        long long getStaticFrames() const {
+            
+            return change.getStatic();
+        }
+    
         // Get the vector of detected cars
         std::vector<cv::Rect> getCars(){
             return cars;
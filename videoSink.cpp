@@ -0,0 +1,190 @@
+//
+//  videoSink.cpp
+//  cv_autonomous_vehicle
+//
+//  Encodes an output video on a background thread
+//
+
+#include "videoSink.hpp"
+
+#include <chrono>
+
+using namespace cv;
+using namespace std;
+
+/********************************************************************************************
+ * VIDEO SINK
+ ********************************************************************************************
+ * This function sets the queue bound and the policy when it is full
+ * Output -> no output
+ * \param maxQueue_ - most frames waiting for the encoder
+ * \param dropWhenFull_ - drop frames (true) or wait for the encoder (false) when the queue is full
+ */
+VideoSink::VideoSink(size_t maxQueue_, bool dropWhenFull_) : fps(30), fourcc(0), failed(false), maxQueue(max(maxQueue_, (size_t)1)),
+    dropWhenFull(dropWhenFull_), closing(false), maxQueued(0), written(0), dropped(0), blockedMs(0) {}
+
+/********************************************************************************************
+ * OPEN
+ ********************************************************************************************
+ * This function creates the output video and starts the encoder thread
+ * Output -> false if the video could not be created
+ * \param fileName_ - output video file path and name
+ * \param fps_ - frame rate of the output
+ * \param size - frame size (empty -> the size of the first frame written)
+ * \param fourcc_ - codec (e.g. VideoWriter::fourcc('M','J','P','G'))
+ */
+bool VideoSink::open(const string &fileName_, double fps_, Size size, int fourcc_){
+
+    close();
+    fileName = fileName_;
+    fps = fps_ > 0 ? fps_ : 30;
+    fourcc = fourcc_;
+    failed = false;
+    if (size.area() > 0 && !writer.open(fileName, fourcc, fps, size, true)){
+        return false;
+    }
+    queue.clear();
+    maxQueued = 0;
+    written = 0;
+    dropped = 0;
+    blockedMs = 0;
+    closing = false;
+    encoder = thread(&VideoSink::encode, this);
+    return true;
+}
+
+/********************************************************************************************
+ * WRITE
+ ********************************************************************************************
+ * This function copies a frame and queues it for the encoder
+ * Output -> false if the frame was dropped (or the sink is not open)
+ * \param frame - the frame (the caller can reuse it straight away)
+ */
+bool VideoSink::write(const Mat &frame){
+
+    if (!encoder.joinable() || failed){
+        return false;
+    }
+
+    // Create the video with the size of the first frame (the encoder has nothing to write before it)
+    if (!writer.isOpened() && !writer.open(fileName, fourcc, fps, frame.size(), true)){
+        failed = true;
+        return false;
+    }
+
+    // Take a buffer the encoder has finished with, or drop/wait if the queue is full
+    Mat buffer;
+    {
+        unique_lock<std::mutex> lock(mutex);
+        if (queue.size() >= maxQueue){
+            if (dropWhenFull){
+                dropped++;
+                return false;
+            }
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            space.wait(lock, [this](){ return queue.size() < maxQueue; });
+            blockedMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        if (!free.empty()){
+            buffer = free.back();
+            free.pop_back();
+        }
+    }
+
+    // copyTo reuses the buffer if the size matches
+    frame.copyTo(buffer);
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        queue.push_back(buffer);
+        maxQueued = max(maxQueued, queue.size());
+    }
+    ready.notify_one();
+    return true;
+}
+
+/********************************************************************************************
+ * ENCODE
+ ********************************************************************************************
+ * This function encodes the queued frames until the sink is closed
+ * Output -> no output
+ */
+void VideoSink::encode(){
+
+    for (;;){
+        Mat frame;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this](){ return !queue.empty() || closing; });
+            if (queue.empty()){
+                break;
+            }
+            frame = queue.front();
+            queue.pop_front();
+        }
+        space.notify_one();
+
+        writer.write(frame);
+
+        lock_guard<std::mutex> lock(mutex);
+        written++;
+        free.push_back(frame);
+    }
+}
+
+// Encode the queued frames and close the file
+void VideoSink::close(){
+
+    if (encoder.joinable()){
+        {
+            lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        ready.notify_one();
+        encoder.join();
+    }
+    writer.release();
+    free.clear();
+}
+
+// True if the output video is open
+bool VideoSink::isOpened() const {
+    return encoder.joinable() && !failed;
+}
+
+// True if write() would wait for the encoder (it waits when full and not dropping frames)
+bool VideoSink::wouldBlock(){
+    lock_guard<std::mutex> lock(mutex);
+    return !dropWhenFull && queue.size() >= maxQueue;
+}
+
+// Set the queue bound and the policy when it is full
+void VideoSink::setQueue(size_t maxQueue_, bool dropWhenFull_){
+    lock_guard<std::mutex> lock(mutex);
+    maxQueue = max(maxQueue_, (size_t)1);
+    dropWhenFull = dropWhenFull_;
+}
+
+// Get the number of frames encoded
+long long VideoSink::getWritten(){
+    lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+// Get the number of frames dropped because the queue was full
+long long VideoSink::getDropped(){
+    lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+// Get the total time write() waited for the encoder (ms)
+double VideoSink::getBlockedMs(){
+    lock_guard<std::mutex> lock(mutex);
+    return blockedMs;
+}
+
+// Get the most frames that were waiting for the encoder at once
+size_t VideoSink::getMaxQueued(){
+    lock_guard<std::mutex> lock(mutex);
+    return maxQueued;
+}
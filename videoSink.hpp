@@ -0,0 +1,125 @@
+//
+//  videoSink.hpp
+//  cv_autonomous_vehicle
+//
+//  Encodes an output video on a background thread
+//
+
+#ifndef videoSink_hpp
+#define videoSink_hpp
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Video Sink -> Writes frames to a video file on its own thread through a bounded queue
+ * write() copies the frame into a recycled buffer and queues it, so the caller only pays for
+ * the copy and the encoder runs alongside the pipeline. Buffers go back to a free list once
+ * they are encoded, so no frame is allocated once the queue has reached its working depth.
+ * When the encoder falls behind and the queue is full, write() either drops the frame (the
+ * pipeline keeps its rate, the video has gaps) or waits for the encoder (back-pressure, every
+ * frame is kept but the pipeline slows down to the encoder's rate).
+ */
+class VideoSink {
+
+    private:
+
+        cv::VideoWriter writer;
+
+        // Output parameters (the video is created at the first frame if the size is not known)
+        std::string fileName;
+        double fps;
+        int fourcc;
+        bool failed;
+
+        // Frames waiting for the encoder and buffers that can be reused
+        std::deque<cv::Mat> queue;
+        std::vector<cv::Mat> free;
+        size_t maxQueue; // queue bound
+        bool dropWhenFull; // drop frames (true) or wait for the encoder (false) when the queue is full
+        bool closing;
+        std::mutex mutex;
+        std::condition_variable ready; // a frame was queued
+        std::condition_variable space; // a frame was taken by the encoder
+        std::thread encoder;
+
+        // Statistics
+        size_t maxQueued; // most frames waiting at once
+        long long written;
+        long long dropped;
+        double blockedMs; // total time write() waited for the encoder
+
+        // Encoder thread function
+        void encode();
+
+    public:
+
+        /********************************************************************************************
+         * VIDEO SINK
+         ********************************************************************************************
+         * This function sets the queue bound and the policy when it is full
+         * Output -> no output
+         * \param maxQueue_ - most frames waiting for the encoder
+         * \param dropWhenFull_ - drop frames (true) or wait for the encoder (false) when the queue is full
+         */
+        VideoSink(size_t maxQueue_ = 8, bool dropWhenFull_ = true);
+
+        // Encodes the queued frames and closes the file
+        ~VideoSink(){
+            close();
+        }
+
+        /********************************************************************************************
+         * OPEN
+         ********************************************************************************************
+         * This function creates the output video and starts the encoder thread
+         * Output -> false if the video could not be created
+         * \param fileName_ - output video file path and name
+         * \param fps_ - frame rate of the output
+         * \param size - frame size (empty -> the size of the first frame written)
+         * \param fourcc_ - codec (e.g. VideoWriter::fourcc('M','J','P','G'))
+         */
+        bool open(const std::string &fileName_, double fps_, cv::Size size, int fourcc_);
+
+        /********************************************************************************************
+         * WRITE
+         ********************************************************************************************
+         * This function copies a frame and queues it for the encoder
+         * Output -> false if the frame was dropped (or the sink is not open)
+         * \param frame - the frame (the caller can reuse it straight away)
+         */
+        bool write(const cv::Mat &frame);
+
+        // Encode the queued frames and close the file
+        void close();
+
+        // True if the output video is open
+        bool isOpened() const;
+    
+        // True if write() would wait for the encoder (it waits when full and not dropping frames)
+        bool wouldBlock();
+
+        // Set the queue bound and the policy when it is full
+        void setQueue(size_t maxQueue_, bool dropWhenFull_);
+
+        // Get the number of frames encoded
+        long long getWritten();
+
+        // Get the number of frames dropped because the queue was full
+        long long getDropped();
+
+        // Get the total time write() waited for the encoder (ms)
+        double getBlockedMs();
+
+        // Get the most frames that were waiting for the encoder at once
+        size_t getMaxQueued();
+};
+
+#endif /* videoSink_hpp */